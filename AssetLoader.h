@@ -0,0 +1,127 @@
+#ifndef ASSET_LOADER_H
+#define ASSET_LOADER_H
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <string>
+
+#include "TraceRecorder.h"
+
+namespace pm
+{
+	// Runs loading jobs on a few worker threads. Each job can have a second part that
+	// has to happen on the render thread (decals need the GPU context), those run
+	// from update() or wait() strictly in the order the jobs were added, so ids and
+	// vector orders come out the same no matter which worker finished first
+	class AssetLoader
+	{
+		struct Job
+		{
+			std::function<void()> work;
+			std::function<void()> finish;
+			std::string sName; // what the trace calls it
+			std::atomic<bool> bDone = { false };
+		};
+
+		std::vector<std::unique_ptr<Job>> jobs;
+		std::vector<std::thread> workers;
+		std::atomic<size_t> nNextWork = { 0 };
+		size_t nNextFinish = 0;
+
+		std::mutex muxDone;
+		std::condition_variable cvDone;
+
+	public:
+		~AssetLoader() { cancel(); }
+
+		void add(std::function<void()> work, std::function<void()> finish = nullptr, std::string sName = "")
+		{
+			jobs.emplace_back(new Job{ std::move(work), std::move(finish), std::move(sName) });
+		}
+
+		// everything has to be added before this
+		void start()
+		{
+			unsigned int nThreads = std::clamp(std::thread::hardware_concurrency(), 1u, 8u);
+			nThreads = std::min<unsigned int>(nThreads, (unsigned int)jobs.size());
+			for (unsigned int i = 0; i < nThreads; ++i)
+				workers.emplace_back(&AssetLoader::worker, this);
+		}
+
+		// Render thread: runs whatever render-side parts are ready. True once all is loaded
+		bool update()
+		{
+			while (nNextFinish < jobs.size() && jobs[nNextFinish]->bDone)
+				finishNext();
+			if (nNextFinish < jobs.size())
+				return false;
+			join();
+			return true;
+		}
+
+		// Render thread: blocks until everything is loaded
+		void wait()
+		{
+			while (nNextFinish < jobs.size())
+			{
+				{
+					std::unique_lock<std::mutex> lock(muxDone);
+					cvDone.wait(lock, [&] { return jobs[nNextFinish]->bDone.load(); });
+				}
+				finishNext();
+			}
+			join();
+		}
+
+		// Quitting mid-load, workers finish their current job and stop
+		void cancel()
+		{
+			nNextWork = jobs.size();
+			join();
+		}
+
+		float progress() const
+		{
+			return jobs.empty() ? 1.0f : float(nNextFinish) / float(jobs.size());
+		}
+
+	private:
+		void worker()
+		{
+			TraceRecorder::nameThread("loader");
+			for (size_t i = nNextWork++; i < jobs.size(); i = nNextWork++)
+			{
+				{
+					TraceRecorder::Scope trace("load", "assets", jobs[i]->sName.c_str());
+					jobs[i]->work();
+				}
+				{
+					std::lock_guard<std::mutex> lock(muxDone);
+					jobs[i]->bDone = true;
+				}
+				cvDone.notify_all();
+			}
+		}
+		void finishNext()
+		{
+			Job& job = *jobs[nNextFinish++];
+			if (!job.finish) return;
+			TraceRecorder::Scope trace("finish load", "assets", job.sName.c_str());
+			job.finish();
+		}
+		void join()
+		{
+			for (auto& w : workers)
+				if (w.joinable()) w.join();
+			workers.clear();
+		}
+	};
+}
+
+#endif
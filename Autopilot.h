@@ -0,0 +1,226 @@
+#ifndef AUTOPILOT_H
+#define AUTOPILOT_H
+
+#include "Auxiliaries.h"
+
+#include <vector>
+#include <algorithm>
+#include <climits>
+
+namespace pm
+{
+	// Plays Pacman instead of the keyboard, for soak runs, benchmarks and checking that
+	// levels can be won. Goes for the nearest dots, looking nDepth tiles ahead along every
+	// way it could go for ghosts that might get there first. Power ups are saved for when
+	// a ghost is close, and weak ghosts are eaten while there's time. Never calls rand(),
+	// so with the game seeded the same a run plays out the same
+	class Autopilot
+	{
+	public:
+		static const int DEFAULT_DEPTH = 8;
+		static const int MAX_DEPTH = 10; // every way on is looked down, up to 3^depth paths
+
+	private:
+		static inline const int FAR = INT_MAX / 2;
+		static inline const float NEVER = 1e9f;
+		static const int DEATH = -1000000; // plus how many moves away, later is less bad
+		static const int DOT_VALUE = 4;    // times how many moves early it comes
+		static const int GHOST_VALUE = 8;
+		static const int POWER_UP_RANGE = 6; // a power up is only worth taking with a ghost this close to it
+
+		int nDepth;
+
+		// per tile, redone when the level or its board changes
+		const Level* pLevel;
+		size_t nBoardSize;
+		std::vector<Kind> vItems;    // DOT, POWER_UP or EMPTY
+		std::vector<int> vDotDist;   // moves to the nearest dot
+		// per tile, redone every tick
+		std::vector<float> vGhostTime; // seconds until a ghost that can eat could be there
+		std::vector<int> vGhostDist;   // moves to the nearest ghost that can eat, right now
+		std::vector<float> vWeakTime;  // seconds a weak ghost standing here has left
+		std::vector<int> vQueue;
+		std::vector<std::pair<float, int>> vHeap;
+		std::vector<int> vEaten;     // dots and ghosts taken along the path being looked at
+
+	public:
+		explicit Autopilot(const int nDepth = DEFAULT_DEPTH) :
+			nDepth(std::clamp(nDepth, 1, MAX_DEPTH)),
+			pLevel(nullptr),
+			nBoardSize(0)
+		{}
+
+		int depth() const { return nDepth; }
+		// forget the level, it's about to go
+		void reset() { pLevel = nullptr; }
+
+		// sets where the player turns next, call every tick in place of Pacman::getInput
+		void drive(Level& level)
+		{
+			if (pLevel != &level || nBoardSize != level.board.size())
+				readBoard(level);
+			readGhosts(level);
+
+			const int from = decisionTile(*level.player);
+			int nBest = INT_MIN;
+			int nBestStep = -1;
+			for (int s = 0; s < 4; s++)
+			{
+				const int n = neighbour(from, s);
+				if (isWall(n))
+					continue;
+				vEaten.clear();
+				const int nValue = look(n, s, 1, 0);
+				if (nValue > nBest)
+				{
+					nBest = nValue;
+					nBestStep = s;
+				}
+			}
+			if (nBestStep >= 0)
+				level.player->steer(stepToDir(nBestStep));
+		}
+
+	private:
+		const Topology& grid() const { return pLevel->paths.topology(); }
+		int index(const olc::vi2d& tile) const { return grid().index(tile); }
+		int neighbour(const int n, const int step) const { return grid().neighbour(n, step); }
+		bool isWall(const int n) const { return pLevel->paths.isWall(n); }
+
+		// A turn only happens lined up on a tile, so that's the tile to decide for: the one
+		// the player is on, or the next one if it's part way there going right or down
+		int decisionTile(const Pacman& player) const
+		{
+			const olc::vf2d& pos = player.getPos();
+			olc::vi2d tile = screenToTile(pos);
+			if ((int)pos.x % nTileSize != 0 && player.getDir() == Dir::RIGHT) tile.x++;
+			if ((int)pos.y % nTileSize != 0 && player.getDir() == Dir::DOWN)  tile.y++;
+			return index(tile);
+		}
+
+		void readBoard(const Level& level)
+		{
+			pLevel = &level;
+			nBoardSize = level.board.size();
+			vItems.assign(level.width * level.height, Kind::EMPTY);
+			for (auto& [pos, object] : level.board)
+				if (object->kind == Kind::DOT || object->kind == Kind::POWER_UP)
+					vItems[index(pos)] = object->kind;
+
+			vQueue.clear();
+			for (int n = 0; n < int(vItems.size()); n++)
+				if (vItems[n] == Kind::DOT)
+					vQueue.push_back(n);
+			flood(vDotDist);
+		}
+		// Weak and eaten ghosts are taken to stay put until they turn back, then come
+		// straight for the player like the rest
+		void readGhosts(const Level& level)
+		{
+			const float fGhostMove = float(nTileSize) / nGhostSpeed;
+			vGhostTime.assign(vItems.size(), NEVER);
+			vWeakTime.assign(vItems.size(), 0.0f);
+			vHeap.clear();
+			vQueue.clear();
+			for (auto& ghost : level.ghosts)
+			{
+				const int n = index(screenToTile(ghost->getPos()));
+				const float fLeft = ghost->weakTimeLeft();
+				vHeap.push_back({ fLeft, n });
+				if (ghost->getState() == Ghost::GhostState::STRONG)
+					vQueue.push_back(n);
+				else if (ghost->getState() == Ghost::GhostState::WEAK)
+					vWeakTime[n] = std::max(vWeakTime[n], fLeft);
+			}
+			flood(vGhostDist);
+
+			// Dijkstra, the ghosts start at different times
+			std::make_heap(vHeap.begin(), vHeap.end(), std::greater<>());
+			while (!vHeap.empty())
+			{
+				std::pop_heap(vHeap.begin(), vHeap.end(), std::greater<>());
+				const auto [fTime, n] = vHeap.back();
+				vHeap.pop_back();
+				if (fTime >= vGhostTime[n])
+					continue;
+				vGhostTime[n] = fTime;
+				for (int s = 0; s < 4; s++)
+				{
+					const int m = neighbour(n, s);
+					if (!isWall(m) && fTime + fGhostMove < vGhostTime[m])
+					{
+						vHeap.push_back({ fTime + fGhostMove, m });
+						std::push_heap(vHeap.begin(), vHeap.end(), std::greater<>());
+					}
+				}
+			}
+		}
+		// breadth first out of everything in vQueue at once
+		void flood(std::vector<int>& vDist)
+		{
+			vDist.assign(grid().tiles(), FAR);
+			for (int n : vQueue)
+				vDist[n] = 0;
+			for (size_t i = 0; i < vQueue.size(); i++)
+				for (int s = 0; s < 4; s++)
+				{
+					const int m = neighbour(vQueue[i], s);
+					if (!isWall(m) && vDist[m] == FAR)
+					{
+						vDist[m] = vDist[vQueue[i]] + 1;
+						vQueue.push_back(m);
+					}
+				}
+		}
+
+		static float moveTime(const int nMoves) { return float(nMoves * nTileSize) / nPacmanSpeed; }
+		// A ghost that can eat could be on the tile by the time the player is through it,
+		// with a tile to spare
+		bool isDangerous(const int n, const int nMoves) const
+		{
+			return vGhostTime[n] <= moveTime(nMoves + 2);
+		}
+
+		// Best value of the paths on from 'n', reached in nMoves moving 'step'. Dots count
+		// more the sooner they come; at the end of the look ahead, being close to more helps.
+		// Past a power up nothing is dangerous, it outlasts any look ahead
+		int look(const int n, const int step, const int nMoves, int nValue, bool bPowered = false)
+		{
+			if (!bPowered && isDangerous(n, nMoves))
+				return DEATH + nMoves;
+			bPowered |= vItems[n] == Kind::POWER_UP;
+			const size_t nEatenBefore = vEaten.size();
+			if (std::find(vEaten.begin(), vEaten.end(), n) == vEaten.end())
+			{
+				const bool bDot = vItems[n] == Kind::DOT;
+				const bool bPowerUp = vItems[n] == Kind::POWER_UP && vGhostDist[n] <= POWER_UP_RANGE;
+				const bool bGhost = vWeakTime[n] > moveTime(nMoves);
+				if (bDot || bPowerUp || bGhost)
+				{
+					vEaten.push_back(n);
+					nValue += (bGhost ? GHOST_VALUE : DOT_VALUE) * (nDepth + 1 - nMoves);
+				}
+			}
+
+			int nBest = INT_MIN;
+			if (nMoves == nDepth)
+				nBest = nValue - (vDotDist[n] == FAR ? 0 : vDotDist[n]);
+			else
+			{
+				// no turning back, unless it's a dead end
+				for (int s = 0; s < 4; s++)
+				{
+					const int m = neighbour(n, s);
+					if (s != (step ^ 1) && !isWall(m))
+						nBest = std::max(nBest, look(m, s, nMoves + 1, nValue, bPowered));
+				}
+				if (nBest == INT_MIN)
+					nBest = look(neighbour(n, step ^ 1), step ^ 1, nMoves + 1, nValue, bPowered);
+			}
+			vEaten.resize(nEatenBefore);
+			return nBest;
+		}
+	};
+}
+
+#endif
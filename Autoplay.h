@@ -0,0 +1,79 @@
+#ifndef AUTOPLAY_H
+#define AUTOPLAY_H
+
+#include "Game.h"
+
+namespace pm
+{
+	// Lets the autopilot play every level from a fixed seed, one level per frame, and
+	// reports which ones it won. A level it can't finish in MAX_TICKS counts as not won.
+	// The bot is known to lose the levels in KNOWN_LOSSES, those are reported but don't
+	// fail the run, so it keeps catching levels (or bots) that get worse
+	class AutoplayRunner : public olc::FrameSink
+	{
+		static const int MAX_TICKS = 10 * 60 * SIM_TICK_RATE;
+		static const uint32_t SEED = 1;
+		// four ghosts loose in an open level, it gets pinched in a corridor sooner or later
+		static inline const std::vector<int> KNOWN_LOSSES = { 8 };
+
+		Game& game;
+		int nLevel;
+
+	public:
+		int nWon;
+		int nNotWon;
+		int nKnownLosses; // of nNotWon
+
+		AutoplayRunner(Game& game, const int nDepth = Autopilot::DEFAULT_DEPTH) :
+			game(game),
+			nLevel(0),
+			nWon(0),
+			nNotWon(0),
+			nKnownLosses(0)
+		{
+			game.setAutopilot(nDepth);
+		}
+
+		// true when every level the bot should win, it did
+		bool passed() const { return nNotWon == nKnownLosses; }
+
+		bool WriteFrame(const olc::Sprite*, uint32_t) override
+		{
+			if (nLevel == game.numOfLevels())
+			{
+				std::cout << "autoplay: " << nWon << " won, " << nNotWon << " not won (" << nKnownLosses << " known)" << std::endl;
+				return false;
+			}
+
+			seedRandom(SEED);
+			game.startLevel(nLevel, true);
+			int nTicks = 0;
+			while (game.outcome() == Game::Outcome::PLAYING && nTicks < MAX_TICKS)
+			{
+				game.fastForward(1);
+				nTicks++;
+			}
+
+			const std::string sName = "level" + std::string(nLevel < 10 ? "0" : "") + std::to_string(nLevel);
+			const float fSeconds = float(nTicks) / SIM_TICK_RATE;
+			const bool bKnownLoss = std::find(KNOWN_LOSSES.begin(), KNOWN_LOSSES.end(), nLevel) != KNOWN_LOSSES.end();
+			if (game.outcome() == Game::Outcome::WON)
+			{
+				std::cout << "WON  " << sName << " in " << fSeconds << "s, " << DEFAULT_LIFE - game.livesLeft() << " lives lost"
+					<< (bKnownLoss ? ", no longer a known loss" : "") << std::endl;
+				nWon++;
+			}
+			else
+			{
+				std::cout << (game.outcome() == Game::Outcome::LOST ? "LOST " : "SLOW ") << sName << " after " << fSeconds << "s, "
+					<< game.dotsLeft() << " dots left" << (bKnownLoss ? " (known)" : "") << std::endl;
+				nNotWon++;
+				nKnownLosses += bKnownLoss;
+			}
+			nLevel++;
+			return true;
+		}
+	};
+}
+
+#endif
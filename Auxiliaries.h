@@ -1,17 +1,25 @@
 #ifndef AUXILIARIES_H
 #define AUXILIARIES_H
 
-#define BOARD_MAP std::map<olc::vi2d, std::shared_ptr<GameObject>, std::function<bool(const olc::vi2d& v1, const olc::vi2d& v2)>>
-#define MAKE_BOARD BOARD_MAP([&](auto v1, auto v2) { return v1.y == v2.y ? v1.x < v2.x : v1.y < v2.y; })
+#define BOARD_MAP std::map<olc::vi2d, std::shared_ptr<GameObject>, TileOrder>
+#define MAKE_BOARD BOARD_MAP()
 #define MAKE_TILE(game, type, image) (std::make_pair(pos, std::shared_ptr<GameObject>(new type(game, tileToScreen(pos), isOldschool, image))))
-#define MAKE_GHOST(type) std::shared_ptr<Ghost>(new type(game, tileToScreen(pos), width, height, board, isOldschool, decals[SPRITE_GHOST]))
+#define MAKE_GHOST(type) std::shared_ptr<Ghost>(new type(game, tileToScreen(pos), width, height, board, paths, isOldschool, decals[SPRITE_GHOST]))
 
 #define PATH_DATA "./Assets/data.txt"
 #define PATH_SOUND "./Assets/Sound/"
+#define PATH_SOUND_CACHE "./Assets/Cache/"
 #define PATH_GRAPHICS "./Assets/Graphics/"
+#define PATH_ASSETS "./Assets"
+#define PATH_PACK "./Assets.pak"
 
 #include <queue>
 #include <random>
+#include <fstream>
+#include <sstream>
+
+#include "Pathfinding.h"
+#include "TraceRecorder.h"
 
 namespace pm
 {
@@ -24,6 +32,22 @@ namespace pm
 	static const int DEFAULT_LEVEL_HEIGHT = 16;
 	static const int DEFAULT_LEVEL_WIDTH = 16;
 	static const int DEFAULT_LIFE = 3;
+	static const int FRAME_LIMIT = 60;
+	static const int IDLE_FRAME_RATE = 10;
+	static const int SIM_TICK_RATE = 60;
+	// ghost routes are only split across threads when the searches add up to this many tiles
+	static const int PARALLEL_ROUTE_TILES = 4 * 64 * 64;
+	static const int MAX_VOICES = 8;
+	// device buffering, AUDIO_BLOCKS * AUDIO_BLOCK_SAMPLES / 44100 seconds of latency (see the F3 overlay)
+	static const int AUDIO_BLOCKS = 8;
+	static const int AUDIO_BLOCK_SAMPLES = 512;
+	static const int SOUND_PRIORITY_MUSIC = 10;
+
+	// the board's order, row by row, the same as a tile's index y * width + x
+	struct TileOrder
+	{
+		bool operator()(const olc::vi2d& v1, const olc::vi2d& v2) const { return v1.y == v2.y ? v1.x < v2.x : v1.y < v2.y; }
+	};
 
 	const int nTileSize = 8;
 	const olc::vf2d vTile(nTileSize, nTileSize);
@@ -81,7 +105,8 @@ namespace pm
 		VICTORY,
 		LOSE,
 		LEVEL_MUSIC,
-		SCORE_UP
+		SCORE_UP,
+		COUNT
 	};
 	struct LevelData {
 		std::string data;
@@ -89,16 +114,88 @@ namespace pm
 		int height;
 	};
 
+	// levels one after another, a blank line between each
+	std::vector<LevelData> readLevels(std::istream& input)
+	{
+		std::vector<LevelData> levels;
+		while (input.good())
+		{
+			std::string result;
+			std::string buffer;
+			int lastLineSize = 0; // lines length, aka width
+			int i = 0;			  // num of lines, aka height
+			for (; std::getline(input, buffer); i++)
+			{
+				if (!buffer.empty() && buffer.back() == '\r') // a pack keeps the line endings it was made with
+					buffer.pop_back();
+				if (buffer.empty())
+					break;
+				if (i > 0 && buffer.size() != lastLineSize)
+				{
+					std::cout << "corrupted file!" << std::endl;
+					lastLineSize = 0;
+					break;
+				}
+				result += buffer;
+				lastLineSize = buffer.size();
+			}
+
+			// check validity
+			if (lastLineSize == 0)
+				continue;
+			//int count[static_cast<int>(Kind::COUNT)];
+			//for (auto c : result)
+			//	count[static_cast<int>(charToKind(c))]++;
+			//if (count[static_cast<int>(Kind::PLAYER)] != 1 || count[static_cast<int>(Kind::DOT)] < 1 || (count[static_cast<int>(Kind::GHOST_B)] +
+			//	count[static_cast<int>(Kind::GHOST_R)] + count[static_cast<int>(Kind::GHOST_G)] + count[static_cast<int>(Kind::GHOST_Y)] < 1))
+			//	continue;
+
+			levels.push_back({ result, lastLineSize, i });
+		}
+		return levels;
+	}
+
+	// PATH_DATA the way the game sees it, out of pack when there is one, from disk otherwise
+	std::string readDataFile(olc::ResourcePack* pack)
+	{
+		std::filebuf dataFile;
+		olc::ResourceView dataView;
+		if (pack)
+			dataView = pack->GetFileView(PATH_DATA);
+		else
+			dataFile.open(PATH_DATA, std::ios::in);
+		std::stringstream text;
+		text << (pack ? (std::streambuf*)&dataView : &dataFile);
+		return text.str();
+	}
+	// the levels the game plays, for the tools that run without it
+	std::vector<LevelData> readShippedLevels()
+	{
+		olc::ResourcePack pack;
+		std::istringstream input(readDataFile(pack.LoadPack(PATH_PACK, "") ? &pack : nullptr));
+		return readLevels(input);
+	}
+
 	/*auto randomBool() {
 		static auto gen = std::bind(std::uniform_int_distribution<>(0, 1), std::default_random_engine());
 		return gen();
 	}*/
 
-	bool randomBool(const float p = 0.5) {
+	std::mt19937& randomEngine() {
 		static auto dev = std::random_device();
 		static auto gen = std::mt19937{ dev() };
+		return gen;
+	}
+
+	// makes every random choice in the game repeatable, for tests and replays
+	void seedRandom(const uint32_t seed) {
+		randomEngine().seed(seed);
+		srand(seed);
+	}
+
+	bool randomBool(const float p = 0.5) {
 		static auto dist = std::uniform_real_distribution<float>(0, 1);
-		return (dist(gen) < p);
+		return (dist(randomEngine()) < p);
 	}
 
 	olc::vi2d tileToScreen(int x, int y)
@@ -159,8 +256,29 @@ namespace pm
 		}
 		return Kind::EMPTY;
 	}
+	// to and from indices into Pathfinder::STEPS
+	Dir stepToDir(const int step)
+	{
+		switch (step)
+		{
+		case 1:  return Dir::RIGHT;
+		case 2:  return Dir::UP;
+		case 3:  return Dir::DOWN;
+		default: return Dir::LEFT;
+		}
+	}
+	int dirToStep(const Dir dir)
+	{
+		switch (dir)
+		{
+		case Dir::RIGHT: return 1;
+		case Dir::UP:    return 2;
+		case Dir::DOWN:  return 3;
+		default:         return 0;
+		}
+	}
 	// width, height and pos are in "Tile Space" (and not "Screen Space")
-	void drawDebugGrid(olc::PixelGameEngine& game, const int width, const int height, const olc::vi2d& pos = { 0, 0 })
+	void drawDebugGrid(Canvas& game, const int width, const int height, const olc::vi2d& pos = { 0, 0 })
 	{
 		for (int x = 0; x < width; x++)
 			for (int y = 0; y < height; y++)
@@ -179,13 +297,13 @@ namespace pm
 
 	struct GameObject
 	{
-		olc::PixelGameEngine& game;
+		Canvas& game;
 		Kind kind;
 		olc::vf2d vInitPos;
 		olc::Decal* image;
 		bool isOldschool; // true for isOldschool gameplay, false for futuristic gameplay
 
-		GameObject(olc::PixelGameEngine& game, Kind kind, const olc::vi2d& vInitPos, olc::Decal* image, bool isOldschool) :
+		GameObject(Canvas& game, Kind kind, const olc::vi2d& vInitPos, olc::Decal* image, bool isOldschool) :
 			game(game),
 			kind(kind),
 			vInitPos(vInitPos),
@@ -200,7 +318,7 @@ namespace pm
 	{
 		uint8_t walls; // 0b1111, one bit for each wall (up / down / left / right)
 		olc::Pixel color;
-		Wall(olc::PixelGameEngine& game, const olc::vi2d& vInitPos, bool isOldschool = true, olc::Decal* image = nullptr, const olc::Pixel color = olc::WHITE) :
+		Wall(Canvas& game, const olc::vi2d& vInitPos, bool isOldschool = true, olc::Decal* image = nullptr, const olc::Pixel color = olc::WHITE) :
 			GameObject(game, Kind::WALL, vInitPos, image, isOldschool),
 			walls(0b1111),
 			color(color)
@@ -222,7 +340,7 @@ namespace pm
 	struct Dot : public GameObject
 	{
 		int value;
-		Dot(olc::PixelGameEngine& game, const olc::vi2d& vInitPos, bool isOldschool = true, olc::Decal* image = nullptr) :
+		Dot(Canvas& game, const olc::vi2d& vInitPos, bool isOldschool = true, olc::Decal* image = nullptr) :
 			GameObject(game, Kind::DOT, vInitPos, image, isOldschool),
 			value(isOldschool ? nDotValue : randomBool(0.6f))
 		{}
@@ -237,7 +355,7 @@ namespace pm
 	struct PowerUp : public GameObject
 	{
 		float time;
-		PowerUp(olc::PixelGameEngine& game, const olc::vi2d& vInitPos, bool isOldschool = true, olc::Decal * image = nullptr) :
+		PowerUp(Canvas& game, const olc::vi2d& vInitPos, bool isOldschool = true, olc::Decal * image = nullptr) :
 			GameObject(game, Kind::POWER_UP, vInitPos, image, isOldschool),
 			time(0)
 		{}
@@ -251,6 +369,22 @@ namespace pm
 		}
 	};
 
+	// Everything about a mover that changes while it plays, see Level::save(). One shape
+	// for all of them; what a field means past iSpeed is up to the kind of mover
+	struct MoverState
+	{
+		olc::vf2d vPos;
+		Dir currDir;
+		Dir nextDir;
+		int iSpeed;
+		int nState;       // ghosts from here on
+		float fWeakTime;
+		bool bGoingHome;
+		olc::vi2d vDecidedTile;
+		float fPassedTime;
+		int nMode;        // what the ghost is up to, or which way pacman faces
+	};
+
 	class MoveableObject : public GameObject
 	{
 	protected:
@@ -262,7 +396,7 @@ namespace pm
 		int iLevelWidth;
 		int iLevelHeight;
 	public:
-		MoveableObject(olc::PixelGameEngine& game, const Kind kind, const olc::vf2d& pos, olc::Decal* image, bool isOldschool, const int speed, const int iLevelWidth, const int iLevelHeight, const Dir dir = Dir::RIGHT) :
+		MoveableObject(Canvas& game, const Kind kind, const olc::vf2d& pos, olc::Decal* image, bool isOldschool, const int speed, const int iLevelWidth, const int iLevelHeight, const Dir dir = Dir::RIGHT) :
 			GameObject(game, kind, pos, image, isOldschool),
 			initDir(dir),
 			iSpeed(speed),
@@ -290,11 +424,25 @@ namespace pm
 		{
 			stepBack();
 		}
-		void resetPos()
+		virtual void resetPos()
 		{
 			vPos = vInitPos;
 			currDir = nextDir = initDir;
 		}
+		virtual void saveState(MoverState& state) const
+		{
+			state.vPos = vPos;
+			state.currDir = currDir;
+			state.nextDir = nextDir;
+			state.iSpeed = iSpeed;
+		}
+		virtual void loadState(const MoverState& state)
+		{
+			vPos = state.vPos;
+			currDir = state.currDir;
+			nextDir = state.nextDir;
+			iSpeed = state.iSpeed;
+		}
 		const olc::vf2d& getPos() const { return vPos; }
 		olc::vf2d* getPosPtr() { return &vPos; }
 		void setPos(olc::vf2d& pos) { vPos = pos; }
@@ -349,14 +497,15 @@ namespace pm
 		olc::vf2d* vTargetPos;
 		olc::vf2d* vCurrTarget;
 		BOARD_MAP& board;
-
-		/* a map of distances from target.
-		positive number = the distance.
-		-1 = wall.
-		-2 = this (ghost). */
-		int* map;
+		Pathfinder& paths; // the level's, shared by all its ghosts
+		olc::vi2d vDecidedTile; // where atJunction() last looked
+		// a smartChase() answer worked out ahead of time, see planRoute()
+		olc::vi2d vPlanFrom;
+		olc::vi2d vPlanTo;
+		int nPlanStep;
+		std::minstd_rand* pRandom; // null for rand(), see Level::useOwnRandom()
 	public:
-		Ghost(olc::PixelGameEngine& game, const olc::vi2d& vPos, olc::Decal* image, olc::Pixel color, Kind kind, const int levelWidth, const int levelHeight, BOARD_MAP& board, bool isOldschool = true, olc::vf2d* vTargetPos = nullptr, const Dir initialDir = Dir::RIGHT) :
+		Ghost(Canvas& game, const olc::vi2d& vPos, olc::Decal* image, olc::Pixel color, Kind kind, const int levelWidth, const int levelHeight, BOARD_MAP& board, Pathfinder& paths, bool isOldschool = true, olc::vf2d* vTargetPos = nullptr, const Dir initialDir = Dir::RIGHT) :
 			MoveableObject(game, kind, vPos, image, isOldschool, nGhostSpeed, levelWidth, levelHeight, initialDir),
 			color(color),
 			currState(GhostState::STRONG),
@@ -364,15 +513,42 @@ namespace pm
 			vTargetPos(vTargetPos),
 			vCurrTarget(vTargetPos),
 			board(board),
-			map(new int[levelWidth * levelHeight])
+			paths(paths),
+			vDecidedTile(-1, -1),
+			vPlanFrom(-1, -1),
+			vPlanTo(-1, -1),
+			nPlanStep(-1),
+			pRandom(nullptr)
 		{}
-		virtual ~Ghost() { delete map; }
+		virtual ~Ghost() {}
 		virtual void recalculateRoute() = 0;
 		void collideWithWall() override
 		{
 			stepBack();
 			recalculateRoute();
 		}
+		void resetPos() override
+		{
+			MoveableObject::resetPos();
+			vDecidedTile = { -1, -1 };
+		}
+		void saveState(MoverState& state) const override
+		{
+			MoveableObject::saveState(state);
+			state.nState = int(currState);
+			state.fWeakTime = fWeakTime;
+			state.bGoingHome = vCurrTarget == &vInitPos;
+			state.vDecidedTile = vDecidedTile;
+		}
+		void loadState(const MoverState& state) override
+		{
+			MoveableObject::loadState(state);
+			currState = GhostState(state.nState);
+			fWeakTime = state.fWeakTime;
+			vCurrTarget = state.bGoingHome ? &vInitPos : vTargetPos;
+			vDecidedTile = state.vDecidedTile;
+			vPlanFrom = { -1, -1 };
+		}
 		void update(float fElapsedTime)
 		{
 			switch (currState)
@@ -381,6 +557,24 @@ namespace pm
 			case GhostState::WEAK:	 updateWeak(fElapsedTime); break;
 			case GhostState::EATEN:  updateEaten(fElapsedTime); break;
 			}
+			vPlanFrom = { -1, -1 };
+		}
+		// The route smartChase() looks likely to ask for in this tick's update(). Only reads,
+		// so every ghost can be asked at once while nothing moves
+		bool nextRoute(olc::vi2d& from, olc::vi2d& to) const
+		{
+			from = screenToTile(vPos);
+			if (vCurrTarget == nullptr || from == vDecidedTile || !paths.isJunction(from))
+				return false;
+			to = screenToTile(*vCurrTarget);
+			return currState == GhostState::EATEN || (currState == GhostState::STRONG && chasesSmartly());
+		}
+		// the answer to nextRoute(), only used if update() does ask exactly that
+		void planRoute(const olc::vi2d& from, const olc::vi2d& to, const int nStep)
+		{
+			vPlanFrom = from;
+			vPlanTo = to;
+			nPlanStep = nStep;
 		}
 		void draw(const olc::vf2d& offset = { 0.0f, 0.0f }) const override
 		{
@@ -401,14 +595,19 @@ namespace pm
 		{
 			iSpeed = nGhostSpeed * 1.5f;
 			vCurrTarget = &vInitPos;
+			paths.track(screenToTile(vInitPos)); // home doesn't move, no need to search for it each time
 			currState = GhostState::EATEN;
 		}
 		GhostState getState() const { return currState; }
+		void useRandom(std::minstd_rand* pEngine) { pRandom = pEngine; }
+		// seconds until it can eat pacman again, 0 when it already can
+		float weakTimeLeft() const { return currState == GhostState::STRONG ? 0.0f : fWeakTime; }
 		void updateTarget(olc::vf2d* vTarget) { vTargetPos = vTarget; vCurrTarget = vTargetPos; }
 	private:
 		virtual void updateStrong(float fElapsedTime)
 		{
-			recalculateRoute();
+			if (atJunction())
+				recalculateRoute();
 			stepForward(fElapsedTime);
 		}
 		void updateWeak(float fElapsedTime)
@@ -424,131 +623,70 @@ namespace pm
 		void updateEaten(float fElapsedTime)
 		{
 			updateWeak(fElapsedTime);
-			smartChase();
+			if (atJunction())
+				smartChase();
 			stepForward(fElapsedTime);
 		}
 	protected:
-		// update nextDir to chase pacman smartly
+		virtual bool chasesSmartly() const { return false; }
+		// True once per junction, the only tiles with a route to choose. Anywhere else the
+		// corridor decides, so nextDir just follows it. Call every tick before stepForward
+		bool atJunction()
+		{
+			const olc::vi2d tile = screenToTile(vPos);
+			if (tile == vDecidedTile)
+				return false;
+			vDecidedTile = tile;
+			if (paths.isJunction(tile))
+				return true;
+			nextDir = stepToDir(paths.followCorridor(tile, dirToStep(currDir)));
+			return false;
+		}
+		// update nextDir to chase pacman smartly, along a shortest path (wrapping round the
+		// border too). Ties go left, right, up, down, the order the old flood fill tried them
 		void smartChase()
 		{
-			// initialize the map
-			map = new int[iLevelWidth * iLevelHeight];
-			for (int x = 0; x < iLevelWidth; x++)
-				for (int y = 0; y < iLevelHeight; y++)
-				{
-					BOARD_MAP::const_iterator it = board.find(olc::vi2d(x, y));
-					if (it != board.end() && it->second->kind == Kind::WALL)
-						map[x + y * iLevelWidth] = -1;
-					else
-						map[x + y * iLevelWidth] = 0;
-				}
-
-			// fill the map with numbers
-			olc::vi2d vTargetTile = screenToTile(*vCurrTarget);
-			olc::vi2d vMyTile = screenToTile(vPos);
-			map[vTargetTile.x + iLevelWidth * vTargetTile.y] = 0;
-			map[vMyTile.x + iLevelWidth * vMyTile.y] = -2;
-			fillMap(vTargetTile.x, vTargetTile.y, 1);
-			map[vMyTile.x + iLevelWidth * vMyTile.y] = 0;
-
-			// decide on route
-			int min = iLevelWidth * iLevelHeight;
-			int minI = 0;
-			olc::vi2d possibleTiles[4] = {
-				olc::vi2d(vMyTile.x - 1, vMyTile.y), // 0
-				olc::vi2d(vMyTile.x + 1, vMyTile.y), // 1
-				olc::vi2d(vMyTile.x, vMyTile.y - 1), // 2
-				olc::vi2d(vMyTile.x, vMyTile.y + 1)  // 3
-			};
-			for (int i = 0; i < 4; ++i)
-			{
-				olc::vi2d tile = possibleTiles[i];
-				if (tile.x < 0 || tile.x >= iLevelWidth || tile.y < 0 || tile.y >= iLevelHeight
-					|| map[tile.x + tile.y * iLevelWidth] <= 0)
-					continue;
-				int distance = map[tile.x + iLevelWidth * tile.y];
-				if (distance >= 0 && distance < min)
-				{
-					min = distance;
-					minI = i;
-				}
-			}
-
-			// update nextDir
-			switch (minI)
-			{
-			case 0: nextDir = Dir::LEFT;  break;
-			case 1: nextDir = Dir::RIGHT; break;
-			case 2: nextDir = Dir::UP;	  break;
-			case 3: nextDir = Dir::DOWN;  break;
-			}
+			TraceRecorder::Scope trace("smartChase", "ai");
+			trace.arg("width", paths.topology().width()).arg("height", paths.topology().height());
+			const olc::vi2d from = screenToTile(vPos);
+			const olc::vi2d to = screenToTile(*vCurrTarget);
+			// no way there (-1) goes left, as it always did
+			nextDir = stepToDir(from == vPlanFrom && to == vPlanTo ? nPlanStep : paths.firstStep(from, to));
 		}
+		// straight at the target, the short way round through a tunnel if there is one
 		void dumbChase1()
 		{
-			olc::vi2d targetTile = screenToTile(*vCurrTarget);
-			olc::vi2d myTile = screenToTile(vPos);
-			nextDir = (targetTile.x == myTile.x ? (targetTile.y > myTile.y ? Dir::DOWN : Dir::UP) : (targetTile.x > myTile.x ? Dir::RIGHT : Dir::LEFT));
+			const olc::vi2d d = paths.topology().offset(screenToTile(vPos), screenToTile(*vCurrTarget));
+			nextDir = (d.x == 0 ? (d.y > 0 ? Dir::DOWN : Dir::UP) : (d.x > 0 ? Dir::RIGHT : Dir::LEFT));
 		}
 		void dumbChase2()
 		{
-			olc::vi2d targetTile = screenToTile(*vCurrTarget);
-			olc::vi2d myTile = screenToTile(vPos);
-			nextDir = (targetTile.y == myTile.y ? (targetTile.x > myTile.x ? Dir::RIGHT : Dir::LEFT) : (targetTile.y > myTile.y ? Dir::DOWN : Dir::UP));
+			const olc::vi2d d = paths.topology().offset(screenToTile(vPos), screenToTile(*vCurrTarget));
+			nextDir = (d.y == 0 ? (d.x > 0 ? Dir::RIGHT : Dir::LEFT) : (d.y > 0 ? Dir::DOWN : Dir::UP));
 		}
+		int random() { return pRandom ? int((*pRandom)() & RAND_MAX) : rand(); }
 		void dumbMoving()
 		{
 			switch (currDir)
 			{
 			case Dir::UP:
 			case Dir::DOWN:
-				nextDir = rand() % 2 == 0 ? Dir::LEFT : Dir::RIGHT;
+				nextDir = random() % 2 == 0 ? Dir::LEFT : Dir::RIGHT;
 				break;
 			case Dir::LEFT:
 			case Dir::RIGHT:
-				nextDir = rand() % 2 == 0 ? Dir::UP : Dir::DOWN;
+				nextDir = random() % 2 == 0 ? Dir::UP : Dir::DOWN;
 				break;
 			}
 		}
-	private:
-		void fillMap(int x, int y, int val)
-		{
-			if ((map[x + y * iLevelWidth] < val && map[x + y * iLevelWidth] != 0))
-				return;
-
-			map[x + y * iLevelWidth] = val;
-
-			if (x - 1 >= 0 || !(map[x - 1 + y * iLevelWidth] <= val && map[x - 1 + y * iLevelWidth] != 0))
-				fillMap(x - 1, y, val + 1);
-			if (x + 1 < iLevelWidth || !(map[x + 1 + y * iLevelWidth] <= val && map[x + 1 + y * iLevelWidth] != 0))
-				fillMap(x + 1, y, val + 1);
-			if (y - 1 >= 0 || !(map[x + (y - 1) * iLevelWidth] <= val && map[x + (y - 1) * iLevelWidth] != 0))
-				fillMap(x, y - 1, val + 1);
-			if (y + 1 < iLevelHeight || !(map[x + (y + 1) * iLevelWidth] <= val && map[x + (y + 1) * iLevelWidth] != 0))
-				fillMap(x, y + 1, val + 1);
-		}
-		void printMap()
-		{
-			std::cout << "printing map" << std::endl;
-			for (int x = 0; x < iLevelWidth; x++)
-			{
-				for (int y = 0; y < iLevelHeight; y++)
-				{
-					int val = map[y + x * iLevelWidth];
-					if (val < 10 && val >= 0)
-						std::cout << " ";
-					std::cout << val << "|";
-				}
-				std::cout << std::endl;
-			}
-		}
 	};
 
 	// Yellow ghost: changes directions only when hittin' walls.
 	class YellowGhost : public Ghost
 	{
 	public:
-		YellowGhost(olc::PixelGameEngine& game, const olc::vi2d& vPos, const int levelWidth, const int levelHeight, BOARD_MAP& board, bool isOldschool = true, olc::Decal* image = nullptr, olc::vf2d* vTargetPos = nullptr) :
-			Ghost(game, vPos, image, olc::YELLOW, Kind::GHOST_Y, levelWidth, levelHeight, board, isOldschool, vTargetPos, Dir::DOWN)
+		YellowGhost(Canvas& game, const olc::vi2d& vPos, const int levelWidth, const int levelHeight, BOARD_MAP& board, Pathfinder& paths, bool isOldschool = true, olc::Decal* image = nullptr, olc::vf2d* vTargetPos = nullptr) :
+			Ghost(game, vPos, image, olc::YELLOW, Kind::GHOST_Y, levelWidth, levelHeight, board, paths, isOldschool, vTargetPos, Dir::DOWN)
 		{}
 		void updateStrong(float fElapsedTime) override
 		{
@@ -570,8 +708,8 @@ namespace pm
 		float fPassedTime;
 		bool bSmart;
 	public:
-		BlueGhost(olc::PixelGameEngine& game, const olc::vi2d& vPos, const int levelWidth, const int levelHeight, BOARD_MAP& board, bool isOldschool = true, olc::Decal* image = nullptr, olc::vf2d* vTargetPos = nullptr) :
-			Ghost(game, vPos, image, olc::BLUE, Kind::GHOST_B, levelWidth, levelHeight, board, isOldschool, vTargetPos, Dir::DOWN),
+		BlueGhost(Canvas& game, const olc::vi2d& vPos, const int levelWidth, const int levelHeight, BOARD_MAP& board, Pathfinder& paths, bool isOldschool = true, olc::Decal* image = nullptr, olc::vf2d* vTargetPos = nullptr) :
+			Ghost(game, vPos, image, olc::BLUE, Kind::GHOST_B, levelWidth, levelHeight, board, paths, isOldschool, vTargetPos, Dir::DOWN),
 			fPassedTime(0.0f),
 			bSmart(true)
 		{}
@@ -584,13 +722,28 @@ namespace pm
 				fPassedTime = 0;
 			}
 
-			recalculateRoute();
+			if (atJunction())
+				recalculateRoute();
 			stepForward(fElapsedTime);
 		}
 		void recalculateRoute() override
 		{
 			bSmart ? smartChase() : dumbChase1();
 		}
+		void saveState(MoverState& state) const override
+		{
+			Ghost::saveState(state);
+			state.fPassedTime = fPassedTime;
+			state.nMode = bSmart;
+		}
+		void loadState(const MoverState& state) override
+		{
+			Ghost::loadState(state);
+			fPassedTime = state.fPassedTime;
+			bSmart = state.nMode != 0;
+		}
+	protected:
+		bool chasesSmartly() const override { return bSmart; }
 	};
 
 	// Red ghost: mostly dumb moving, a little dumb chasing
@@ -602,8 +755,8 @@ namespace pm
 		float fPassedTime;
 		bool bSmart;
 	public:
-		RedGhost(olc::PixelGameEngine& game, const olc::vi2d& vPos, const int levelWidth, const int levelHeight, BOARD_MAP& board, bool isOldschool = true, olc::Decal* image = nullptr, olc::vf2d* vTargetPos = nullptr) :
-			Ghost(game, vPos, image, olc::RED, Kind::GHOST_R, levelWidth, levelHeight, board, isOldschool, vTargetPos),
+		RedGhost(Canvas& game, const olc::vi2d& vPos, const int levelWidth, const int levelHeight, BOARD_MAP& board, Pathfinder& paths, bool isOldschool = true, olc::Decal* image = nullptr, olc::vf2d* vTargetPos = nullptr) :
+			Ghost(game, vPos, image, olc::RED, Kind::GHOST_R, levelWidth, levelHeight, board, paths, isOldschool, vTargetPos),
 			fPassedTime(0.0f),
 			bSmart(true)
 		{}
@@ -616,13 +769,26 @@ namespace pm
 				fPassedTime = 0;
 			}
 
-			recalculateRoute();
+			if (atJunction())
+				recalculateRoute();
 			stepForward(fElapsedTime);
 		}
 		void recalculateRoute() override
 		{
 			bSmart ? dumbChase2() : dumbMoving();
 		}
+		void saveState(MoverState& state) const override
+		{
+			Ghost::saveState(state);
+			state.fPassedTime = fPassedTime;
+			state.nMode = bSmart;
+		}
+		void loadState(const MoverState& state) override
+		{
+			Ghost::loadState(state);
+			fPassedTime = state.fPassedTime;
+			bSmart = state.nMode != 0;
+		}
 	};
 
 	// Green ghost: every 5 seconds changes behaviour randomly
@@ -639,8 +805,8 @@ namespace pm
 		float fPassedTime;
 		Behaviour behaviour;
 	public:
-		GreenGhost(olc::PixelGameEngine& game, const olc::vi2d& vPos, const int levelWidth, const int levelHeight, BOARD_MAP& board, bool isOldschool = true, olc::Decal* image = nullptr, olc::vf2d* vTargetPos = nullptr) :
-			Ghost(game, vPos, image, olc::GREEN, Kind::GHOST_G, levelWidth, levelHeight, board, isOldschool, vTargetPos),
+		GreenGhost(Canvas& game, const olc::vi2d& vPos, const int levelWidth, const int levelHeight, BOARD_MAP& board, Pathfinder& paths, bool isOldschool = true, olc::Decal* image = nullptr, olc::vf2d* vTargetPos = nullptr) :
+			Ghost(game, vPos, image, olc::GREEN, Kind::GHOST_G, levelWidth, levelHeight, board, paths, isOldschool, vTargetPos),
 			fPassedTime(0.0f),
 			behaviour(Behaviour::DUMB1)
 		{}
@@ -648,7 +814,7 @@ namespace pm
 		{
 			if ((fPassedTime += fElapsedTime) > TIME_OF_BEHAVIOUR)
 			{
-				switch (rand() % 6)
+				switch (random() % 6)
 				{
 				case 1:  behaviour = Behaviour::SMART; break;
 				case 2:  behaviour = Behaviour::DUMB1; break;
@@ -658,7 +824,7 @@ namespace pm
 				fPassedTime = 0;
 			}
 
-			if (behaviour != Behaviour::DUMB3)
+			if (behaviour != Behaviour::DUMB3 && atJunction())
 				recalculateRoute();
 			stepForward(fElapsedTime);
 		}
@@ -672,6 +838,20 @@ namespace pm
 			case Behaviour::DUMB3: dumbMoving(); return;
 			}
 		}
+		void saveState(MoverState& state) const override
+		{
+			Ghost::saveState(state);
+			state.fPassedTime = fPassedTime;
+			state.nMode = int(behaviour);
+		}
+		void loadState(const MoverState& state) override
+		{
+			Ghost::loadState(state);
+			fPassedTime = state.fPassedTime;
+			behaviour = Behaviour(state.nMode);
+		}
+	protected:
+		bool chasesSmartly() const override { return behaviour == Behaviour::SMART; }
 	};
 
 #pragma endregion
@@ -680,19 +860,36 @@ namespace pm
 	{
 		bool wasRight;
 	public:
-		Pacman(olc::PixelGameEngine& game, const olc::vi2d& vInitPos, const int iLevelWidth, const int iLevelHeight, bool isOldschool = true, olc::Decal * image = nullptr) :
+		Pacman(Canvas& game, const olc::vi2d& vInitPos, const int iLevelWidth, const int iLevelHeight, bool isOldschool = true, olc::Decal * image = nullptr) :
 			MoveableObject(game, Kind::PLAYER, vInitPos, image, isOldschool, int(nPacmanSpeed), iLevelWidth, iLevelHeight),
 			wasRight(true)
 		{}
-		void getInput(olc::PixelGameEngine& game)
+		void getInput(Canvas& game)
 		{
 			if (game.GetKey(olc::UP).bPressed)		nextDir = Dir::UP;
 			if (game.GetKey(olc::DOWN).bPressed)	nextDir = Dir::DOWN;
 			if (game.GetKey(olc::LEFT).bPressed)  { nextDir = Dir::LEFT;  wasRight = false; }
 			if (game.GetKey(olc::RIGHT).bPressed) { nextDir = Dir::RIGHT; wasRight = true;  }
 		}
+		// the same as the arrow keys, for whatever drives pacman instead of them
+		void steer(const Dir dir)
+		{
+			nextDir = dir;
+			if (dir == Dir::LEFT)  wasRight = false;
+			if (dir == Dir::RIGHT) wasRight = true;
+		}
 		void update(float fElapsedTime) { stepForward(fElapsedTime); }
 		void collideWithWall() override { stepBack(); }
+		void saveState(MoverState& state) const override
+		{
+			MoveableObject::saveState(state);
+			state.nMode = wasRight;
+		}
+		void loadState(const MoverState& state) override
+		{
+			MoveableObject::loadState(state);
+			wasRight = state.nMode != 0;
+		}
 		void draw(const olc::vf2d& offset = { 0.0f, 0.0f }) const override
 		{
 			olc::Pixel color = isOldschool ? olc::YELLOW : olc::YELLOW;
@@ -717,10 +914,11 @@ namespace pm
 	};
 
 	struct Level {
-		olc::PixelGameEngine& game;
+		Canvas& game;
 		olc::vi2d vPos; // in screen space
 		std::vector<olc::Decal*>& decals;
 		BOARD_MAP board;
+		Pathfinder paths; // walls only, for the ghosts
 		bool isOldschool;
 		std::vector<std::shared_ptr<Ghost>> ghosts;
 		std::vector<std::shared_ptr<PowerUp>> powerUps;
@@ -728,28 +926,51 @@ namespace pm
 		int width;
 		int height;
 		int iDots;
-		Level(olc::PixelGameEngine& game, std::vector<olc::Decal*>& decals, const olc::vi2d& pos = { 0, 0 }, bool isOldschool = true, const int width = DEFAULT_LEVEL_WIDTH, const int height = DEFAULT_LEVEL_HEIGHT) :
+		std::minstd_rand dice; // the ghosts', once useOwnRandom() is called
+		// Dots and power ups eaten, a bit per tile. They're kept off the board rather than
+		// freed, so load() can put them back without allocating
+		std::vector<uint64_t> vTaken;
+		std::vector<BOARD_MAP::node_type> vTakenNodes;
+		bool bKeepTaken; // see keepTaken()
+
+		// what save() keeps of a level in play, sized by the first save() and reused after
+		struct State
+		{
+			std::vector<uint64_t> vTaken;
+			std::vector<MoverState> vMovers; // the player, then the ghosts in order
+			int iDots;
+			std::minstd_rand dice;
+		};
+
+		Level(Canvas& game, std::vector<olc::Decal*>& decals, const olc::vi2d& pos = { 0, 0 }, bool isOldschool = true, const int width = DEFAULT_LEVEL_WIDTH, const int height = DEFAULT_LEVEL_HEIGHT) :
 			game(game),
 			vPos(pos),
 			decals(decals),
 			board(MAKE_BOARD),
+			paths(width, height),
 			isOldschool(isOldschool),
 			player(nullptr),
 			width(width),
 			height(height),
-			iDots(0)
-		{}
-		Level(olc::PixelGameEngine& game, std::vector<olc::Decal*>& decals, LevelData data, bool isOldschool = true, const olc::vi2d& pos = { 0, 0 }) :
+			iDots(0),
+			bKeepTaken(false)
+		{
+			resizeTaken();
+		}
+		Level(Canvas& game, std::vector<olc::Decal*>& decals, LevelData data, bool isOldschool = true, const olc::vi2d& pos = { 0, 0 }) :
 			game(game),
 			vPos(pos),
 			decals(decals),
 			board(MAKE_BOARD),
+			paths(data.width, data.height),
 			isOldschool(isOldschool),
 			player(nullptr),
-			iDots(0)
+			iDots(0),
+			bKeepTaken(false)
 		{
 			width = data.width;
 			height = data.height;
+			resizeTaken();
 
 			for (int x = 0; x < width; x++)
 				for (int y = 0; y < height; y++)
@@ -775,10 +996,157 @@ namespace pm
 				}
 			}
 		}
+		// For levels played side by side on other threads: the ghosts stop sharing rand()
+		void useOwnRandom(const uint32_t seed)
+		{
+			dice.seed(seed);
+			for (auto& ghost : ghosts)
+				ghost->useRandom(&dice);
+		}
+
+		// Snapshots for searching ahead, cheap enough to take every move: a few words of
+		// eaten tiles and the movers. load() takes a state saved from this level or from
+		// any other built from the same LevelData, only the tiles that differ are touched
+		// For copies that only play, never draw: eaten things stay on the board and only
+		// vTaken says they're gone, so load() is down to copying words
+		void keepTaken() { bKeepTaken = true; }
+		bool isTaken(const olc::vi2d& tile) const
+		{
+			const int n = tile.y * width + tile.x;
+			return vTaken[n / 64] >> (n % 64) & 1;
+		}
+		void save(State& state) const
+		{
+			state.vTaken = vTaken;
+			state.vMovers.resize(ghosts.size() + 1);
+			player->saveState(state.vMovers[0]);
+			for (size_t i = 0; i < ghosts.size(); i++)
+				ghosts[i]->saveState(state.vMovers[i + 1]);
+			state.iDots = iDots;
+			state.dice = dice;
+		}
+		void load(const State& state)
+		{
+			for (size_t w = 0; w < vTaken.size() && !bKeepTaken; w++)
+			{
+				const uint64_t diff = vTaken[w] ^ state.vTaken[w];
+				if (diff == 0)
+					continue;
+				for (int b = 0; b < 64; b++)
+					if (diff >> b & 1)
+					{
+						const int n = int(w) * 64 + b;
+						if (vTaken[w] >> b & 1)
+							board.insert(std::move(vTakenNodes[n]));
+						else
+							vTakenNodes[n] = board.extract(olc::vi2d(n % width, n / width));
+					}
+			}
+			vTaken = state.vTaken;
+			player->loadState(state.vMovers[0]);
+			for (size_t i = 0; i < ghosts.size(); i++)
+				ghosts[i]->loadState(state.vMovers[i + 1]);
+			iDots = state.iDots;
+			dice = state.dice;
+		}
+
+#pragma region Rules
+		// what happened in movePlayer() and moveGhosts(), in the order it happened
+		enum class Event {
+			DOT,         // passed the dot, before it goes
+			POWER_UP,    // passed the power up, before it goes
+			CLEARED,     // that was the last dot, passed the player
+			CAUGHT,      // passed the ghost, resetPositions() or not is up to the listener
+			GHOST_EATEN, // passed the ghost
+		};
+
+		// One tick of play is movePlayer() then, unless the level got cleared, moveGhosts().
+		// onEvent(Event, GameObject&) hears about everything that scores or ends something
+		template<typename F>
+		void movePlayer(const float fElapsedTime, F&& onEvent)
+		{
+			player->update(fElapsedTime);
+			BOARD_MAP::iterator it = player->getCollision(board);
+			if (it == board.end() || isTaken(it->first))
+				return;
+			switch (it->second->kind) // check collision with...
+			{
+			case Kind::WALL:
+				player->collideWithWall();
+				break;
+			case Kind::DOT:
+				onEvent(Event::DOT, *it->second);
+				take(it);
+				if (--iDots == 0) // end level!
+					onEvent(Event::CLEARED, *player);
+				break;
+			case Kind::POWER_UP:
+				onEvent(Event::POWER_UP, *it->second);
+				std::for_each(ghosts.begin(), ghosts.end(), [&](auto& ghost) { ghost->makeWeak(); });
+				take(it);
+				break;
+			}
+		}
+		template<typename F>
+		void moveGhosts(const float fElapsedTime, F&& onEvent)
+		{
+			for (auto& ghost : ghosts)
+			{
+				// move forward
+				ghost->update(fElapsedTime);
+
+				// check collision of ghost with pacman
+				if (checkCollision(player->getPos(), ghost->getPos()))
+				{
+					switch (ghost->getState())
+					{
+					case Ghost::GhostState::STRONG:
+						onEvent(Event::CAUGHT, *ghost);
+						break;
+					case Ghost::GhostState::WEAK:
+						ghost->makeEaten();
+						onEvent(Event::GHOST_EATEN, *ghost);
+						break;
+						//case Ghost::GhostState::EATEN: break;
+					}
+				}
+
+				// check collision of ghost with walls
+				BOARD_MAP::iterator it = ghost->getCollision(board);
+				if (it != board.end() && it->second->kind == Kind::WALL)
+					ghost->collideWithWall();
+			}
+		}
+		// everyone back where they started, after pacman got caught
+		void resetPositions()
+		{
+			player->resetPos();
+			std::for_each(ghosts.begin(), ghosts.end(), [&](auto ghost) { ghost->resetPos(); });
+		}
+	private:
+		void take(BOARD_MAP::iterator it)
+		{
+			const int n = it->first.y * width + it->first.x;
+			vTaken[n / 64] |= uint64_t(1) << (n % 64);
+			if (!bKeepTaken)
+				vTakenNodes[n] = board.extract(it);
+		}
+		// forgets what was eaten, the tiles are numbered differently now
+		void resizeTaken()
+		{
+			vTaken.assign((width * height + 63) / 64, 0);
+			vTakenNodes.clear();
+			vTakenNodes.resize(width * height);
+		}
+	public:
+#pragma endregion
+
 		void incrementWidth(const int value)
 		{
 			width += value;
 			if (width < 0) width = 0;
+			paths.resize(width, height);
+			resizeTaken();
 			if (value < 0)
 				for (int x = width; x < width - value; x++)
 					for (int y = 0; y < height; y++)
@@ -788,6 +1156,8 @@ namespace pm
 		{
 			height += value;
 			if (height < 0) height = 0;
+			paths.resize(width, height);
+			resizeTaken();
 			if (value  < 0)
 				for (int x = 0; x < width; x++)
 					for (int y = height; y < height - value; y++)
@@ -809,7 +1179,7 @@ namespace pm
 			case Kind::GHOST_Y:  ghost = MAKE_GHOST(YellowGhost); break;
 			case Kind::GHOST_G:  ghost = MAKE_GHOST(GreenGhost);  break;
 			case Kind::DOT:      board.emplace(MAKE_TILE(game, Dot, nullptr));  ++iDots;   break;
-			case Kind::WALL:     board.emplace(MAKE_TILE(game, Wall/*, decals[SPRITE_WALL]*/, nullptr));    break;  break;
+			case Kind::WALL:     if (board.emplace(MAKE_TILE(game, Wall/*, decals[SPRITE_WALL]*/, nullptr)).second) paths.setWall(pos, true); break;
 			case Kind::POWER_UP: {std::shared_ptr<PowerUp> pu(new PowerUp(game, tileToScreen(pos), isOldschool)); board.emplace(std::make_pair(pos, pu)); powerUps.push_back(pu);  break; }
 			}
 
@@ -823,6 +1193,7 @@ namespace pm
 		void eraseAt(olc::vi2d pos)
 		{
 			board.erase(pos - screenToTile(vPos));
+			paths.setWall(pos - screenToTile(vPos), false);
 			std::remove_if(ghosts.begin(), ghosts.end(), [&](auto ghost) {return screenToTile(ghost->getPos() - vPos) == pos; });
 			if (player != nullptr && screenToTile(player->getPos() - vPos) == pos)
 				player.reset();
@@ -869,9 +1240,9 @@ namespace pm
 
 	struct UI
 	{
-		olc::PixelGameEngine& game;
+		Canvas& game;
 		olc::vf2d vPos;
-		UI(olc::PixelGameEngine& game, olc::vf2d pos) : game(game), vPos(pos) {}
+		UI(Canvas& game, olc::vf2d pos) : game(game), vPos(pos) {}
 		virtual void draw(const olc::vf2d& offset = { 0.0f, 0.0f }) const = 0;
 	};
 
@@ -879,7 +1250,7 @@ namespace pm
 	{
 		std::string text;
 		olc::Pixel color;
-		Title(olc::PixelGameEngine& game, olc::vf2d pos, std::string text, olc::Pixel color = olc::WHITE) :
+		Title(Canvas& game, olc::vf2d pos, std::string text, olc::Pixel color = olc::WHITE) :
 			UI(game, pos),
 			text(text),
 			color(color)
@@ -897,7 +1268,7 @@ namespace pm
 		std::string text;
 		int longestLine;
 		int numOfLines;
-		TextBox(olc::PixelGameEngine& game, olc::vf2d pos, std::string text) :
+		TextBox(Canvas& game, olc::vf2d pos, std::string text) :
 			UI(game, pos),
 			text(text),
 			longestLine(0),
@@ -935,7 +1306,7 @@ namespace pm
 		int* iText;
 		std::function<void()> fncOnClick;
 		bool isClickable;
-		Button(olc::PixelGameEngine& game, olc::vf2d pos, std::string text, std::function<void()> fncOnClick = [] {}, bool isClickable = true) :
+		Button(Canvas& game, olc::vf2d pos, std::string text, std::function<void()> fncOnClick = [] {}, bool isClickable = true) :
 			UI(game, pos),
 			vSize(tileToScreen(text.length(), 1) + vHalfTile),
 			text(text),
@@ -943,7 +1314,7 @@ namespace pm
 			fncOnClick(fncOnClick),
 			isClickable(isClickable)
 		{}
-		Button(olc::PixelGameEngine& game, olc::vf2d pos, int* text, std::function<void()> fncOnClick = [] {}, bool isClickable = true) :
+		Button(Canvas& game, olc::vf2d pos, int* text, std::function<void()> fncOnClick = [] {}, bool isClickable = true) :
 			UI(game, pos),
 			vSize(tileToScreen(std::to_string(*text).length(), 1) + vHalfTile),
 			text(std::to_string(*text)),
@@ -978,7 +1349,7 @@ namespace pm
 		bool isOn;
 
 	public:
-		Switch(olc::PixelGameEngine& game, olc::vf2d pos, std::string textOff, std::string textOn, std::function<void()> fncOnClick = [] {}, bool isOn = true) :
+		Switch(Canvas& game, olc::vf2d pos, std::string textOff, std::string textOn, std::function<void()> fncOnClick = [] {}, bool isOn = true) :
 			UI(game, pos),
 			vSize(tileToScreen(2, 1) + vHalfTile),
 			btn(game, vPos + tileToScreen(3, 0), isOn ? textOn : textOff, [] {}, false),
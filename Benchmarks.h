@@ -0,0 +1,298 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include "Game.h"
+
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+
+namespace pm
+{
+	// Times the hot paths on fixed inputs: the levels in PATH_DATA, a big maze made from a
+	// fixed seed and a made up tone, nothing that changes from run to run. Runs offscreen,
+	// inside OnUserCreate(), since drawing needs an engine but no window.
+	//
+	// Each benchmark warms up, then sizes a batch to about SAMPLE_TIME and times SAMPLES
+	// batches. The median is the number to compare, the spread says how far to trust it
+	class BenchmarkRunner : public olc::PixelGameEngine
+	{
+		static const int SAMPLES = 25;
+		static const int LARGE_FILE_COPIES = 100; // of PATH_DATA, for reading levels
+		static const int LARGE_MAZE = 128;        // tiles a side
+		static inline const std::chrono::duration<double> WARM_UP = std::chrono::milliseconds(50);
+		static inline const std::chrono::duration<double> SAMPLE_TIME = std::chrono::milliseconds(10);
+
+		struct Result
+		{
+			std::string sName;
+			long nIterations; // per sample
+			double fMedian;   // nanoseconds per call, and the rest likewise
+			double fMean;
+			double fDeviation;
+			double fMin;
+			double fMax;
+			double fInterval; // of the mean, 95%
+		};
+
+		std::string sJsonFile;
+		std::vector<Result> vResults;
+		volatile int nSink; // results go here so nothing is optimised away
+
+		Canvas canvas;
+		Snapshot snapshot;
+		std::unique_ptr<olc::Sprite> sprite;
+		std::unique_ptr<olc::Decal> decal;
+		std::vector<olc::Decal*> decals;
+
+		// BlueGhost with its smart chase made public
+		class ChaseProbe : public BlueGhost
+		{
+		public:
+			using BlueGhost::BlueGhost;
+			using Ghost::smartChase;
+		};
+
+	public:
+		bool bOk;
+
+		// empty writes no JSON
+		BenchmarkRunner(const std::string& sJsonFile) :
+			sJsonFile(sJsonFile),
+			nSink(0),
+			bOk(false)
+		{
+			sAppName = "Pacmanx10 benchmarks";
+		}
+
+		bool OnUserCreate() override
+		{
+			bOk = run();
+			return false; // nothing to show, stop here
+		}
+
+	private:
+		bool run()
+		{
+			olc::ResourcePack pack;
+			const std::string sData = readDataFile(pack.LoadPack(PATH_PACK, "") ? &pack : nullptr);
+			std::istringstream levelsFile(sData);
+			const std::vector<LevelData> levels = readLevels(levelsFile);
+			if (levels.size() <= size_t(NUM_OF_TUTORIAL_LEVELS))
+			{
+				std::cout << "can't read the levels in " << PATH_DATA << std::endl;
+				return false;
+			}
+
+			// anything moving is drawn with one plain decal
+			sprite = std::make_unique<olc::Sprite>(nTileSize, nTileSize);
+			decal = std::make_unique<olc::Decal>(sprite.get());
+			decals.assign(SPRITE_NAMES.size(), decal.get());
+
+			benchReadLevels(sData);
+			for (size_t i = 0; i < levels.size(); i++)
+				measure("Level/level" + std::string(i < 10 ? "0" : "") + std::to_string(i), [&] {
+					Level level(canvas, decals, levels[i]);
+					nSink = nSink + level.iDots;
+				});
+			benchChase("smartChase/small " + std::to_string(levels[NUM_OF_TUTORIAL_LEVELS].width) + "x" + std::to_string(levels[NUM_OF_TUTORIAL_LEVELS].height), levels[NUM_OF_TUTORIAL_LEVELS]);
+			benchChase("smartChase/large " + std::to_string(LARGE_MAZE) + "x" + std::to_string(LARGE_MAZE), largeMaze());
+			benchCollision(levels[NUM_OF_TUTORIAL_LEVELS]);
+			benchDraw(levels[NUM_OF_TUTORIAL_LEVELS]);
+			measure("DrawString", [&] { DrawString({ 4, 4 }, "Score: 1234567890", olc::WHITE, 1); });
+			benchMixer();
+
+			return writeJson();
+		}
+
+		// The median of SAMPLES batches of fn, calls to fill SAMPLE_TIME in each
+		template<typename F>
+		void measure(const std::string& sName, F fn)
+		{
+			using Clock = std::chrono::steady_clock;
+			long nCalls = 0;
+			const Clock::time_point tpStart = Clock::now();
+			while (Clock::now() - tpStart < WARM_UP || nCalls == 0)
+			{
+				fn();
+				nCalls++;
+			}
+			const double fGuess = std::chrono::duration<double>(Clock::now() - tpStart).count() / nCalls;
+			const long nIterations = std::max(1L, long(SAMPLE_TIME.count() / fGuess));
+
+			std::vector<double> vTimes(SAMPLES);
+			for (double& fTime : vTimes)
+			{
+				const Clock::time_point tpBatch = Clock::now();
+				for (long i = 0; i < nIterations; i++)
+					fn();
+				fTime = std::chrono::duration<double, std::nano>(Clock::now() - tpBatch).count() / nIterations;
+			}
+
+			std::sort(vTimes.begin(), vTimes.end());
+			double fSum = 0.0;
+			for (double fTime : vTimes) fSum += fTime;
+			const double fMean = fSum / SAMPLES;
+			double fSquares = 0.0;
+			for (double fTime : vTimes) fSquares += (fTime - fMean) * (fTime - fMean);
+			const double fDeviation = std::sqrt(fSquares / (SAMPLES - 1));
+			const double fInterval = 2.064 * fDeviation / std::sqrt(double(SAMPLES)); // t, 24 degrees of freedom
+			const Result result = { sName, nIterations, vTimes[SAMPLES / 2], fMean, fDeviation, vTimes.front(), vTimes.back(), fInterval };
+			vResults.push_back(result);
+
+			std::cout << std::left << std::setw(28) << sName << std::right << std::fixed << std::setprecision(1)
+				<< std::setw(12) << result.fMedian << " ns  +-" << std::setw(5) << 100.0 * result.fInterval / result.fMean << "%" << std::endl;
+		}
+
+		// what Game::getLevels() does once the file is open
+		void benchReadLevels(const std::string& sFile)
+		{
+			std::string sLarge;
+			for (int i = 0; i < LARGE_FILE_COPIES; i++)
+				sLarge += (i > 0 ? "\n\n" : "") + sFile; // a blank line between levels
+			measure("getLevels/" + std::to_string(sLarge.size() / 1024) + "KB", [&] {
+				std::istringstream input(sLarge);
+				nSink = nSink + int(readLevels(input).size());
+			});
+		}
+
+		// Open rooms with pillars and a scattering of walls, the player in one corner and a
+		// smart ghost in the other
+		static LevelData largeMaze()
+		{
+			LevelData maze = { std::string(LARGE_MAZE * LARGE_MAZE, SYMBOL_DOT), LARGE_MAZE, LARGE_MAZE };
+			std::minstd_rand random(1);
+			for (int y = 0; y < LARGE_MAZE; y++)
+				for (int x = 0; x < LARGE_MAZE; x++)
+				{
+					const bool bBorder = x == 0 || y == 0 || x == LARGE_MAZE - 1 || y == LARGE_MAZE - 1;
+					const bool bPillar = x % 4 == 2 && y % 4 == 2;
+					if (bBorder || bPillar || random() % 8 == 0)
+						maze.data[y * LARGE_MAZE + x] = SYMBOL_WALL;
+				}
+			maze.data[1 * LARGE_MAZE + 1] = SYMBOL_PLAYER;
+			maze.data[(LARGE_MAZE - 2) * LARGE_MAZE + LARGE_MAZE - 2] = SYMBOL_GHOSTB;
+			return maze;
+		}
+
+		// A ghost at each open tile in turn chases the player, so every call searches
+		void benchChase(const std::string& sName, const LevelData& maze)
+		{
+			Level level(canvas, decals, maze);
+			std::vector<olc::vi2d> vOpen;
+			for (int y = 0; y < maze.height; y++)
+				for (int x = 0; x < maze.width; x++)
+					if (!level.paths.isWall(olc::vi2d(x, y)))
+						vOpen.push_back({ x, y });
+			std::vector<olc::vi2d> vFrom; // 64 of them, spread over the whole maze
+			for (size_t n = 0; n < 64; n++)
+				vFrom.push_back(vOpen[n * vOpen.size() / 64]);
+			ChaseProbe ghost(canvas, tileToScreen(vFrom[0].x, vFrom[0].y), maze.width, maze.height, level.board, level.paths, true, decal.get(), level.player->getPosPtr());
+			size_t i = 0;
+			measure(sName, [&] {
+				ghost.setPos(tileToScreen(vFrom[i].x, vFrom[i].y));
+				i = (i + 1) % vFrom.size();
+				ghost.smartChase();
+			});
+		}
+
+		// the player half way onto the dot to its right, as movePlayer() asks every tick
+		void benchCollision(const LevelData& maze)
+		{
+			Level level(canvas, decals, maze);
+			olc::vi2d tile(-1, -1);
+			for (auto& [pos, object] : level.board)
+				if (object->kind == Kind::DOT && !level.paths.isWall(pos - olc::vi2d(1, 0)))
+				{
+					tile = pos - olc::vi2d(1, 0);
+					break;
+				}
+			olc::vf2d pos = olc::vf2d(tileToScreen(tile.x, tile.y)) + olc::vf2d(nTileSize / 2.0f, 0.0f);
+			level.player->setPos(pos);
+			level.player->steer(Dir::RIGHT);
+			level.player->update(0.0f); // takes up the new direction
+			measure("getCollision", [&] {
+				nSink = nSink + (level.player->getCollision(level.board) != level.board.end());
+			});
+		}
+
+		// recorded the way the simulation draws, then replayed onto the engine's screen
+		void benchDraw(const LevelData& maze)
+		{
+			Level level(canvas, decals, maze);
+			measure("Level::draw", [&] {
+				canvas.begin(snapshot);
+				level.draw();
+				Canvas::replay(*this, snapshot);
+				GetLayers()[0].vecDecalInstance.clear(); // no frame ends here to take them
+			});
+		}
+
+		// a second of tone on loop, played by each voice at once
+		void benchMixer()
+		{
+			const unsigned int nRate = 44100;
+#if defined(_WIN32)
+			olc::SOUND::SetBackend(olc::SOUND::Backend::WAV_FILE, "NUL");
+#else
+			olc::SOUND::SetBackend(olc::SOUND::Backend::WAV_FILE, "/dev/null");
+#endif
+			if (!olc::SOUND::InitialiseAudio(nRate, 1))
+			{
+				std::cout << "no audio to mix" << std::endl;
+				return;
+			}
+			olc::SOUND::AudioSample tone;
+			tone.nSamples = nRate;
+			tone.nChannels = 1;
+			tone.nSampleRate = nRate;
+			tone.vSample.resize(nRate);
+			for (unsigned int i = 0; i < nRate; i++)
+				tone.vSample[i] = short(8000.0 * std::sin(2.0 * 3.14159265358979 * 440.0 * i / nRate));
+			tone.bSampleValid = true;
+			const int nTone = olc::SOUND::AddAudioSample(std::move(tone));
+
+			std::vector<short> vBlock(512);
+			for (const unsigned int nVoices : { 1u, 8u, 32u })
+			{
+				olc::SOUND::StopAll();
+				olc::SOUND::SetMaxVoices(nVoices);
+				for (unsigned int v = 0; v < nVoices; v++)
+					olc::SOUND::PlaySample(nTone, true);
+				measure("MixBlock/" + std::to_string(nVoices) + " voices", [&] {
+					olc::SOUND::MixBlock(vBlock.data(), unsigned(vBlock.size()), 1, 1.0f / nRate);
+					nSink = nSink + vBlock[0];
+				});
+			}
+			olc::SOUND::DestroyAudio();
+		}
+
+		bool writeJson() const
+		{
+			if (sJsonFile.empty())
+				return true;
+			std::ofstream output(sJsonFile);
+			if (!output)
+			{
+				std::cout << "can't write " << sJsonFile << std::endl;
+				return false;
+			}
+			output << "{\n  \"unit\": \"ns\",\n  \"samples\": " << SAMPLES << ",\n  \"benchmarks\": [\n" << std::fixed << std::setprecision(2);
+			for (size_t i = 0; i < vResults.size(); i++)
+			{
+				const Result& r = vResults[i];
+				output << "    { \"name\": \"" << r.sName << "\", \"iterations\": " << r.nIterations
+					<< ", \"median\": " << r.fMedian << ", \"mean\": " << r.fMean << ", \"stddev\": " << r.fDeviation
+					<< ", \"min\": " << r.fMin << ", \"max\": " << r.fMax << ", \"ci95\": " << r.fInterval << " }"
+					<< (i + 1 < vResults.size() ? ",\n" : "\n");
+			}
+			output << "  ]\n}\n";
+			return true;
+		}
+	};
+}
+
+#endif
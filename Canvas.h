@@ -0,0 +1,300 @@
+#ifndef CANVAS_H
+#define CANVAS_H
+
+#include "olcPixelGameEngine.h"
+
+#include <mutex>
+#include <condition_variable>
+
+namespace pm
+{
+#pragma region Input
+
+	// Input gathered by the render thread, handed to the simulation once per tick.
+	// Presses and releases are latched so a tick never misses a short tap
+	struct InputFrame
+	{
+		olc::HWButton keys[olc::Key::ENUM_END] = {};
+		olc::HWButton mouse[olc::nMouseButtons] = {};
+		olc::vi2d vMousePos = { 0, 0 };
+		uint64_t nSeq = 0; // bumped every time something changes
+
+		void merge(const InputFrame& other)
+		{
+			auto latch = [](olc::HWButton& dst, const olc::HWButton& src)
+			{
+				dst.bPressed |= src.bPressed;
+				dst.bReleased |= src.bReleased;
+				dst.bHeld = src.bHeld;
+			};
+			for (int i = 0; i < olc::Key::ENUM_END; ++i)	latch(keys[i], other.keys[i]);
+			for (int i = 0; i < olc::nMouseButtons; ++i)	latch(mouse[i], other.mouse[i]);
+			vMousePos = other.vMousePos;
+		}
+		void clearEdges()
+		{
+			for (auto& k : keys)  k.bPressed = k.bReleased = false;
+			for (auto& m : mouse) m.bPressed = m.bReleased = false;
+		}
+	};
+
+#pragma endregion
+
+#pragma region Snapshot
+
+	struct DrawCommand
+	{
+		enum class Type {
+			CLEAR,
+			DRAW_SPRITE,
+			DRAW_LINE,
+			DRAW_RECT,
+			FILL_RECT,
+			FILL_CIRCLE,
+			DRAW_STRING,
+			DRAW_DECAL,
+			DRAW_WARPED_DECAL,
+			FILL_RECT_DECAL,
+			DRAW_STRING_DECAL
+		};
+
+		Type type;
+		std::array<olc::vf2d, 4> v;	// positions, sizes or corners depending on type
+		olc::Pixel color;
+		int32_t n;					// radius or text scale
+		olc::Sprite* sprite;
+		olc::Decal* decal;
+		std::string text;
+	};
+
+	// Everything the render thread needs to draw one tick. Published as a whole
+	// and never touched by the simulation again until it is handed back
+	struct Snapshot
+	{
+		std::vector<DrawCommand> commands;
+		size_t nCommands = 0;	// commands past this are stale, kept for their string capacity
+		uint64_t nTick = 0;
+		uint64_t nInputSeq = 0;	// last input the simulation saw when recording this
+		bool bIdle = false;
+		bool bQuit = false;
+	};
+
+	// Lock-free single producer / single consumer triple buffer. The writer
+	// always has a slot to fill, the reader always gets the newest complete one
+	template<typename T>
+	class TripleBuffer
+	{
+		static const uint8_t FRESH = 0b100;
+
+		T slots[3];
+		uint8_t back = 0;
+		uint8_t front = 1;
+		std::atomic<uint8_t> middle = { 2 };
+
+	public:
+		T& writeBuffer() { return slots[back]; }
+		void publish() { back = middle.exchange(back | FRESH) & 0b011; }
+		// Swaps in the newest published slot if there is one
+		const T& readBuffer()
+		{
+			if (middle.load() & FRESH)
+				front = middle.exchange(front) & 0b011;
+			return slots[front];
+		}
+	};
+
+#pragma endregion
+
+	// Simulation-side stand-in for the engine. Game objects draw through it as they
+	// would through olc::PixelGameEngine, but calls are recorded into the current
+	// snapshot, and input comes from the frame handed over for this tick
+	class Canvas
+	{
+		olc::PixelGameEngine* pge; // none when only the rules are run, nothing reads input or draws then
+		Snapshot* target;
+		InputFrame input;
+
+		// render thread -> simulation
+		std::mutex muxInput;
+		std::condition_variable cvInput;
+		InputFrame pending;
+		std::atomic<uint64_t> nPushedSeq = { 0 };
+
+	public:
+		Canvas(olc::PixelGameEngine& pge) : pge(&pge), target(nullptr) {}
+		Canvas() : pge(nullptr), target(nullptr) {}
+
+#pragma region Input
+
+		// Render thread: samples the engine and queues the result for the next tick
+		void pushInput()
+		{
+			InputFrame frame;
+			bool changed = false;
+			for (int i = 0; i < olc::Key::ENUM_END; ++i)
+			{
+				frame.keys[i] = pge->GetKey(olc::Key(i));
+				changed |= frame.keys[i].bPressed || frame.keys[i].bReleased;
+			}
+			for (int i = 0; i < olc::nMouseButtons; ++i)
+			{
+				frame.mouse[i] = pge->GetMouse(i);
+				changed |= frame.mouse[i].bPressed || frame.mouse[i].bReleased;
+			}
+			frame.vMousePos = pge->GetMousePos();
+
+			{
+				std::lock_guard<std::mutex> lock(muxInput);
+				changed |= frame.vMousePos != pending.vMousePos;
+				pending.merge(frame);
+				if (changed) nPushedSeq = ++pending.nSeq;
+			}
+			if (changed) cvInput.notify_one();
+		}
+		// Simulation thread: takes everything queued since the last tick
+		void pullInput()
+		{
+			std::lock_guard<std::mutex> lock(muxInput);
+			input = pending;
+			pending.clearEdges();
+		}
+		// Simulation thread: sleeps until new input arrives or wake() is called
+		void waitForInput(const std::atomic<bool>& bRunning)
+		{
+			std::unique_lock<std::mutex> lock(muxInput);
+			cvInput.wait(lock, [&] { return !bRunning || pending.nSeq != input.nSeq; });
+		}
+		void wake()
+		{
+			{ std::lock_guard<std::mutex> lock(muxInput); }
+			cvInput.notify_one();
+		}
+		uint64_t pushedSeq() const { return nPushedSeq; }
+
+		olc::HWButton GetKey(olc::Key k) const { return input.keys[k]; }
+		olc::HWButton GetMouse(uint32_t b) const { return input.mouse[b]; }
+		const olc::vi2d& GetMousePos() const { return input.vMousePos; }
+		int32_t ScreenWidth() const { return pge->ScreenWidth(); }
+		int32_t ScreenHeight() const { return pge->ScreenHeight(); }
+
+#pragma endregion
+
+#pragma region Recording
+
+		void begin(Snapshot& snapshot)
+		{
+			target = &snapshot;
+			target->nCommands = 0;
+			target->nInputSeq = input.nSeq;
+		}
+
+		void Clear(olc::Pixel p)
+		{
+			record(DrawCommand::Type::CLEAR).color = p;
+		}
+		void DrawSprite(const olc::vi2d& pos, olc::Sprite* sprite)
+		{
+			DrawCommand& c = record(DrawCommand::Type::DRAW_SPRITE);
+			c.v[0] = pos;
+			c.sprite = sprite;
+		}
+		void DrawLine(const olc::vi2d& pos1, const olc::vi2d& pos2, olc::Pixel p = olc::WHITE)
+		{
+			DrawCommand& c = record(DrawCommand::Type::DRAW_LINE);
+			c.v[0] = pos1; c.v[1] = pos2;
+			c.color = p;
+		}
+		void DrawRect(const olc::vi2d& pos, const olc::vi2d& size, olc::Pixel p = olc::WHITE)
+		{
+			DrawCommand& c = record(DrawCommand::Type::DRAW_RECT);
+			c.v[0] = pos; c.v[1] = size;
+			c.color = p;
+		}
+		void FillRect(const olc::vi2d& pos, const olc::vi2d& size, olc::Pixel p = olc::WHITE)
+		{
+			DrawCommand& c = record(DrawCommand::Type::FILL_RECT);
+			c.v[0] = pos; c.v[1] = size;
+			c.color = p;
+		}
+		void FillCircle(const olc::vi2d& pos, int32_t radius, olc::Pixel p = olc::WHITE)
+		{
+			DrawCommand& c = record(DrawCommand::Type::FILL_CIRCLE);
+			c.v[0] = pos;
+			c.n = radius;
+			c.color = p;
+		}
+		void DrawString(const olc::vi2d& pos, const std::string& sText, olc::Pixel col = olc::WHITE, uint32_t scale = 1)
+		{
+			DrawCommand& c = record(DrawCommand::Type::DRAW_STRING);
+			c.v[0] = pos;
+			c.text.assign(sText);
+			c.color = col;
+			c.n = scale;
+		}
+		void DrawDecal(const olc::vf2d& pos, olc::Decal* decal, const olc::vf2d& scale = { 1.0f,1.0f }, const olc::Pixel& tint = olc::WHITE)
+		{
+			DrawCommand& c = record(DrawCommand::Type::DRAW_DECAL);
+			c.v[0] = pos; c.v[1] = scale;
+			c.decal = decal;
+			c.color = tint;
+		}
+		void DrawWarpedDecal(olc::Decal* decal, const std::array<olc::vf2d, 4>& pos, const olc::Pixel& tint = olc::WHITE)
+		{
+			DrawCommand& c = record(DrawCommand::Type::DRAW_WARPED_DECAL);
+			c.v = pos;
+			c.decal = decal;
+			c.color = tint;
+		}
+		void FillRectDecal(const olc::vf2d& pos, const olc::vf2d& size, const olc::Pixel col = olc::WHITE)
+		{
+			DrawCommand& c = record(DrawCommand::Type::FILL_RECT_DECAL);
+			c.v[0] = pos; c.v[1] = size;
+			c.color = col;
+		}
+		void DrawStringDecal(const olc::vf2d& pos, const std::string& sText, const olc::Pixel col = olc::WHITE)
+		{
+			DrawCommand& c = record(DrawCommand::Type::DRAW_STRING_DECAL);
+			c.v[0] = pos;
+			c.text.assign(sText);
+			c.color = col;
+		}
+
+#pragma endregion
+
+		// Render thread: plays a snapshot back onto the engine
+		static void replay(olc::PixelGameEngine& pge, const Snapshot& snapshot)
+		{
+			for (size_t i = 0; i < snapshot.nCommands; ++i)
+			{
+				const DrawCommand& c = snapshot.commands[i];
+				switch (c.type)
+				{
+				case DrawCommand::Type::CLEAR:				pge.Clear(c.color); break;
+				case DrawCommand::Type::DRAW_SPRITE:		pge.DrawSprite(c.v[0], c.sprite); break;
+				case DrawCommand::Type::DRAW_LINE:			pge.DrawLine(c.v[0], c.v[1], c.color); break;
+				case DrawCommand::Type::DRAW_RECT:			pge.DrawRect(c.v[0], c.v[1], c.color); break;
+				case DrawCommand::Type::FILL_RECT:			pge.FillRect(c.v[0], c.v[1], c.color); break;
+				case DrawCommand::Type::FILL_CIRCLE:		pge.FillCircle(c.v[0], c.n, c.color); break;
+				case DrawCommand::Type::DRAW_STRING:		pge.DrawString(c.v[0], c.text, c.color, c.n); break;
+				case DrawCommand::Type::DRAW_DECAL:			pge.DrawDecal(c.v[0], c.decal, c.v[1], c.color); break;
+				case DrawCommand::Type::DRAW_WARPED_DECAL:	pge.DrawWarpedDecal(c.decal, c.v, c.color); break;
+				case DrawCommand::Type::FILL_RECT_DECAL:	pge.FillRectDecal(c.v[0], c.v[1], c.color); break;
+				case DrawCommand::Type::DRAW_STRING_DECAL:	pge.DrawStringDecal(c.v[0], c.text, c.color); break;
+				}
+			}
+		}
+
+	private:
+		// Reuses old slots so steady-state recording doesn't allocate
+		DrawCommand& record(DrawCommand::Type type)
+		{
+			if (target->nCommands == target->commands.size())
+				target->commands.emplace_back();
+			DrawCommand& c = target->commands[target->nCommands++];
+			c.type = type;
+			return c;
+		}
+	};
+}
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef DEBUG_OVERLAY_H
+#define DEBUG_OVERLAY_H
+
+#include "olcPixelGameEngine.h"
+#include "olcPGEX_Sound.h"
+
+#include <sstream>
+#include <iomanip>
+
+namespace pm
+{
+	// Engine internals drawn over the game, F3 toggles it. Drawn by the render
+	// thread straight onto the engine, it never goes through a snapshot
+	class DebugOverlay
+	{
+		bool bVisible;
+
+	public:
+		DebugOverlay() : bVisible(false) {}
+
+		void toggle() { bVisible = !bVisible; }
+		bool isVisible() const { return bVisible; }
+
+		void draw(olc::PixelGameEngine& pge)
+		{
+			if (!bVisible) return;
+
+			const olc::SOUND::sAudioStats stats = olc::SOUND::GetStats();
+			std::stringstream ss;
+			ss << std::fixed << std::setprecision(1)
+				<< "audio " << (olc::SOUND::GetBackend() == olc::SOUND::Backend::DEVICE ? "device" : olc::SOUND::GetBackend() == olc::SOUND::Backend::WAV_FILE ? "wav" : "none")
+				<< "  queued " << stats.fDeviceLatency * 1000.0f << "ms\n"
+				<< "blocks    " << stats.nBlocks << "\n"
+				<< "underruns " << stats.nUnderruns << "  starved " << stats.nStreamStarved << "\n"
+				<< "voices    " << stats.nActiveVoices << "\n"
+				<< "mix us    " << stats.fMixTimeLast << " avg " << stats.fMixTimeAverage << " max " << stats.fMixTimeMax << "\n"
+				<< "trigger to submit, ms:";
+
+			const olc::vi2d vPos = { 4, 4 };
+			const int nLines = 6;
+			const int nGraphHeight = 24;
+			pge.FillRectDecal(vPos - olc::vi2d(2, 2), { float(pge.ScreenWidth() - 4), float(nLines * 10 + nGraphHeight + 14) }, olc::Pixel(0, 0, 0, 180));
+			std::string sLine;
+			for (int i = 0; std::getline(ss, sLine); i++)
+				pge.DrawStringDecal(vPos + olc::vi2d(0, i * 10), sLine);
+
+			// Latency histogram, one column per power of two
+			uint64_t nMax = 1;
+			for (auto n : stats.nLatency) nMax = std::max(nMax, n);
+			const int nColumnWidth = (pge.ScreenWidth() - 16) / olc::SOUND::sAudioStats::nLatencyBuckets;
+			const int nBase = vPos.y + nLines * 10 + nGraphHeight;
+			for (int i = 0; i < olc::SOUND::sAudioStats::nLatencyBuckets; i++)
+			{
+				float fHeight = float(nGraphHeight) * float(stats.nLatency[i]) / float(nMax);
+				olc::vf2d vColumn = { float(vPos.x + i * nColumnWidth), float(nBase) - fHeight };
+				pge.FillRectDecal(vColumn, { float(nColumnWidth - 2), fHeight }, olc::Pixel(90, 200, 255));
+				std::string sLabel = i + 1 == olc::SOUND::sAudioStats::nLatencyBuckets ? "+" : std::to_string(1 << i);
+				pge.DrawStringDecal({ float(vPos.x + i * nColumnWidth), float(nBase + 2) }, sLabel, olc::GREY, { 0.5f, 0.5f });
+			}
+		}
+	};
+}
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef DIFFICULTY_H
+#define DIFFICULTY_H
+
+#include "TreeSearch.h"
+#include "Autopilot.h"
+
+#include <iostream>
+#include <string>
+
+namespace pm
+{
+	// How the tree search gets on with a level, for catching levels that are too hard, or
+	// can't be won at all, before they ship. Games are played the way Environments plays
+	// them: classic rules, no countdowns, each from its own seed so a rating repeats
+	struct Difficulty
+	{
+		static const int DEFAULT_GAMES = 3;
+		static const int MAX_TICKS = 5 * 60 * SIM_TICK_RATE; // then the game counts as lost
+		// small enough that a bot which can't win it is broken, not the level. Rated first
+		static inline const LevelData CALIBRATION = {
+			"#########"
+			"#p.....o#"
+			"#.##.##.#"
+			"#...b...#"
+			"#########", 9, 5 };
+
+		int nGames = 0;
+		int nWon = 0;
+		int nLivesLost = 0;     // over all the games
+		float fDotsLeft = 0.0f; // the share of the level's dots, on average at the end
+
+		bool neverWon() const { return nGames > 0 && nWon == 0; }
+	};
+
+	// plays nGames of maze with bot (a TreeSearch or an Autopilot) at the controls
+	template <typename Bot>
+	Difficulty playLevel(const LevelData& maze, Bot& bot, const int nGames)
+	{
+		Difficulty rating;
+		Canvas canvas;
+		std::vector<olc::Decal*> decals(SPRITE_NAMES.size(), nullptr);
+		for (int g = 0; g < nGames; g++)
+		{
+			Level level(canvas, decals, maze);
+			if (level.player == nullptr || level.iDots == 0)
+				break;
+			level.useOwnRandom(uint32_t(g + 1));
+			bot.reset();
+			const int nDots = level.iDots;
+			int nLives = DEFAULT_LIFE;
+			bool bWon = false;
+			bool bOver = false;
+			auto onEvent = [&](const Level::Event event, GameObject&) {
+				if (event == Level::Event::CLEARED)
+					bWon = bOver = true;
+				else if (event == Level::Event::CAUGHT)
+				{
+					rating.nLivesLost++;
+					if (nLives == 0)
+						bOver = true;
+					else
+					{
+						level.resetPositions();
+						nLives--;
+					}
+				}
+			};
+
+			const float fElapsedTime = 1.0f / SIM_TICK_RATE;
+			for (int t = 0; t < Difficulty::MAX_TICKS && !bOver; t++)
+			{
+				bot.drive(level);
+				level.movePlayer(fElapsedTime, onEvent);
+				if (!bOver)
+					level.moveGhosts(fElapsedTime, onEvent);
+			}
+			rating.nGames++;
+			rating.nWon += bWon;
+			rating.fDotsLeft += float(level.iDots) / nDots;
+		}
+		if (rating.nGames > 0)
+			rating.fDotsLeft /= rating.nGames;
+		return rating;
+	}
+
+	Difficulty rateLevel(const LevelData& maze, const int nGames = Difficulty::DEFAULT_GAMES, const int nRollouts = TreeSearch::DEFAULT_ROLLOUTS)
+	{
+		TreeSearch search(maze, nRollouts);
+		return playLevel(maze, search, nGames);
+	}
+
+	// rates every level, one line each. A level the tree search never wins gets a second
+	// go with the autopilot, which plans further ahead down a corridor, and only counts as
+	// never won if that loses it too. False if any level was never won, or if the tree
+	// search can't win Difficulty::CALIBRATION, then it's the ratings that can't be trusted
+	bool rateLevels(const std::vector<LevelData>& levels, const int nGames = Difficulty::DEFAULT_GAMES)
+	{
+		const Difficulty calibration = rateLevel(Difficulty::CALIBRATION, nGames);
+		if (calibration.nWon < calibration.nGames || calibration.nGames == 0)
+		{
+			std::cout << "the tree search won " << calibration.nWon << "/" << nGames << " of the calibration level, it's broken" << std::endl;
+			return false;
+		}
+
+		bool bAllWon = true;
+		for (size_t i = 0; i < levels.size(); i++)
+		{
+			const Difficulty rating = rateLevel(levels[i], nGames);
+			std::cout << "level" << (i < 10 ? "0" : "") << i << " " << levels[i].width << "x" << levels[i].height << ": ";
+			if (rating.nGames == 0)
+			{
+				std::cout << "nothing to play" << std::endl;
+				continue;
+			}
+			std::cout << "won " << rating.nWon << "/" << rating.nGames << ", "
+				<< float(rating.nLivesLost) / rating.nGames << " lives lost a game, "
+				<< int(rating.fDotsLeft * 100.0f + 0.5f) << "% dots left";
+			bool bNeverWon = rating.neverWon();
+			if (bNeverWon)
+			{
+				Autopilot autopilot;
+				const Difficulty second = playLevel(levels[i], autopilot, nGames);
+				std::cout << ", the autopilot won " << second.nWon << "/" << second.nGames;
+				bNeverWon = second.neverWon();
+			}
+			std::cout << (bNeverWon ? "  <- never won" : "") << std::endl;
+			bAllWon &= !bNeverWon;
+		}
+		return bAllWon;
+	}
+}
+
+#endif
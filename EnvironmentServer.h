@@ -0,0 +1,427 @@
+#ifndef ENVIRONMENT_SERVER_H
+#define ENVIRONMENT_SERVER_H
+
+#include "Environments.h"
+
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <iostream>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <climits>
+#include <cerrno>
+#include <csignal>
+#include <ctime>
+#endif
+
+namespace pm
+{
+	// Environments served to agents in other processes through one POSIX shared memory
+	// segment. The client writes actions (or seeds) straight into it and the games write
+	// observations, rewards and done flags straight back, nothing is copied or encoded on
+	// the way. Requests and replies are counters in the segment that the other side waits
+	// on with a futex, so an idle side sleeps and a busy one never enters the kernel more
+	// than twice per step. One segment carries all the games of one server.
+	//
+	// The segment is a SharedLayout, then each array at its offset. A client in another
+	// language only needs that struct and the two counters; see EnvironmentClient
+	struct SharedLayout
+	{
+		static const uint32_t MAGIC = 0x50414331; // "PAC1"
+		static const uint32_t VERSION = 2;
+
+		enum Command : uint32_t { COMMAND_RESET = 1, COMMAND_STEP, COMMAND_CLOSE };
+
+		uint32_t nMagic;     // set last, once everything else is ready
+		uint32_t nVersion;
+		int32_t nGames;
+		int32_t nWidth;
+		int32_t nHeight;
+		int32_t nChannels;   // Environments::Channel
+		int32_t nObservationSize;
+		int32_t nServerPid;  // for a client to tell the server died, and a new server that the segment is left over
+		uint32_t nCommand;   // written before nRequest moves on
+		std::atomic<uint32_t> nRequest; // the client counts up
+		std::atomic<uint32_t> nReply;   // the server catches up
+		// from the start of the segment, each 64 byte aligned
+		uint64_t nSeedsOffset;        // uint32_t per game, for COMMAND_RESET
+		uint64_t nActionsOffset;      // int32_t per game, Environments::Action
+		uint64_t nObservationsOffset; // nObservationSize bytes per game
+		uint64_t nRewardsOffset;      // float per game
+		uint64_t nDonesOffset;        // uint8_t per game
+		uint64_t nSize;
+
+		static uint64_t align(const uint64_t n) { return (n + 63) & ~uint64_t(63); }
+		void lay(const int games, const int observationSize)
+		{
+			nGames = games;
+			nObservationSize = observationSize;
+			nSeedsOffset = align(sizeof(SharedLayout));
+			nActionsOffset = align(nSeedsOffset + sizeof(uint32_t) * games);
+			nObservationsOffset = align(nActionsOffset + sizeof(int32_t) * games);
+			nRewardsOffset = align(nObservationsOffset + uint64_t(observationSize) * games);
+			nDonesOffset = align(nRewardsOffset + sizeof(float) * games);
+			nSize = align(nDonesOffset + games);
+		}
+	};
+
+#ifdef __linux__
+	// sleeps while word still reads seen, false if it still does after timeout (never, without one)
+	inline bool sharedWait(std::atomic<uint32_t>& word, const uint32_t seen, const timespec* timeout = nullptr)
+	{
+		while (word.load(std::memory_order_acquire) == seen)
+			if (syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, seen, timeout, nullptr, 0) != 0 && errno == ETIMEDOUT)
+				return word.load(std::memory_order_acquire) != seen;
+		return true;
+	}
+	inline void sharedWake(std::atomic<uint32_t>& word)
+	{
+		syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+	}
+
+	// true if process nPid is still running, or might be: one it isn't allowed to signal still is
+	inline bool processAlive(const int32_t nPid)
+	{
+		return nPid > 0 && (kill(nPid, 0) == 0 || errno != ESRCH);
+	}
+
+	// a shared memory segment mapped in, the creator removes the name again
+	class SharedSegment
+	{
+		std::string sName;
+		int fd = -1;
+		uint8_t* pData = nullptr;
+		size_t nSize = 0;
+		bool bOwner = false;
+
+	public:
+		SharedSegment() = default;
+		SharedSegment(const SharedSegment&) = delete;
+		SharedSegment& operator=(const SharedSegment&) = delete;
+		~SharedSegment() { close(); }
+
+		// names start with a slash, one is added if not
+		static std::string path(const std::string& name) { return name[0] == '/' ? name : "/" + name; }
+
+		// fails if the name is taken, see remove() for one that's left over
+		bool create(const std::string& name, const size_t size)
+		{
+			sName = path(name);
+			fd = shm_open(sName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+			bOwner = fd >= 0;
+			if (fd < 0 || ftruncate(fd, size) != 0)
+				return fail(errno == EEXIST ? "there is one already called" : "can't create");
+			return map(size);
+		}
+		static bool exists(const std::string& name)
+		{
+			const int n = shm_open(path(name).c_str(), O_RDONLY, 0600);
+			if (n < 0)
+				return false;
+			::close(n);
+			return true;
+		}
+		static void remove(const std::string& name) { shm_unlink(path(name).c_str()); }
+		bool open(const std::string& name)
+		{
+			sName = path(name);
+			fd = shm_open(sName.c_str(), O_RDWR, 0600);
+			struct stat st;
+			if (fd < 0 || fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(SharedLayout))
+				return fail("can't open");
+			return map(size_t(st.st_size));
+		}
+		void close()
+		{
+			if (pData != nullptr)
+				munmap(pData, nSize);
+			if (fd >= 0)
+				::close(fd);
+			if (bOwner)
+				shm_unlink(sName.c_str());
+			pData = nullptr;
+			fd = -1;
+			bOwner = false;
+		}
+		uint8_t* data() const { return pData; }
+		size_t size() const { return nSize; }
+
+	private:
+		bool map(const size_t size)
+		{
+			void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			if (p == MAP_FAILED)
+				return fail("can't map");
+			pData = static_cast<uint8_t*>(p);
+			nSize = size;
+			return true;
+		}
+		bool fail(const char* what)
+		{
+			std::cout << "shared memory: " << what << " " << sName << std::endl;
+			close();
+			return false;
+		}
+	};
+
+	// The game side: runs Environments on whatever the client asks for, in place
+	class EnvironmentServer
+	{
+		SharedSegment segment;
+		std::unique_ptr<Environments> envs;
+		SharedLayout* layout = nullptr;
+
+		// a segment by that name from a server that died without cleaning up is removed, but
+		// not one a server is still running on, or one that isn't a server's at all
+		static bool removeLeftOver(const std::string& name)
+		{
+			int32_t nPid = 0;
+			{
+				SharedSegment old;
+				if (!old.open(name))
+					return false;
+				const SharedLayout* other = reinterpret_cast<const SharedLayout*>(old.data());
+				if (reinterpret_cast<const std::atomic<uint32_t>*>(&other->nMagic)->load(std::memory_order_acquire) != SharedLayout::MAGIC ||
+					other->nVersion != SharedLayout::VERSION)
+				{
+					std::cout << "shared memory: " << name << " is in use, and not by a server this can check on" << std::endl;
+					return false;
+				}
+				nPid = other->nServerPid;
+			}
+			if (processAlive(nPid))
+			{
+				std::cout << "shared memory: " << name << " is being served by process " << nPid << std::endl;
+				return false;
+			}
+			std::cout << "shared memory: removing " << name << ", left over from process " << nPid << std::endl;
+			SharedSegment::remove(name);
+			return true;
+		}
+
+	public:
+		// fails if another server is running on name
+		bool create(const std::string& name, const LevelData& maze, const int nGames, const unsigned int nThreads = std::thread::hardware_concurrency())
+		{
+			if (SharedSegment::exists(name) && !removeLeftOver(name))
+				return false;
+			envs = std::make_unique<Environments>(maze, nGames, Environments::TICKS_PER_STEP, nThreads);
+			SharedLayout shape;
+			shape.lay(envs->size(), envs->observationSize());
+			if (!segment.create(name, shape.nSize))
+				return false;
+
+			layout = new (segment.data()) SharedLayout();
+			layout->lay(envs->size(), envs->observationSize());
+			layout->nVersion = SharedLayout::VERSION;
+			layout->nWidth = envs->width();
+			layout->nHeight = envs->height();
+			layout->nChannels = Environments::CHANNELS;
+			layout->nServerPid = int32_t(getpid());
+			layout->nCommand = 0;
+			layout->nRequest.store(0);
+			layout->nReply.store(0);
+			std::atomic_thread_fence(std::memory_order_release);
+			reinterpret_cast<std::atomic<uint32_t>*>(&layout->nMagic)->store(SharedLayout::MAGIC, std::memory_order_release);
+			return true;
+		}
+
+		// answers requests until the client sends COMMAND_CLOSE
+		void serve()
+		{
+			uint32_t nSeen = 0;
+			for (;;)
+			{
+				sharedWait(layout->nRequest, nSeen);
+				nSeen++; // one at a time, the client waits for each reply
+				const uint32_t nCommand = layout->nCommand;
+				uint8_t* const base = segment.data();
+				switch (nCommand)
+				{
+				case SharedLayout::COMMAND_RESET:
+					envs->reset(reinterpret_cast<uint32_t*>(base + layout->nSeedsOffset), base + layout->nObservationsOffset);
+					break;
+				case SharedLayout::COMMAND_STEP:
+					envs->step(reinterpret_cast<int32_t*>(base + layout->nActionsOffset), base + layout->nObservationsOffset,
+						reinterpret_cast<float*>(base + layout->nRewardsOffset), base + layout->nDonesOffset);
+					break;
+				}
+				layout->nReply.store(nSeen, std::memory_order_release);
+				sharedWake(layout->nReply);
+				if (nCommand == SharedLayout::COMMAND_CLOSE)
+					return;
+			}
+		}
+
+		// has serve() return as if the client had closed, when there is no client to
+		void stop()
+		{
+			layout->nCommand = SharedLayout::COMMAND_CLOSE;
+			layout->nRequest.fetch_add(1, std::memory_order_release);
+			sharedWake(layout->nRequest);
+		}
+	};
+
+	// The agent side, and a reference for clients in other languages: write seeds() or
+	// actions(), call reset() or step(), read the rest. Pointers stay valid until close().
+	// A reply that's slow to come has the client check the server is still running, and
+	// give up on it if it isn't
+	class EnvironmentClient
+	{
+		static inline const timespec CHECK_EVERY = { 1, 0 };
+
+		SharedSegment segment;
+		SharedLayout* layout = nullptr;
+
+	public:
+		bool connect(const std::string& name)
+		{
+			if (!segment.open(name))
+				return false;
+			layout = reinterpret_cast<SharedLayout*>(segment.data());
+			if (reinterpret_cast<std::atomic<uint32_t>*>(&layout->nMagic)->load(std::memory_order_acquire) != SharedLayout::MAGIC ||
+				layout->nVersion != SharedLayout::VERSION || layout->nSize > segment.size())
+			{
+				std::cout << "shared memory: " << name << " isn't an environment server" << std::endl;
+				segment.close();
+				return false;
+			}
+			return true;
+		}
+
+		int size() const { return layout->nGames; }
+		int width() const { return layout->nWidth; }
+		int height() const { return layout->nHeight; }
+		int observationSize() const { return layout->nObservationSize; }
+
+		uint32_t* seeds() { return at<uint32_t>(layout->nSeedsOffset); }
+		int32_t* actions() { return at<int32_t>(layout->nActionsOffset); }
+		const uint8_t* observations() { return at<uint8_t>(layout->nObservationsOffset); }
+		const float* rewards() { return at<float>(layout->nRewardsOffset); }
+		const uint8_t* dones() { return at<uint8_t>(layout->nDonesOffset); }
+
+		// false if the server has gone
+		bool reset() { return request(SharedLayout::COMMAND_RESET); }
+		bool step() { return request(SharedLayout::COMMAND_STEP); }
+		// stops the server too
+		void close()
+		{
+			if (layout == nullptr)
+				return;
+			request(SharedLayout::COMMAND_CLOSE);
+			segment.close();
+			layout = nullptr;
+		}
+
+	private:
+		template<typename T>
+		T* at(const uint64_t nOffset) { return reinterpret_cast<T*>(segment.data() + nOffset); }
+
+		bool request(const uint32_t nCommand)
+		{
+			layout->nCommand = nCommand;
+			const uint32_t nRequest = layout->nRequest.load(std::memory_order_relaxed) + 1;
+			layout->nRequest.store(nRequest, std::memory_order_release);
+			sharedWake(layout->nRequest);
+			while (!sharedWait(layout->nReply, nRequest - 1, &CHECK_EVERY))
+			{
+				if (!processAlive(layout->nServerPid))
+				{
+					std::cout << "shared memory: the server, process " << layout->nServerPid << ", has gone" << std::endl;
+					return false;
+				}
+			}
+			return true;
+		}
+	};
+
+	// The reference client: random actions in every game for nSteps, then how fast it went.
+	// bClose stops the server afterwards
+	bool runClient(const std::string& name, const int nSteps, const bool bClose = true)
+	{
+		EnvironmentClient client;
+		if (!client.connect(name))
+			return false;
+		const int nGames = client.size();
+		for (int i = 0; i < nGames; i++)
+			client.seeds()[i] = uint32_t(i + 1);
+		if (!client.reset())
+			return false;
+
+		std::minstd_rand random(1);
+		int nDone = 0;
+		double fReward = 0.0;
+		const auto tStart = std::chrono::steady_clock::now();
+		for (int s = 0; s < nSteps; s++)
+		{
+			int32_t* actions = client.actions();
+			for (int i = 0; i < nGames; i++)
+				actions[i] = int32_t(random() % Environments::ACTIONS);
+			if (!client.step())
+				return false;
+			for (int i = 0; i < nGames; i++)
+			{
+				fReward += client.rewards()[i];
+				nDone += client.dones()[i];
+			}
+		}
+		const double fSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tStart).count();
+		std::cout << name << ": " << nGames << " games " << client.width() << "x" << client.height() << ", "
+			<< nSteps << " steps in " << fSeconds << "s, " << int(nSteps / fSeconds) << " steps/s, "
+			<< int(double(nSteps) * nGames / fSeconds) << " game steps/s, "
+			<< nDone << " games ended, " << fReward << " reward" << std::endl;
+		if (bClose)
+			client.close();
+		return true;
+	}
+
+	// the same steps straight on Environments, then through a segment to a server on another
+	// thread, so the cost of the transport shows on its own
+	bool benchmarkTransport(const LevelData& maze, const int nGames, const int nSteps)
+	{
+		{
+			Environments envs(maze, nGames);
+			std::vector<uint32_t> seeds(nGames);
+			std::vector<int> actions(nGames);
+			std::vector<uint8_t> obs(size_t(nGames) * envs.observationSize());
+			std::vector<float> rewards(nGames);
+			std::vector<uint8_t> dones(nGames);
+			for (int i = 0; i < nGames; i++)
+				seeds[i] = uint32_t(i + 1);
+			envs.reset(seeds.data(), obs.data());
+			std::minstd_rand random(1);
+			const auto tStart = std::chrono::steady_clock::now();
+			for (int s = 0; s < nSteps; s++)
+			{
+				for (int i = 0; i < nGames; i++)
+					actions[i] = int(random() % Environments::ACTIONS);
+				envs.step(actions.data(), obs.data(), rewards.data(), dones.data());
+			}
+			const double fSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tStart).count();
+			std::cout << "in process: " << nGames << " games, " << nSteps << " steps in " << fSeconds << "s, "
+				<< int(nSteps / fSeconds) << " steps/s" << std::endl;
+		}
+
+		const std::string name = "/pacmanx10-bench-" + std::to_string(getpid());
+		EnvironmentServer server;
+		if (!server.create(name, maze, nGames))
+			return false;
+		std::thread serving([&] { server.serve(); });
+		const bool bOk = runClient(name, nSteps);
+		if (!bOk)
+			server.stop();
+		serving.join();
+		return bOk;
+	}
+#endif
+}
+
+#endif
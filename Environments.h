@@ -0,0 +1,182 @@
+#ifndef ENVIRONMENTS_H
+#define ENVIRONMENTS_H
+
+#include "Auxiliaries.h"
+#include "WorkerPool.h"
+
+#include <vector>
+#include <memory>
+#include <cstring>
+
+namespace pm
+{
+	// N games of one maze stepped together, for training agents. They play by Level's
+	// rules in classic mode, minus the countdowns (nothing moves during them anyway).
+	// Every game has its own random numbers, so what happens depends only on the seeds,
+	// never on threads or the other games. A game that ends starts over by itself with
+	// the next seed from its own sequence; only that allocates, stepping doesn't.
+	//
+	// Observations are bytes, laid out [game][channel][y][x], 1 where the thing is
+	class Environments
+	{
+	public:
+		// Pathfinder::STEPS order, or carry on as before
+		enum Action { ACTION_LEFT = 0, ACTION_RIGHT, ACTION_UP, ACTION_DOWN, ACTION_NONE, ACTIONS };
+		// a plane per ghost colour and state follows CH_GHOSTS, see ghostChannel()
+		enum Channel { CH_WALL = 0, CH_DOT, CH_POWER_UP, CH_PACMAN, CH_GHOSTS, CHANNELS = CH_GHOSTS + 4 * 3 };
+
+		static const int TICKS_PER_STEP = 4;
+		static const int MAX_STEPS = 5 * 60 * SIM_TICK_RATE / TICKS_PER_STEP; // then the game is cut short
+
+		static int ghostChannel(const Kind kind, const Ghost::GhostState state)
+		{
+			return CH_GHOSTS + (int(kind) - int(Kind::GHOST_R)) * 3 + int(state);
+		}
+
+	private:
+		struct Episode
+		{
+			std::unique_ptr<Level> level;
+			std::minstd_rand seeds;       // where the next game's seed comes from
+			std::vector<uint8_t> vStatic; // the wall, dot and power up planes, kept as things get eaten
+			int nLives;
+			int nSteps;
+			float fReward;
+			bool bDone;
+		};
+
+		LevelData maze;
+		int nTicksPerStep;
+		int nPlane; // bytes per channel
+		Canvas canvas;
+		std::vector<olc::Decal*> decals;
+		std::vector<Episode> episodes;
+		WorkerPool pool;
+
+	public:
+		Environments(const LevelData& maze, const int nGames, const int nTicksPerStep = TICKS_PER_STEP, const unsigned int nThreads = std::thread::hardware_concurrency()) :
+			maze(maze),
+			nTicksPerStep(std::max(nTicksPerStep, 1)),
+			nPlane(maze.width * maze.height),
+			decals(SPRITE_NAMES.size(), nullptr),
+			episodes(std::max(nGames, 0)),
+			pool(nThreads)
+		{}
+
+		int size() const { return int(episodes.size()); }
+		int width() const { return maze.width; }
+		int height() const { return maze.height; }
+		// bytes of observation per game
+		int observationSize() const { return CHANNELS * nPlane; }
+
+		// Starts every game over, game i from seeds[i]. obs takes size() * observationSize() bytes
+		void reset(const uint32_t* seeds, uint8_t* obs)
+		{
+			pool.run(size(), [&](const int i, const int) {
+				episodes[i].seeds.seed(seeds[i]);
+				start(episodes[i]);
+				observe(episodes[i], obs + size_t(i) * observationSize());
+			});
+		}
+
+		// Plays actions[i] in game i for nTicksPerStep ticks. rewards[i] is the score it made,
+		// dones[i] is 1 if the game ended; obs then already shows the one that replaced it
+		void step(const int* actions, uint8_t* obs, float* rewards, uint8_t* dones)
+		{
+			pool.run(size(), [&](const int i, const int) {
+				Episode& episode = episodes[i];
+				play(episode, actions[i]);
+				rewards[i] = episode.fReward;
+				dones[i] = episode.bDone;
+				if (episode.bDone)
+					start(episode);
+				observe(episode, obs + size_t(i) * observationSize());
+			});
+		}
+
+	private:
+		void start(Episode& episode)
+		{
+			episode.level.reset(new Level(canvas, decals, maze));
+			episode.level->useOwnRandom(uint32_t(episode.seeds()));
+			episode.nLives = DEFAULT_LIFE;
+			episode.nSteps = 0;
+
+			const Topology& grid = episode.level->paths.topology();
+			episode.vStatic.assign(3 * nPlane, 0);
+			for (auto& [pos, object] : episode.level->board)
+				switch (object->kind)
+				{
+				case Kind::WALL:     episode.vStatic[CH_WALL * nPlane + grid.index(pos)] = 1;     break;
+				case Kind::DOT:      episode.vStatic[CH_DOT * nPlane + grid.index(pos)] = 1;      break;
+				case Kind::POWER_UP: episode.vStatic[CH_POWER_UP * nPlane + grid.index(pos)] = 1; break;
+				default:                                                                           break;
+				}
+		}
+
+		// the same as a tick of Game in GAME_PLAY, scored the classic way
+		void play(Episode& episode, const int action)
+		{
+			Level& level = *episode.level;
+			if (action >= 0 && action < ACTION_NONE)
+				level.player->steer(stepToDir(action));
+
+			episode.fReward = 0.0f;
+			episode.bDone = false;
+			auto onEvent = [&](const Level::Event event, GameObject& object) {
+				const int tile = level.paths.topology().index(screenToTile(object.vInitPos));
+				switch (event)
+				{
+				case Level::Event::DOT:
+					episode.fReward += float(static_cast<Dot&>(object).value);
+					episode.vStatic[CH_DOT * nPlane + tile] = 0;
+					break;
+				case Level::Event::POWER_UP:
+					episode.fReward += 50.0f;
+					episode.vStatic[CH_POWER_UP * nPlane + tile] = 0;
+					break;
+				case Level::Event::GHOST_EATEN:
+					episode.fReward += float(nGhostValue);
+					break;
+				case Level::Event::CLEARED:
+					episode.bDone = true;
+					break;
+				case Level::Event::CAUGHT:
+					if (episode.nLives == 0)
+						episode.bDone = true;
+					else
+					{
+						level.resetPositions();
+						episode.nLives--;
+					}
+					break;
+				}
+			};
+
+			const float fElapsedTime = 1.0f / SIM_TICK_RATE;
+			for (int t = 0; t < nTicksPerStep && !episode.bDone; t++)
+			{
+				level.movePlayer(fElapsedTime, onEvent);
+				if (level.iDots > 0)
+					level.moveGhosts(fElapsedTime, onEvent);
+			}
+			if (++episode.nSteps >= MAX_STEPS)
+				episode.bDone = true;
+		}
+
+		void observe(const Episode& episode, uint8_t* obs) const
+		{
+			std::memcpy(obs, episode.vStatic.data(), episode.vStatic.size());
+			std::memset(obs + episode.vStatic.size(), 0, size_t(CHANNELS) * nPlane - episode.vStatic.size());
+			const Topology& grid = episode.level->paths.topology();
+			auto mark = [&](const int nChannel, const olc::vf2d& pos) {
+				obs[nChannel * nPlane + grid.index(screenToTile(pos))] = 1; // may be one past the edge while wrapping round
+			};
+			mark(CH_PACMAN, episode.level->player->getPos());
+			for (auto& ghost : episode.level->ghosts)
+				mark(ghostChannel(ghost->kind, ghost->getState()), ghost->getPos());
+		}
+	};
+}
+
+#endif
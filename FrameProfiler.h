@@ -0,0 +1,141 @@
+#ifndef FRAME_PROFILER_H
+#define FRAME_PROFILER_H
+
+#include "olcPixelGameEngine.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+
+namespace pm
+{
+	// Where a frame goes, phase by phase, F4 toggles it. The simulation phases are timed
+	// on the simulation thread once per tick, the engine's on the render thread once per
+	// frame; the last WINDOW times of each are kept for a rolling average and p99. While
+	// off, a timer costs a relaxed load and a branch, nothing is read from the clock
+	class FrameProfiler
+	{
+	public:
+		enum Phase { INPUT, POWER_UPS, PACMAN, GHOSTS, DRAW, REPLAY, LAYERS, PRESENT, PHASES };
+		static inline const std::array<const char*, PHASES> NAMES = { "input", "power ups", "pacman", "ghosts", "draw", "replay", "layers", "present" };
+
+		static const int WINDOW = 128; // times kept per phase
+
+		struct Summary
+		{
+			float fAverage; // microseconds
+			float fP99;
+			int nSamples;
+		};
+
+		// times a phase from here to the end of the scope
+		class Scope
+		{
+			FrameProfiler* pProfiler;
+			Phase phase;
+			std::chrono::steady_clock::time_point tpStart;
+
+		public:
+			Scope(FrameProfiler& profiler, const Phase phase) :
+				pProfiler(profiler.isEnabled() ? &profiler : nullptr),
+				phase(phase)
+			{
+				if (pProfiler) tpStart = std::chrono::steady_clock::now();
+			}
+			Scope(const Scope&) = delete;
+			Scope& operator=(const Scope&) = delete;
+			~Scope()
+			{
+				if (pProfiler)
+					pProfiler->record(phase, std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - tpStart).count());
+			}
+		};
+
+	private:
+		// written by one thread, read by the overlay on another
+		struct Samples
+		{
+			std::array<std::atomic<float>, WINDOW> vTimes;
+			std::atomic<uint32_t> nCount = { 0 };
+		};
+
+		std::atomic<bool> bEnabled;
+		std::array<Samples, PHASES> phases;
+
+	public:
+		FrameProfiler() : bEnabled(false) {}
+
+		// off forgets what was timed, so turning it back on starts afresh
+		void enable(const bool bEnable)
+		{
+			if (!bEnable)
+				for (Samples& samples : phases)
+					samples.nCount.store(0, std::memory_order_relaxed);
+			bEnabled.store(bEnable, std::memory_order_relaxed);
+		}
+		bool isEnabled() const { return bEnabled.load(std::memory_order_relaxed); }
+
+		void record(const Phase phase, const float fMicros)
+		{
+			Samples& samples = phases[phase];
+			const uint32_t n = samples.nCount.load(std::memory_order_relaxed);
+			samples.vTimes[n % WINDOW].store(fMicros, std::memory_order_relaxed);
+			samples.nCount.store(n + 1, std::memory_order_release);
+		}
+
+		Summary summary(const Phase phase) const
+		{
+			const Samples& samples = phases[phase];
+			const int nSamples = int(std::min<uint32_t>(samples.nCount.load(std::memory_order_acquire), WINDOW));
+			std::array<float, WINDOW> vSorted;
+			float fSum = 0.0f;
+			for (int i = 0; i < nSamples; i++)
+				fSum += vSorted[i] = samples.vTimes[i].load(std::memory_order_relaxed);
+			if (nSamples == 0)
+				return { 0.0f, 0.0f, 0 };
+			const int nP99 = std::min(nSamples - 1, nSamples * 99 / 100);
+			std::nth_element(vSorted.begin(), vSorted.begin() + nP99, vSorted.begin() + nSamples);
+			return { fSum / nSamples, vSorted[nP99], nSamples };
+		}
+
+		// a bar per phase, the average solid and the p99 behind it. The simulation's phases
+		// share one scale and the render thread's another, a tick is far shorter than a frame
+		void draw(olc::PixelGameEngine& pge) const
+		{
+			if (!isEnabled()) return;
+
+			std::array<Summary, PHASES> vSummaries;
+			float aScales[2] = { 1.0f, 1.0f };
+			for (int p = 0; p < PHASES; p++)
+			{
+				vSummaries[p] = summary(Phase(p));
+				aScales[p >= REPLAY] = std::max(aScales[p >= REPLAY], vSummaries[p].fP99);
+			}
+
+			const olc::vi2d vPos = { 4, pge.ScreenHeight() - PHASES * 10 - 16 };
+			const float fLabelWidth = 100.0f; // 25 half width characters
+			const float fBarWidth = float(pge.ScreenWidth() - 8) - fLabelWidth;
+			pge.FillRectDecal(vPos - olc::vi2d(2, 2), { float(pge.ScreenWidth() - 4), float(PHASES * 10 + 14) }, olc::Pixel(0, 0, 0, 180));
+			std::stringstream header;
+			header << std::left << std::setw(10) << "us" << std::right << std::setw(7) << "avg" << std::setw(8) << "p99";
+			pge.DrawStringDecal(vPos, header.str(), olc::GREY, { 0.5f, 0.75f });
+			for (int p = 0; p < PHASES; p++)
+			{
+				const olc::vf2d vRow = { float(vPos.x), float(vPos.y + 8 + p * 10) };
+				std::stringstream ss;
+				ss << std::fixed << std::setprecision(0) << std::left << std::setw(10) << NAMES[p]
+					<< std::right << std::setw(7) << vSummaries[p].fAverage << std::setw(8) << vSummaries[p].fP99;
+				pge.DrawStringDecal(vRow, ss.str(), olc::WHITE, { 0.5f, 1.0f });
+				const olc::vf2d vBar = vRow + olc::vf2d(fLabelWidth, 1.0f);
+				const float fScale = aScales[p >= REPLAY];
+				pge.FillRectDecal(vBar, { fBarWidth * vSummaries[p].fP99 / fScale, 6.0f }, olc::Pixel(255, 160, 60, 120));
+				pge.FillRectDecal(vBar, { fBarWidth * vSummaries[p].fAverage / fScale, 6.0f }, p < REPLAY ? olc::Pixel(90, 200, 255) : olc::Pixel(120, 255, 120));
+			}
+		}
+	};
+}
+
+#endif
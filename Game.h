@@ -6,8 +6,16 @@
 
 #include "olcPixelGameEngine.h"
 #include "olcPGEX_Sound.h"
+#include "Canvas.h"
 #include "Auxiliaries.h"
 #include "LevelEditor.h"
+#include "SoundQueue.h"
+#include "DebugOverlay.h"
+#include "FrameProfiler.h"
+#include "TraceRecorder.h"
+#include "AssetLoader.h"
+#include "WorkerPool.h"
+#include "Autopilot.h"
 
 #include <fstream>
 #include <bitset>
@@ -29,6 +37,39 @@ namespace pm
 			GAME_LOSE,
 			LEVEL_EDITOR,
 		};
+		static inline const std::array<const char*, 9> STATE_NAMES = { "main menu", "about", "highscores", "set", "play", "pause", "win", "lose", "level editor" };
+
+		// =============== threading
+
+		// the simulation draws and reads input through the canvas,
+		// the render thread only ever replays finished snapshots
+		Canvas canvas;
+		TripleBuffer<Snapshot> snapshots;
+		std::thread simThread;
+		std::atomic<bool> bSimRunning;
+		bool bThreaded;
+
+		// render thread only
+		DebugOverlay overlay;
+		// timed from both threads, drawn by the render thread
+		FrameProfiler profiler;
+		// where F5 and SIGUSR1 write the trace, empty while not tracing
+		std::string sTraceFile;
+		// the mixer's track, made by setTracing() before the mixer is told to record into it
+		static inline TraceRecorder::Ring* pAudioTrack = nullptr;
+
+		// the searches ghosts are about to make, worked out side by side before they move.
+		// Each worker searches its own copy of the level's walls, searching writes scratch
+		struct RouteQuery
+		{
+			Ghost* ghost;
+			olc::vi2d from;
+			olc::vi2d to;
+			int nStep;
+		};
+		WorkerPool ghostPool;
+		std::vector<Pathfinder> vWorkerPaths;
+		std::vector<RouteQuery> vRouteQueries;
 
 		// =============== menus' stuff
 
@@ -41,6 +82,7 @@ namespace pm
 		std::vector<TextBox*> mm_abut_texts;
 		std::vector<TextBox*> mm_high_texts;
 		bool bQuit;
+		bool isIdle;
 
 
 		// =============== game's stuff
@@ -59,9 +101,13 @@ namespace pm
 
 		GameState currState;
 		GameState nextState;
+		uint64_t nTick;
 
 		LevelEditor* editor;
 
+		// plays instead of the keyboard when set, see setAutopilot()
+		std::unique_ptr<Autopilot> autopilot;
+
 		// modern gameplay
 		uint16_t chain;
 		float chainCountDown;
@@ -74,6 +120,7 @@ namespace pm
 		float fCheerCountDown;
 
 		// sound
+		SoundQueue sounds;
 		int aBG;
 		int aGameover;
 		int aLevel;
@@ -91,10 +138,21 @@ namespace pm
 		olc::Decal* decalTV;
 		olc::Sprite* spriteBG;
 
+		// every asset comes from here when there is a pack, loose files otherwise
+		olc::ResourcePack pack;
+
+		// declared last, so its workers are gone before what they load into
+		AssetLoader loader;
+		bool bLoaded;
+
 	public:
-		Game() :
-			title_game (*this, olc::vi2d((ScreenWidth() - 9 * nTileSize) / 2, 36), "Pacmanx10"),
+		Game(bool bThreaded = true) :
+			canvas(*this),
+			bSimRunning(false),
+			bThreaded(bThreaded),
+			title_game (canvas, olc::vi2d((ScreenWidth() - 9 * nTileSize) / 2, 36), "Pacmanx10"),
 			bQuit(false),
+			isIdle(false),
 			nCurrLevel(0),
 			isOldschool(true),
 			isTutorial(true),
@@ -106,56 +164,43 @@ namespace pm
 			nLives(DEFAULT_LIFE),
 			currState(GameState::MM_MAIN),
 			nextState(GameState::MM_MAIN),
+			nTick(0),
 			fCheerCountDown(CHEER_DOWN_TIME),
 			currCheerString(0),
-			aBG(olc::SOUND::LoadAudioSample(PATH_SOUND "main_menu.wav")),
-			aGameover(olc::SOUND::LoadAudioSample(PATH_SOUND "game_over.wav")),
-			aLevel(olc::SOUND::LoadAudioSample(PATH_SOUND "level_music.wav")),
-			aScoreUp(olc::SOUND::LoadAudioSample(PATH_SOUND "score_up.wav")),
+			aBG(-1),
+			aGameover(-1),
+			aLevel(-1),
+			aScoreUp(-1),
 			decalTV(nullptr),
-			spriteBG(nullptr)
+			spriteBG(nullptr),
+			bLoaded(false)
 		{
 			sAppName = "Pacmanx10";
 		}
 
-#pragma region Levels Management
-		// load all the levels from "data.txt"
-		void getLevels()
+		// The asset build step: everything under Assets bar the sample cache goes into
+		// one pack, which the game then maps instead of opening each file on its own
+		static bool packAssets(const std::string& sFile)
 		{
-			std::ifstream inputDataFile{ PATH_DATA };
-
-			while (inputDataFile.good())
+			olc::ResourcePack builder;
+			for (auto& entry : fs::recursive_directory_iterator(PATH_ASSETS))
 			{
-				std::string result;
-				std::string buffer;
-				int lastLineSize = 0; // lines length, aka width
-				int i = 0;			  // num of lines, aka height
-				for (; std::getline(inputDataFile, buffer) && !buffer.empty(); i++)
-				{
-					if (i > 0 && buffer.size() != lastLineSize)
-					{
-						std::cout << "corrupted file!" << std::endl;
-						lastLineSize = 0;
-						break;
-					}
-					result += buffer;
-					lastLineSize = buffer.size();
-				}
-
-				// check validity
-				if (lastLineSize == 0)
+				std::string path = entry.path().generic_string();
+				if (!fs::is_regular_file(entry.path()) || path.rfind(PATH_SOUND_CACHE, 0) == 0)
 					continue;
-				//int count[static_cast<int>(Kind::COUNT)];
-				//for (auto c : result)
-				//	count[static_cast<int>(charToKind(c))]++;
-				//if (count[static_cast<int>(Kind::PLAYER)] != 1 || count[static_cast<int>(Kind::DOT)] < 1 || (count[static_cast<int>(Kind::GHOST_B)] +
-				//	count[static_cast<int>(Kind::GHOST_R)] + count[static_cast<int>(Kind::GHOST_G)] + count[static_cast<int>(Kind::GHOST_Y)] < 1))
-				//	continue;
-
-				levelDatas.push_back({ result, lastLineSize, i });
+				if (!builder.AddFile(path))
+					return false;
+				std::cout << "packed " << path << std::endl;
 			}
+			return builder.SavePack(sFile, "");
+		}
 
-			inputDataFile.close();
+#pragma region Levels Management
+		// load all the levels from "data.txt"
+		void getLevels()
+		{
+			std::istringstream inputDataFile(readDataFile(assets()));
+			levelDatas = readLevels(inputDataFile);
 		}
 
 		// load currLevel to be the next level
@@ -192,57 +237,162 @@ namespace pm
 			fTimeCountDown = COUNT_DOWN_TIME;
 			fCheerCountDown = CHEER_DOWN_TIME;
 
-			currLevel.reset(new Level(*this, decals, levelDatas[nCurrLevel], isOldschool, olc::vi2d(4.5f * nTileSize, 5.5f * nTileSize)));
+			if (autopilot) autopilot->reset();
+			TraceRecorder::Scope trace("load level", "level");
+			trace.arg("level", nCurrLevel);
+			currLevel.reset(new Level(canvas, decals, levelDatas[nCurrLevel], isOldschool, olc::vi2d(4.5f * nTileSize, 5.5f * nTileSize)));
 			currCheerleader = isOldschool ? decals[SPRITE_MINI_PACMAN] : decals[SPRITE_PACMAN];
 		}
 
+		// jump straight into a level with a fresh game, skipping the menus
+		void startLevel(int level, bool oldschool)
+		{
+			isOldschool = oldschool;
+			chain = 0;
+			nScore = 0;
+			nLives = DEFAULT_LIFE;
+			currCheerString = 0;
+			loadLevel(level);
+			TraceRecorder::instant(STATE_NAMES[int(GameState::GAME_SET)], "state");
+			currState = nextState = GameState::GAME_SET;
+		}
+
+		int numOfLevels() const { return levelDatas.size(); }
+
+		// how the level from startLevel() is going, for runners that drive the game themselves
+		enum class Outcome { PLAYING, WON, LOST };
+		Outcome outcome() const
+		{
+			switch (currState)
+			{
+			case GameState::GAME_WIN:  return Outcome::WON;
+			case GameState::GAME_LOSE: return Outcome::LOST;
+			default:                   return Outcome::PLAYING;
+			}
+		}
+		int dotsLeft() const { return currLevel ? currLevel->iDots : 0; }
+		int livesLeft() const { return nLives; }
+
 #pragma endregion
 
+		// The bot plays from now on, starting a new game from the main menu whenever it's
+		// there, so it can be left running. nDepth is how many tiles it looks ahead
+		void setAutopilot(const int nDepth = Autopilot::DEFAULT_DEPTH) { autopilot = std::make_unique<Autopilot>(nDepth); }
+		// the same as pressing F4
+		void setProfiling(const bool bOn)
+		{
+			profiler.enable(bOn);
+			SetCoreTiming(bOn);
+		}
+		// records a trace from now on, see TraceRecorder
+		void setTracing(const std::string& sFile)
+		{
+			sTraceFile = sFile;
+			TraceRecorder::enable(true);
+			pAudioTrack = &TraceRecorder::track("audio");
+			olc::SOUND::SetBlockObserver(traceAudioBlock);
+		}
+		bool dumpTrace() const { return !sTraceFile.empty() && TraceRecorder::dump(sTraceFile); }
+
+		// runs ticks without drawing them, only when the simulation shares the engine thread
+		void fastForward(int nTicks)
+		{
+			if (bThreaded) return;
+			while (nTicks-- > 0)
+				step();
+		}
+
 		bool OnUserCreate() override
 		{
-			// Audio
-			if (!olc::SOUND::InitialiseAudio()) return false;
-			for (int i = 1; i <= 4; ++i) aPac  .push_back(olc::SOUND::LoadAudioSample(PATH_SOUND "pac_0"    + std::to_string(i) + ".wav"));
-			for (int i = 1; i <= 3; ++i) aYum  .push_back(olc::SOUND::LoadAudioSample(PATH_SOUND "yummy_0"  + std::to_string(i) + ".wav"));
-			for (int i = 1; i <= 3; ++i) aWah  .push_back(olc::SOUND::LoadAudioSample(PATH_SOUND "wah_0"    + std::to_string(i) + ".wav"));
-			for (int i = 1; i <= 3; ++i) aNya  .push_back(olc::SOUND::LoadAudioSample(PATH_SOUND "nya_0"    + std::to_string(i) + ".wav"));
-			for (int i = 1; i <= 2; ++i) aFart .push_back(olc::SOUND::LoadAudioSample(PATH_SOUND "fart_0"   + std::to_string(i) + ".wav"));
-			for (int i = 1; i <= 3; ++i) aBlbl .push_back(olc::SOUND::LoadAudioSample(PATH_SOUND "blblbl_0" + std::to_string(i) + ".wav"));
-			for (int i = 1; i <= 2; ++i) aClick.push_back(olc::SOUND::LoadAudioSample(PATH_SOUND "click_0"  + std::to_string(i) + ".wav"));
-			olc::SOUND::PlaySample(aBG, true);
-
-			// Graphics
-			for (int i = 0; i < SPRITE_NAMES.size(); ++i)
-				decals.push_back(new olc::Decal(new olc::Sprite(PATH_GRAPHICS + SPRITE_NAMES[i])));
-			decalTV = new olc::Decal(new olc::Sprite(PATH_GRAPHICS "tv.png"));
-			spriteBG = new olc::Sprite(PATH_GRAPHICS "bg.png");
+			TraceRecorder::nameThread("engine");
+
+			// Audio, no sound card (or no file to write to) is no reason not to play
+			if (!olc::SOUND::InitialiseAudio(44100, 1, AUDIO_BLOCKS, AUDIO_BLOCK_SAMPLES))
+			{
+				olc::SOUND::SetBackend(olc::SOUND::Backend::NONE);
+				olc::SOUND::InitialiseAudio(44100, 1, AUDIO_BLOCKS, AUDIO_BLOCK_SAMPLES);
+			}
+			olc::SOUND::SetMaxVoices(MAX_VOICES);
+			sounds.setRule(SoundKind::PAC,          { 1, 0.08f, 2, Retrigger::OVERLAP, 0.8f });
+			sounds.setRule(SoundKind::CLICK,        { 2, 0.05f, 1, Retrigger::RESTART, 1.0f });
+			sounds.setRule(SoundKind::FART,         { 2, 0.05f, 1, Retrigger::RESTART, 1.0f });
+			sounds.setRule(SoundKind::YUMMY,        { 3, 0.0f,  1, Retrigger::RESTART, 1.0f });
+			sounds.setRule(SoundKind::SCORE_UP,     { 3, 0.0f,  1, Retrigger::RESTART, 1.0f });
+			sounds.setRule(SoundKind::GHOST_EATEN,  { 3, 0.0f,  2, Retrigger::OVERLAP, 1.0f });
+			sounds.setRule(SoundKind::GHOST_EAT_ME, { 4, 0.0f,  1, Retrigger::RESTART, 1.0f });
+			sounds.setRule(SoundKind::VICTORY,      { 5, 0.0f,  1, Retrigger::IGNORE,  1.0f });
+			sounds.setRule(SoundKind::LOSE,         { 5, 0.0f,  1, Retrigger::IGNORE,  1.0f });
+			// music isn't queued, it's started and stopped straight on olc::SOUND at SOUND_PRIORITY_MUSIC
+
+			// One mapped archive instead of a file open per asset, see packAssets()
+			pack.LoadPack(PATH_PACK, "");
+
+			// samples are converted to the device format as they load, so only after InitialiseAudio
+			fs::create_directories(PATH_SOUND_CACHE);
+			olc::SOUND::SetSampleCache(PATH_SOUND_CACHE);
+			aBG       = olc::SOUND::LoadAudioStream(PATH_SOUND "main_menu.wav", assets()); // music is streamed, effects stay in memory
+			aGameover = olc::SOUND::LoadAudioStream(PATH_SOUND "game_over.wav", assets());
+			aLevel    = olc::SOUND::LoadAudioStream(PATH_SOUND "level_music.wav", assets());
+
+			// Everything else is decoded on worker threads while the loading screen is up
+			loadSample (aScoreUp, PATH_SOUND "score_up.wav");
+			loadSamples(aPac,   PATH_SOUND "pac_0",    4);
+			loadSamples(aYum,   PATH_SOUND "yummy_0",  3);
+			loadSamples(aWah,   PATH_SOUND "wah_0",    3);
+			loadSamples(aNya,   PATH_SOUND "nya_0",    3);
+			loadSamples(aFart,  PATH_SOUND "fart_0",   2);
+			loadSamples(aBlbl,  PATH_SOUND "blblbl_0", 3);
+			loadSamples(aClick, PATH_SOUND "click_0",  2);
+
+			decals.resize(SPRITE_NAMES.size());
+			for (size_t i = 0; i < SPRITE_NAMES.size(); ++i)
+				loadDecal(decals[i], PATH_GRAPHICS + SPRITE_NAMES[i]);
+			loadDecal(decalTV, PATH_GRAPHICS "tv.png");
+			spriteBG = new olc::Sprite();
+			loader.add([this] { spriteBG->LoadFromFile(PATH_GRAPHICS "bg.png", assets()); }, nullptr, PATH_GRAPHICS "bg.png");
+			loader.add([this] { getLevels(); }, nullptr, PATH_DATA);
+			loader.start();
 
 			// UI
 			int x = (ScreenWidth() - 17 * nTileSize) / 2;
 			int y = 8 * nTileSize;
-			mm_main_buttons.push_back(new Button(*this, olc::vi2d(x, y + 0 * nTileSize), "Play",  [this] { loadLevel(isTutorial ? 0 : NUM_OF_TUTORIAL_LEVELS); olc::SOUND::StopSample(aBG); olc::SOUND::PlaySample(aLevel, true); nextState = GameState::GAME_SET; }));
-			mm_main_buttons.push_back(new Button(*this, olc::vi2d(x, y + 6 * nTileSize), "About", [this] { playSoundKind(SoundKind::CLICK); nextState = GameState::MM_ABOUT; }));
-			mm_main_buttons.push_back(new Button(*this, olc::vi2d(x, y + 8 * nTileSize), "Highscores", [this] { playSoundKind(SoundKind::CLICK); nextState = GameState::MM_HIGHSCORES; }));
-			mm_main_buttons.push_back(new Button(*this, olc::vi2d(x, y + 10 * nTileSize), "Quit", [this] { playSoundKind(SoundKind::FART); bQuit = true; }));
-			mm_main_switches.push_back(new Switch(*this, olc::vi2d(x, y + 2 * nTileSize), "Classic", "Modern ", [this] { (isOldschool = !isOldschool) ? playSoundKind(SoundKind::FART) : playSoundKind(SoundKind::CLICK);}, false));
-			mm_main_switches.push_back(new Switch(*this, olc::vi2d(x, y + 4 * nTileSize), "", "Tutorial", [this] { (isTutorial = !isTutorial) ? playSoundKind(SoundKind::CLICK) : playSoundKind(SoundKind::FART); }));
+			mm_main_buttons.push_back(new Button(canvas, olc::vi2d(x, y + 0 * nTileSize), "Play",  [this] { play(); }));
+			mm_main_buttons.push_back(new Button(canvas, olc::vi2d(x, y + 6 * nTileSize), "About", [this] { playSoundKind(SoundKind::CLICK); nextState = GameState::MM_ABOUT; }));
+			mm_main_buttons.push_back(new Button(canvas, olc::vi2d(x, y + 8 * nTileSize), "Highscores", [this] { playSoundKind(SoundKind::CLICK); nextState = GameState::MM_HIGHSCORES; }));
+			mm_main_buttons.push_back(new Button(canvas, olc::vi2d(x, y + 10 * nTileSize), "Quit", [this] { playSoundKind(SoundKind::FART); bQuit = true; }));
+			mm_main_switches.push_back(new Switch(canvas, olc::vi2d(x, y + 2 * nTileSize), "Classic", "Modern ", [this] { (isOldschool = !isOldschool) ? playSoundKind(SoundKind::FART) : playSoundKind(SoundKind::CLICK);}, false));
+			mm_main_switches.push_back(new Switch(canvas, olc::vi2d(x, y + 4 * nTileSize), "", "Tutorial", [this] { (isTutorial = !isTutorial) ? playSoundKind(SoundKind::CLICK) : playSoundKind(SoundKind::FART); }));
 
-			mm_abut_buttons.push_back(new Button(*this, olc::vi2d(x, y + 12 * nTileSize), "Back", [this] { playSoundKind(SoundKind::FART); nextState = GameState::MM_MAIN; }));
-			mm_abut_texts.push_back(new TextBox(*this, olc::vi2d(x, y + 1 * nTileSize), "Explanation stuff,\n\nI ain't good at it\n\n        UWU"));
-			mm_abut_texts.push_back(new TextBox(*this, olc::vi2d(x, y + 8 * nTileSize), " You're #1 David! "));
+			mm_abut_buttons.push_back(new Button(canvas, olc::vi2d(x, y + 12 * nTileSize), "Back", [this] { playSoundKind(SoundKind::FART); nextState = GameState::MM_MAIN; }));
+			mm_abut_texts.push_back(new TextBox(canvas, olc::vi2d(x, y + 1 * nTileSize), "Explanation stuff,\n\nI ain't good at it\n\n        UWU"));
+			mm_abut_texts.push_back(new TextBox(canvas, olc::vi2d(x, y + 8 * nTileSize), " You're #1 David! "));
 
-			mm_high_buttons.push_back(new Button(*this, olc::vi2d(x, y + 12 * nTileSize), "Back", [this] { playSoundKind(SoundKind::FART); nextState = GameState::MM_MAIN; }));
-			mm_high_texts.push_back(new TextBox(*this, olc::vi2d(x, y + 1 * nTileSize), "\n\n\n  Coming Soon!  \n\n\n"));
+			mm_high_buttons.push_back(new Button(canvas, olc::vi2d(x, y + 12 * nTileSize), "Back", [this] { playSoundKind(SoundKind::FART); nextState = GameState::MM_MAIN; }));
+			mm_high_texts.push_back(new TextBox(canvas, olc::vi2d(x, y + 1 * nTileSize), "\n\n\n  Coming Soon!  \n\n\n"));
 
-			// Game
-			getLevels();
-			editor = new LevelEditor(*this, decals);
+			// Pacing
+			SetFrameLimit(FRAME_LIMIT);
+
+			// offscreen runs have to start on the same frame every time
+			if (!bThreaded)
+			{
+				loader.wait();
+				onAssetsLoaded();
+			}
 
 			return true;
 		}
 
 		bool OnUserDestroy() override
 		{
+			loader.cancel();
+			if (simThread.joinable())
+			{
+				bSimRunning = false;
+				canvas.wake();
+				simThread.join();
+			}
+
 			olc::SOUND::DestroyAudio();
 
 			return true;
@@ -250,8 +400,152 @@ namespace pm
 
 		bool OnUserUpdate(float fElapsedTime) override
 		{
+			TraceRecorder::Scope trace("frame", "engine");
+			if (!bLoaded)
+			{
+				if (!loader.update())
+				{
+					drawLoadingScreen();
+					return true;
+				}
+				onAssetsLoaded();
+			}
+
+			// the engine's part of the last frame
+			if (profiler.isEnabled())
+			{
+				profiler.record(FrameProfiler::LAYERS, GetLayerTime() * 1e6f);
+				profiler.record(FrameProfiler::PRESENT, GetPresentTime() * 1e6f);
+			}
+
+			canvas.pushInput();
+			if (!bThreaded)
+				step();
+
+			const Snapshot& snapshot = snapshots.readBuffer();
+			{
+				FrameProfiler::Scope timer(profiler, FrameProfiler::REPLAY);
+				Canvas::replay(*this, snapshot);
+			}
+
+			if (GetKey(olc::F3).bPressed)
+				overlay.toggle();
+			overlay.draw(*this);
+			if (GetKey(olc::F4).bPressed)
+			{
+				setProfiling(!profiler.isEnabled());
+			}
+			profiler.draw(*this);
+			if (GetKey(olc::F5).bPressed || TraceRecorder::dumpRequested())
+				dumpTrace();
+
+			// don't idle until the simulation has seen the latest input, or its answer would be late
+			SetIdle(snapshot.bIdle && snapshot.nInputSeq == canvas.pushedSeq(), IDLE_FRAME_RATE);
+
+			return !snapshot.bQuit;
+		}
+
+	private:
+		// the mixer's blocks go on a track of their own, whichever thread mixes them
+		static void traceAudioBlock(int64_t nStart, int64_t nEnd, unsigned int nFrames, unsigned int nActiveVoices)
+		{
+			TraceRecorder::complete(*pAudioTrack, "mix", "audio", nStart, nEnd, "frames", int(nFrames), "voices", int(nActiveVoices));
+		}
+
+#pragma region Loading
+		olc::ResourcePack* assets() { return pack.Loaded() ? &pack : nullptr; }
+
+		void loadSample(int& id, const std::string& file)
+		{
+			auto sample = std::make_shared<olc::SOUND::AudioSample>();
+			loader.add([this, sample, file] { sample->LoadFromFile(file, assets()); },
+				[&id, sample] { id = sample->bSampleValid ? olc::SOUND::AddAudioSample(std::move(*sample)) : -1; }, file);
+		}
+		void loadSamples(std::vector<int>& ids, const std::string& prefix, int count)
+		{
+			ids.resize(count);
+			for (int i = 0; i < count; ++i)
+				loadSample(ids[i], prefix + std::to_string(i + 1) + ".wav");
+		}
+		// the sprite is decoded on a worker, its texture has to be made on the render thread.
+		// The job owns the sprite until the decal takes it, so a cancelled load doesn't leak it
+		void loadDecal(olc::Decal*& decal, const std::string& file)
+		{
+			auto sprite = std::make_shared<std::unique_ptr<olc::Sprite>>(new olc::Sprite());
+			loader.add([this, sprite, file] { (*sprite)->LoadFromFile(file, assets()); },
+				[&decal, sprite] { decal = new olc::Decal(sprite->release()); }, file);
+		}
+
+		// everything here needs the assets, and the sim thread touches all of it
+		void onAssetsLoaded()
+		{
+			editor = new LevelEditor(canvas, decals);
+			olc::SOUND::PlaySample(aBG, true, SOUND_PRIORITY_MUSIC);
+
+			if (bThreaded)
+			{
+				bSimRunning = true;
+				simThread = std::thread(&Game::simulationThread, this);
+			}
+			bLoaded = true;
+		}
+
+		void drawLoadingScreen()
+		{
+			olc::vi2d vSize = { ScreenWidth() / 2, 8 };
+			olc::vi2d vPos = { (ScreenWidth() - vSize.x) / 2, ScreenHeight() / 2 };
 			Clear(olc::BLACK);
-			DrawSprite(tileToScreen(1, 1), spriteBG);
+			DrawString(vPos - olc::vi2d(0, 12), "Loading...");
+			DrawRect(vPos, vSize - olc::vi2d(1, 1));
+			FillRect(vPos + olc::vi2d(2, 2), { int((vSize.x - 4) * loader.progress()), vSize.y - 4 });
+		}
+#pragma endregion
+
+		// runs the game at a fixed rate, independent of how fast frames are drawn
+		void simulationThread()
+		{
+			TraceRecorder::nameThread("simulation");
+			const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / SIM_TICK_RATE));
+			auto tpNextTick = std::chrono::steady_clock::now();
+			while (bSimRunning)
+			{
+				if (step())
+				{
+					// nothing changes until the player does something
+					canvas.waitForInput(bSimRunning);
+					tpNextTick = std::chrono::steady_clock::now();
+					continue;
+				}
+
+				auto now = std::chrono::steady_clock::now();
+				tpNextTick += period;
+				if (tpNextTick < now - period) tpNextTick = now; // too far behind, drop the ticks
+				std::this_thread::sleep_until(tpNextTick);
+			}
+		}
+
+		// one simulation tick recorded into a fresh snapshot, returns whether the game is idle
+		bool step()
+		{
+			TraceRecorder::Scope trace("tick", "simulation");
+			trace.arg("tick", int(nTick + 1));
+			Snapshot& snapshot = snapshots.writeBuffer();
+			canvas.pullInput();
+			canvas.begin(snapshot);
+			update(1.0f / SIM_TICK_RATE);
+			olc::SOUND::Advance(1.0f / SIM_TICK_RATE); // WAV output follows the simulation, not the wall clock
+			snapshot.nTick = ++nTick;
+			snapshot.bIdle = isIdle;
+			snapshot.bQuit = bQuit;
+			snapshots.publish();
+			return isIdle;
+		}
+
+		void update(float fElapsedTime)
+		{
+			sounds.update(fElapsedTime);
+			canvas.Clear(olc::BLACK);
+			canvas.DrawSprite(tileToScreen(1, 1), spriteBG);
 			//FillRect(tileToScreen(1, 1), olc::vf2d(ScreenWidth() - 20, ScreenHeight() - 20), olc::DARK_GREEN);
 
 			switch (currState)
@@ -260,6 +554,8 @@ namespace pm
 				{
 					std::for_each(mm_main_buttons.begin(),  mm_main_buttons.end(),  [](auto b) { b->update(); });
 					std::for_each(mm_main_switches.begin(), mm_main_switches.end(), [](auto s) { s->update(); });
+					if (autopilot && nextState == GameState::MM_MAIN)
+						play();
 
 					title_game.draw();
 					std::for_each(mm_main_buttons.begin(),  mm_main_buttons.end(),  [](auto b) { b->draw(); });
@@ -286,7 +582,7 @@ namespace pm
 				}
 				case GameState::GAME_SET:
 				{
-					currLevel->player->getInput(*this);
+					steerPlayer();
 
 					fTimeCountDown -= fElapsedTime;
 					if (fTimeCountDown <= 0)
@@ -305,11 +601,14 @@ namespace pm
 				case GameState::GAME_PLAY:
 				{
 					// ============== INPUT ==============
-					currLevel->player->getInput(*this);
-					if (GetKey(olc::P).bPressed)
+					{
+						FrameProfiler::Scope timer(profiler, FrameProfiler::INPUT); // the autopilot too, when it plays
+						steerPlayer();
+					}
+					if (canvas.GetKey(olc::P).bPressed)
 					{
 						olc::SOUND::StopSample(aLevel);
-						olc::SOUND::PlaySample(aBG);
+						olc::SOUND::PlaySample(aBG, false, SOUND_PRIORITY_MUSIC);
 						nextState = GameState::GAME_PAUSE;
 						break;
 					}
@@ -328,7 +627,7 @@ namespace pm
 						chainCountDown -= fElapsedTime;
 						if (chainCountDown < 0.0f)
 						{
-							if (chain >= 420) olc::SOUND::PlaySample(aScoreUp);
+							if (chain >= 420) playSoundKind(SoundKind::SCORE_UP);
 							nScore += chain;
 							chain = 0;
 							chainCountDown = 0;
@@ -344,107 +643,38 @@ namespace pm
 					}
 
 					// update powerUps animation
-					std::for_each(currLevel->powerUps.begin(), currLevel->powerUps.end(), [&](std::shared_ptr<PowerUp> pu) {pu->update(fElapsedTime); });
-
-					// update pacman
-					currLevel->player->update(fElapsedTime);
-					BOARD_MAP::iterator it = currLevel->player->getCollision(currLevel->board);
-					if (it != currLevel->board.end())
-						switch (it->second->kind) // check collision with...
-						{
-						case Kind::WALL:
-							currLevel->player->collideWithWall();
-							break;
-						case Kind::DOT:
-						{
-							playSoundKind(SoundKind::PAC);
-							Dot* d = dynamic_cast<Dot*>(it->second.get());
-							if (isOldschool)
-								nScore += d->value;
-							else
-							{
-								chain <<= 1;
-								chain += d->value;
-								// chain &= (int(pow(2, nChainLength)) - 1);
-								// chain is uint16_t so it happens automatically
-							}
-							chainCountDown = CHAIN_DOWN_TIME;
-							currLevel->board.erase(it);
-							if (--currLevel->iDots == 0) // end level!
-							{
-								olc::SOUND::StopAll();
-								playSoundKind(SoundKind::VICTORY);
-								fTimeCountDown = COUNT_DOWN_TIME;
-								nextState = GameState::GAME_WIN;
-							}
-							break;
-						}
-						case Kind::POWER_UP:
-							playSoundKind(SoundKind::YUMMY);
-							std::for_each(currLevel->ghosts.begin(), currLevel->ghosts.end(), [&](auto ghost) {ghost->makeWeak(); });
-							nScore += 50;
-							currLevel->board.erase(it);
-							break;
-						}
+					{
+						FrameProfiler::Scope timer(profiler, FrameProfiler::POWER_UPS);
+						std::for_each(currLevel->powerUps.begin(), currLevel->powerUps.end(), [&](std::shared_ptr<PowerUp> pu) {pu->update(fElapsedTime); });
+					}
 
+					// update pacman, then the ghosts unless that was the last dot
+					auto onEvent = [&](const Level::Event event, GameObject& object) { onLevelEvent(event, object); };
+					{
+						FrameProfiler::Scope timer(profiler, FrameProfiler::PACMAN);
+						currLevel->movePlayer(fElapsedTime, onEvent);
+					}
 					if (nextState != GameState::GAME_WIN) // not sure about this
 					{
-						// update ghosts
-						for (auto ghost : currLevel->ghosts)
-						{
-							// move forward
-							ghost->update(fElapsedTime);
-
-							// check collision of ghost with pacman
-							if (checkCollision(currLevel->player->getPos(), ghost->getPos()))
-							{
-								switch (ghost->getState())
-								{
-								case Ghost::GhostState::STRONG:
-									if (nLives == 0) // end game!!
-									{
-										olc::SOUND::StopAll();
-										olc::SOUND::PlaySample(aGameover);
-										fTimeCountDown = 6;
-										// Hard-coded number DAMNNNN
-										// Update: on hindsight, there are too much of them XD
-										nextState = GameState::GAME_LOSE;
-									}
-									else
-									{
-										playSoundKind(SoundKind::GHOST_EAT_ME);
-										resetLevel();
-										nLives--;
-										nextState = GameState::GAME_SET;
-									}
-									break;
-								case Ghost::GhostState::WEAK:
-									playSoundKind(SoundKind::GHOST_EATEN);
-									ghost->makeEaten();
-									nScore += isOldschool ? nGhostValue : int(pow(2, nChainLength - 1));
-									break;
-									//case Ghost::GhostState::EATEN: break;
-								}
-							}
-
-							// check collision of ghost with walls
-							it = ghost->getCollision(currLevel->board);
-							if (it != currLevel->board.end() && it->second->kind == Kind::WALL)
-								ghost->collideWithWall();
-						}
+						FrameProfiler::Scope timer(profiler, FrameProfiler::GHOSTS);
+						planGhostRoutes();
+						currLevel->moveGhosts(fElapsedTime, onEvent);
 					}
 
 					// ============== DRAW ==============
-					drawGame();
+					{
+						FrameProfiler::Scope timer(profiler, FrameProfiler::DRAW);
+						drawGame();
+					}
 
 					break;
 				}
 				case GameState::GAME_PAUSE:
 				{
-					if (GetKey(olc::ESCAPE).bPressed || GetKey(olc::P).bPressed)
+					if (canvas.GetKey(olc::ESCAPE).bPressed || canvas.GetKey(olc::P).bPressed)
 					{
 						olc::SOUND::StopSample(aBG);
-						olc::SOUND::PlaySample(aLevel, true);
+						olc::SOUND::PlaySample(aLevel, true, SOUND_PRIORITY_MUSIC);
 						nextState = GameState::GAME_PLAY;
 					}
 
@@ -463,7 +693,7 @@ namespace pm
 						
 						loadNextLevel();
 						nextState = GameState::GAME_SET;
-						olc::SOUND::PlaySample(aLevel, true);
+						olc::SOUND::PlaySample(aLevel, true, SOUND_PRIORITY_MUSIC);
 						break;
 					}
 
@@ -489,7 +719,7 @@ namespace pm
 
 						loadLevel(nCurrLevel);
 
-						olc::SOUND::PlaySample(aBG, true);
+						olc::SOUND::PlaySample(aBG, true, SOUND_PRIORITY_MUSIC);
 						break;
 					}
 
@@ -506,18 +736,119 @@ namespace pm
 			}
 
 			// draw tv
-			DrawDecal(olc::vi2d(-2, -2), decalTV, olc::vf2d(0.825f,0.775f));
+			canvas.DrawDecal(olc::vi2d(-2, -2), decalTV, olc::vf2d(0.825f,0.775f));
 
-			currState = nextState;
+			// menus and pause only change on input, so let the engine idle until then
+			isIdle = nextState == currState &&
+				(currState == GameState::MM_MAIN || currState == GameState::MM_ABOUT || currState == GameState::MM_HIGHSCORES || currState == GameState::GAME_PAUSE);
 
-			return !bQuit;
+			if (nextState != currState)
+				TraceRecorder::instant(STATE_NAMES[int(nextState)], "state");
+			currState = nextState;
 		}
 
-	private:
+		// Nothing moves while the workers search, and each ghost still decides for itself in
+		// update(), in order, only taking a planned answer to the exact question it asks.
+		// So play comes out the same whatever the thread count
+		void planGhostRoutes()
+		{
+			vRouteQueries.clear();
+			const Pathfinder& paths = currLevel->paths;
+			for (auto& ghost : currLevel->ghosts)
+			{
+				RouteQuery query = { ghost.get(), { 0, 0 }, { 0, 0 }, -1 };
+				// a tracked target is a lookup, no search to share out
+				if (ghost->nextRoute(query.from, query.to) && !paths.isTracked(query.to))
+					vRouteQueries.push_back(query);
+			}
+			// waking the workers costs more than a search or two on a small level
+			if (vRouteQueries.size() < 2 || int(vRouteQueries.size()) * paths.tiles() < PARALLEL_ROUTE_TILES)
+				return;
+
+			vWorkerPaths.resize(ghostPool.size(), Pathfinder(1, 1));
+			ghostPool.run(int(vRouteQueries.size()), [&](const int i, const int nWorker) {
+				Pathfinder& mine = vWorkerPaths[nWorker];
+				if (mine.version() != paths.version())
+					mine.copyWalls(paths);
+				RouteQuery& query = vRouteQueries[i];
+				query.nStep = mine.firstStep(query.from, query.to);
+			});
+			for (auto& query : vRouteQueries)
+				query.ghost->planRoute(query.from, query.to, query.nStep);
+		}
+		// the Play button
+		void play()
+		{
+			loadLevel(isTutorial ? 0 : NUM_OF_TUTORIAL_LEVELS);
+			olc::SOUND::StopSample(aBG);
+			olc::SOUND::PlaySample(aLevel, true, SOUND_PRIORITY_MUSIC);
+			nextState = GameState::GAME_SET;
+		}
+		void steerPlayer()
+		{
+			if (autopilot)
+				autopilot->drive(*currLevel);
+			else
+				currLevel->player->getInput(canvas);
+		}
+		// the game's side of the level's rules: sound, score, and what comes next
+		void onLevelEvent(const Level::Event event, GameObject& object)
+		{
+			switch (event)
+			{
+			case Level::Event::DOT:
+			{
+				playSoundKind(SoundKind::PAC);
+				Dot* d = dynamic_cast<Dot*>(&object);
+				if (isOldschool)
+					nScore += d->value;
+				else
+				{
+					chain <<= 1;
+					chain += d->value;
+					// chain &= (int(pow(2, nChainLength)) - 1);
+					// chain is uint16_t so it happens automatically
+				}
+				chainCountDown = CHAIN_DOWN_TIME;
+				break;
+			}
+			case Level::Event::CLEARED:
+				sounds.stopAll();
+				playSoundKind(SoundKind::VICTORY);
+				fTimeCountDown = COUNT_DOWN_TIME;
+				nextState = GameState::GAME_WIN;
+				break;
+			case Level::Event::POWER_UP:
+				playSoundKind(SoundKind::YUMMY);
+				nScore += 50;
+				break;
+			case Level::Event::CAUGHT:
+				if (nLives == 0) // end game!!
+				{
+					sounds.stopAll();
+					playSoundKind(SoundKind::LOSE);
+					fTimeCountDown = 6;
+					// Hard-coded number DAMNNNN
+					// Update: on hindsight, there are too much of them XD
+					nextState = GameState::GAME_LOSE;
+				}
+				else
+				{
+					playSoundKind(SoundKind::GHOST_EAT_ME);
+					resetLevel();
+					nLives--;
+					nextState = GameState::GAME_SET;
+				}
+				break;
+			case Level::Event::GHOST_EATEN:
+				playSoundKind(SoundKind::GHOST_EATEN);
+				nScore += isOldschool ? nGhostValue : int(pow(2, nChainLength - 1));
+				break;
+			}
+		}
 		void resetLevel()
 		{
-			currLevel->player->resetPos();
-			std::for_each(currLevel->ghosts.begin(), currLevel->ghosts.end(), [&](auto ghost) {ghost->resetPos(); });
+			currLevel->resetPositions();
 		}
 		void drawGame()
 		{
@@ -526,8 +857,8 @@ namespace pm
 			currLevel->draw();
 
 			// Cheerleading pacman
-			DrawDecal(currLevel->vPos + olc::vi2d(0, -nTileSize - 4), currCheerleader);
-			DrawString(currLevel->vPos + olc::vi2d(nTileSize * 1.5f, -nTileSize - 4), isOldschool ? strCheerSon[currCheerString] : strCheerDad[currCheerString]);
+			canvas.DrawDecal(currLevel->vPos + olc::vi2d(0, -nTileSize - 4), currCheerleader);
+			canvas.DrawString(currLevel->vPos + olc::vi2d(nTileSize * 1.5f, -nTileSize - 4), isOldschool ? strCheerSon[currCheerString] : strCheerDad[currCheerString]);
 
 			// Info
 			int x = currLevel->width  * nTileSize + currLevel->vPos.x + nTileSize / 2;
@@ -554,14 +885,14 @@ namespace pm
 			}
 			int livesColor = std::clamp(nLives * 150, 0, 255);
 			int chainColor = std::clamp(255 - int(pow(log2(chain + 1), 2)), 0, 255);
-			DrawString(vTime, "Time:  " + std::to_string(int(fLevelTime)));
-			DrawString(vScore, "Score: " + std::to_string(nScore));
-			DrawString(vLives, "Lives: " + std::to_string(nLives), olc::Pixel(255, livesColor, livesColor));
+			canvas.DrawString(vTime, "Time:  " + std::to_string(int(fLevelTime)));
+			canvas.DrawString(vScore, "Score: " + std::to_string(nScore));
+			canvas.DrawString(vLives, "Lives: " + std::to_string(nLives), olc::Pixel(255, livesColor, livesColor));
 			if (!isOldschool)
 			{
-				DrawString(vChainTime, "Chain-Time: " + std::to_string(chainCountDown).substr(0, 4));
-				DrawString(vChainText, "Chain: ", olc::WHITE);
-				DrawString(vChain, std::bitset<nChainLength>(chain).to_string(), olc::Pixel(chainColor, 255, chainColor));
+				canvas.DrawString(vChainTime, "Chain-Time: " + std::to_string(chainCountDown).substr(0, 4));
+				canvas.DrawString(vChainText, "Chain: ", olc::WHITE);
+				canvas.DrawString(vChain, std::bitset<nChainLength>(chain).to_string(), olc::Pixel(chainColor, 255, chainColor));
 			}
 
 			// debug tile
@@ -569,8 +900,8 @@ namespace pm
 		}
 		void coverScreen(std::string&& message)
 		{
-			FillRectDecal(currLevel->vPos, tileToScreen(currLevel->width, currLevel->height), olc::Pixel(0, 0, 0, 150));
-			DrawStringDecal(currLevel->vPos + tileToScreen((currLevel->width - message.length()) / 2, currLevel->height / 2), message);
+			canvas.FillRectDecal(currLevel->vPos, tileToScreen(currLevel->width, currLevel->height), olc::Pixel(0, 0, 0, 150));
+			canvas.DrawStringDecal(currLevel->vPos + tileToScreen((currLevel->width - message.length()) / 2, currLevel->height / 2), message);
 			//DrawRect(currLevel->vPos, tileToScreen(currLevel->width, currLevel->height), olc::BLACK);
 		}
 		void playSoundKind(const SoundKind se)
@@ -578,9 +909,9 @@ namespace pm
 			std::vector<int> v;
 			switch (se)
 			{
-			case SoundKind::LOSE:			olc::SOUND::PlaySample(aGameover);		return;
-			case SoundKind::SCORE_UP:		olc::SOUND::PlaySample(aScoreUp);		return;
-			case SoundKind::LEVEL_MUSIC:	olc::SOUND::PlaySample(aLevel, true);	return;
+			case SoundKind::LOSE:			sounds.play(se, aGameover);		return;
+			case SoundKind::SCORE_UP:		sounds.play(se, aScoreUp);		return;
+			case SoundKind::LEVEL_MUSIC:	olc::SOUND::PlaySample(aLevel, true, SOUND_PRIORITY_MUSIC);	return;
 			case SoundKind::PAC:			v = aPac;   break;
 			case SoundKind::FART:			v = aFart;  break;
 			case SoundKind::YUMMY:			v = aYum;   break;
@@ -590,7 +921,8 @@ namespace pm
 			case SoundKind::GHOST_EAT_ME:	v = aBlbl;  break;
 			default: return;
 			}
-			olc::SOUND::PlaySample(v[rand() % v.size()]);
+			// pick the variant even if the queue drops it, so the rand() sequence doesn't depend on sound rules
+			sounds.play(se, v[rand() % v.size()]);
 		}
 	};
 }
@@ -0,0 +1,148 @@
+#ifndef GOLDEN_H
+#define GOLDEN_H
+
+#include "Game.h"
+
+namespace pm
+{
+	// Visual regression check. Plays every level in both modes from a fixed seed,
+	// grabs the offscreen frame at a few fixed ticks and compares it against the
+	// reference images in a directory. Mismatches leave the actual frame and a
+	// diff image (red = off by more than the tolerance) in "<dir>/failed/".
+	// Missing references are recorded as new ones, --update rewrites all of them
+	class GoldenRunner : public olc::FrameSink
+	{
+		// countdown, early chase, well into the level
+		static inline const std::array<int, 3> CAPTURE_TICKS = { 1, 240, 600 };
+		static const uint32_t SEED = 1;
+
+		Game& game;
+		fs::path dir;
+		bool bUpdate;
+		int nTolerance;
+
+		int nCase;		// level * 2 + mode
+		size_t nCapture;	// index into CAPTURE_TICKS
+		int nTicksDone;
+		bool bCapturing;
+
+	public:
+		int nPassed;
+		int nFailed;
+		int nNew;
+
+		GoldenRunner(Game& game, const std::string& dir, bool bUpdate = false, int nTolerance = 8) :
+			game(game),
+			dir(dir),
+			bUpdate(bUpdate),
+			nTolerance(nTolerance),
+			nCase(-1),
+			nCapture(0),
+			nTicksDone(0),
+			bCapturing(false),
+			nPassed(0),
+			nFailed(0),
+			nNew(0)
+		{}
+
+		bool WriteFrame(const olc::Sprite* frame, uint32_t) override
+		{
+			if (bCapturing)
+			{
+				check(frame);
+				nCapture++;
+			}
+
+			if (nCase < 0 || nCapture == CAPTURE_TICKS.size())
+			{
+				if (++nCase == game.numOfLevels() * 2)
+				{
+					std::cout << "golden: " << nPassed << " passed, " << nFailed << " failed, " << nNew << " new" << std::endl;
+					return false;
+				}
+				seedRandom(SEED);
+				game.startLevel(nCase / 2, nCase % 2 == 0);
+				nCapture = 0;
+				nTicksDone = 0;
+			}
+
+			// the next frame drawn is the captured tick
+			game.fastForward(CAPTURE_TICKS[nCapture] - 1 - nTicksDone);
+			nTicksDone = CAPTURE_TICKS[nCapture];
+			bCapturing = true;
+			return true;
+		}
+
+	private:
+		std::string caseName() const
+		{
+			std::string sTick = std::to_string(CAPTURE_TICKS[nCapture]);
+			sTick.insert(0, 4 - std::min<size_t>(4, sTick.size()), '0');
+			return "level" + std::string(nCase / 2 < 10 ? "0" : "") + std::to_string(nCase / 2)
+				+ (nCase % 2 == 0 ? "_classic" : "_modern") + "_t" + sTick;
+		}
+
+		static bool save(const olc::Sprite* spr, const fs::path& path)
+		{
+			std::ofstream ofs(path.string(), std::ofstream::binary);
+			return ofs.is_open() && olc::SavePNG(spr, ofs) == olc::OK;
+		}
+
+		void check(const olc::Sprite* frame)
+		{
+			std::string name = caseName();
+			fs::path refPath = dir / (name + ".png");
+
+			if (bUpdate || !fs::exists(refPath))
+			{
+				fs::create_directories(dir);
+				save(frame, refPath);
+				std::cout << "NEW  " << name << std::endl;
+				nNew++;
+				return;
+			}
+
+			olc::Sprite ref(refPath.string());
+			olc::Sprite diff(frame->width, frame->height);
+			int nBad = 0;
+			if (ref.width != frame->width || ref.height != frame->height)
+				nBad = frame->width * frame->height;
+			else
+			{
+				for (int y = 0; y < frame->height; y++)
+					for (int x = 0; x < frame->width; x++)
+					{
+						olc::Pixel a = frame->GetPixel(x, y);
+						olc::Pixel b = ref.GetPixel(x, y);
+						int d = std::max({ std::abs(a.r - b.r), std::abs(a.g - b.g), std::abs(a.b - b.b) });
+						if (d > nTolerance)
+						{
+							diff.SetPixel(x, y, olc::RED);
+							nBad++;
+						}
+						else
+						{
+							// faded copy of the frame, so the red stands out but stays readable
+							uint8_t l = uint8_t((a.r + a.g + a.b) / 12);
+							diff.SetPixel(x, y, olc::Pixel(l, l, l));
+						}
+					}
+			}
+
+			if (nBad == 0)
+			{
+				nPassed++;
+				return;
+			}
+
+			fs::path failed = dir / "failed";
+			fs::create_directories(failed);
+			save(frame, failed / (name + "_actual.png"));
+			save(&diff, failed / (name + "_diff.png"));
+			std::cout << "FAIL " << name << " (" << nBad << " pixels)" << std::endl;
+			nFailed++;
+		}
+	};
+}
+
+#endif
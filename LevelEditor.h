@@ -2,13 +2,14 @@
 #define LEVEL_EDITOR_H
 
 #include "olcPixelGameEngine.h"
+#include "Canvas.h"
 #include "Auxiliaries.h"
 
 namespace pm
 {	
 	class LevelEditor
 	{
-		olc::PixelGameEngine& game;
+		Canvas& game;
 		std::vector<olc::Decal*>& decals;
 		olc::vi2d vEditorPos; // in "tile space"
 
@@ -18,7 +19,7 @@ namespace pm
 
 		Level* currLevel;
 	public:
-		LevelEditor(olc::PixelGameEngine& game, std::vector<olc::Decal*>& decals) :
+		LevelEditor(Canvas& game, std::vector<olc::Decal*>& decals) :
 			game(game),
 			decals(decals),
 			vEditorPos({ 10, 0 })
@@ -38,8 +39,8 @@ namespace pm
 			buttons.push_back(new Button(game, tileToScreen(5, 10), "save"));
 			buttons.push_back(new Button(game, tileToScreen(0, 10), "back"));
 
-			selectableTiles.push_back(new RedGhost (game, tileToScreen(0, 3), currLevel->width, currLevel->height, currLevel->board));
-			selectableTiles.push_back(new BlueGhost(game, tileToScreen(2, 3), currLevel->width, currLevel->height, currLevel->board));
+			selectableTiles.push_back(new RedGhost (game, tileToScreen(0, 3), currLevel->width, currLevel->height, currLevel->board, currLevel->paths));
+			selectableTiles.push_back(new BlueGhost(game, tileToScreen(2, 3), currLevel->width, currLevel->height, currLevel->board, currLevel->paths));
 			selectableTiles.push_back(new Dot      (game, tileToScreen(4, 3)));
 			selectableTiles.push_back(new Wall     (game, tileToScreen(0, 5)));
 			selectableTiles.push_back(new PowerUp  (game, tileToScreen(2, 5)));
@@ -68,10 +69,10 @@ namespace pm
 					switch (selectedObject->kind)
 					{
 					case Kind::PLAYER:   currLevel->board.emplace(std::make_pair(pos, new Pacman   (game, tileToScreen(pos), currLevel->width, currLevel->height))); break;
-					case Kind::GHOST_B:  currLevel->board.emplace(std::make_pair(pos, new BlueGhost(game, tileToScreen(pos), currLevel->width, currLevel->height, currLevel->board)));   break;
-					case Kind::GHOST_R:  currLevel->board.emplace(std::make_pair(pos, new RedGhost (game, tileToScreen(pos), currLevel->width, currLevel->height, currLevel->board)));   break;
+					case Kind::GHOST_B:  currLevel->board.emplace(std::make_pair(pos, new BlueGhost(game, tileToScreen(pos), currLevel->width, currLevel->height, currLevel->board, currLevel->paths)));   break;
+					case Kind::GHOST_R:  currLevel->board.emplace(std::make_pair(pos, new RedGhost (game, tileToScreen(pos), currLevel->width, currLevel->height, currLevel->board, currLevel->paths)));   break;
 					case Kind::DOT:      currLevel->board.emplace(std::make_pair(pos, new Dot      (game, tileToScreen(pos)))); break;
-					case Kind::WALL:     currLevel->board.emplace(std::make_pair(pos, new Wall     (game, tileToScreen(pos)))); break;
+					case Kind::WALL:     if (currLevel->board.emplace(std::make_pair(pos, new Wall(game, tileToScreen(pos)))).second) currLevel->paths.setWall(pos, true); break;
 					case Kind::POWER_UP: currLevel->board.emplace(std::make_pair(pos, new PowerUp  (game, tileToScreen(pos)))); break;
 					}
 				}
@@ -84,8 +85,8 @@ namespace pm
 						switch ((*it)->kind)
 						{
 						case Kind::PLAYER:   selectedObject = new Pacman   (game, tileToScreen(pos), currLevel->width, currLevel->height); break;
-						case Kind::GHOST_B:  selectedObject = new BlueGhost(game, tileToScreen(pos), currLevel->width, currLevel->height, currLevel->board); break;
-						case Kind::GHOST_R:  selectedObject = new RedGhost (game, tileToScreen(pos), currLevel->width, currLevel->height, currLevel->board); break;
+						case Kind::GHOST_B:  selectedObject = new BlueGhost(game, tileToScreen(pos), currLevel->width, currLevel->height, currLevel->board, currLevel->paths); break;
+						case Kind::GHOST_R:  selectedObject = new RedGhost (game, tileToScreen(pos), currLevel->width, currLevel->height, currLevel->board, currLevel->paths); break;
 						case Kind::DOT:      selectedObject = new Dot      (game, tileToScreen(pos)); break;
 						case Kind::WALL:     selectedObject = new Wall     (game, tileToScreen(pos)); break;
 						case Kind::POWER_UP: selectedObject = new PowerUp  (game, tileToScreen(pos)); break;
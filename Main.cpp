@@ -1,9 +1,223 @@
 #include "Game.h"
+#include "Golden.h"
+#include "Autoplay.h"
+#include "Difficulty.h"
+#include "EnvironmentServer.h"
+#include "Benchmarks.h"
 
-int main()
+#include <cctype>
+
+#if defined(_WIN32)
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+// Usage:
+//   Pacmanx10                                             - play in a window
+//   Pacmanx10 --offscreen <frames> [--png <prefix>]       - render without a window, dump PNGs
+//   Pacmanx10 --offscreen <frames> [--raw <file|->]       - render without a window, stream raw RGBA
+//   Pacmanx10 --golden <dir> [--update] [--tolerance <n>] - check every level against reference frames
+//   Pacmanx10 --autoplay                                  - let the bot play every level, report which it won
+//   Pacmanx10 --difficulty [<levels file>]                - rate every level by tree search (the shipped ones by default), flag the ones no bot won
+//   Pacmanx10 --serve <name> [--games <n>] [--level <i>] - serve games to agents in other processes through shared memory
+//   Pacmanx10 --connect <name> [<steps>]                 - play random steps on a server, report the throughput, stop it
+//   Pacmanx10 --shm-bench [<steps>] [--games <n>] [--level <i>] - steps/s in process against through shared memory
+//   Pacmanx10 --bench [<json file>]                       - time the hot paths on fixed inputs, optionally as JSON
+//   Pacmanx10 --pack <file>                               - pack everything under Assets into one archive
+//                                                           (the game uses ./Assets.pak when it exists)
+//   add --autopilot [<depth>] to have the bot play instead of the keyboard, looking <depth> (1 to 10) tiles ahead.
+//   add --profile to start with the frame profiler showing (F4 toggles it).
+//   add --trace [<json file>] to record a trace, F5 or SIGUSR1 writes the last seconds of it,
+//                                                           offscreen runs write it when they end
+//   add --mute to run without sound, or --wav <file> to record the sound instead of playing it.
+//   Offscreen, golden and autoplay runs are muted unless --wav is given
+int main(int argc, char* argv[])
 {
-	pm::Game game;
-	if (game.Construct(320, 240, 4, 4))
+	int nOffscreenFrames = -1;
+	std::unique_ptr<olc::FrameSink> sink;
+	std::FILE* rawFile = nullptr;
+	std::string sGoldenDir;
+	bool bGoldenUpdate = false;
+	int nGoldenTolerance = 8;
+	olc::SOUND::Backend audio = olc::SOUND::Backend::DEVICE;
+	std::string sAudioFile;
+	int nAutopilotDepth = 0;
+	bool bAutoplay = false;
+	bool bProfile = false;
+	std::string sTraceFile;
+	bool bBench = false;
+	std::string sBenchFile;
+	bool bDifficulty = false;
+	std::string sDifficultyFile; // empty for the shipped levels
+	std::string sServeName;
+	std::string sConnectName;
+	bool bTransportBench = false;
+	int nSteps = 10000;
+	int nGames = 64;
+	int nLevel = pm::NUM_OF_TUTORIAL_LEVELS;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--offscreen" && i + 1 < argc)
+			nOffscreenFrames = std::stoi(argv[++i]);
+		else if (arg == "--png" && i + 1 < argc)
+			sink = std::make_unique<olc::FrameSink_PNG>(argv[++i]);
+		else if (arg == "--raw" && i + 1 < argc)
+		{
+			std::string path = argv[++i];
+			rawFile = (path == "-") ? stdout : std::fopen(path.c_str(), "wb");
+#if defined(_WIN32)
+			if (rawFile == stdout) _setmode(_fileno(stdout), _O_BINARY);
+#endif
+			sink = std::make_unique<olc::FrameSink_RawRGBA>(rawFile);
+		}
+		else if (arg == "--pack" && i + 1 < argc)
+			return pm::Game::packAssets(argv[++i]) ? 0 : 1;
+		else if (arg == "--golden" && i + 1 < argc)
+			sGoldenDir = argv[++i];
+		else if (arg == "--update")
+			bGoldenUpdate = true;
+		else if (arg == "--tolerance" && i + 1 < argc)
+			nGoldenTolerance = std::stoi(argv[++i]);
+		else if (arg == "--autopilot")
+		{
+			nAutopilotDepth = pm::Autopilot::DEFAULT_DEPTH;
+			if (i + 1 < argc && std::isdigit((unsigned char)argv[i + 1][0]))
+				nAutopilotDepth = std::stoi(argv[++i]);
+			if (nAutopilotDepth < 1 || nAutopilotDepth > pm::Autopilot::MAX_DEPTH)
+			{
+				std::cout << "the autopilot looks 1 to " << pm::Autopilot::MAX_DEPTH << " tiles ahead" << std::endl;
+				return 1;
+			}
+		}
+		else if (arg == "--autoplay")
+			bAutoplay = true;
+		else if (arg == "--difficulty")
+		{
+			bDifficulty = true;
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+				sDifficultyFile = argv[++i];
+		}
+		else if (arg == "--serve" && i + 1 < argc)
+			sServeName = argv[++i];
+		else if ((arg == "--connect" && i + 1 < argc) || arg == "--shm-bench")
+		{
+			if (arg == "--connect")
+				sConnectName = argv[++i];
+			else
+				bTransportBench = true;
+			if (i + 1 < argc && std::isdigit((unsigned char)argv[i + 1][0]))
+				nSteps = std::stoi(argv[++i]);
+		}
+		else if (arg == "--games" && i + 1 < argc)
+			nGames = std::stoi(argv[++i]);
+		else if (arg == "--level" && i + 1 < argc)
+			nLevel = std::stoi(argv[++i]);
+		else if (arg == "--bench")
+		{
+			bBench = true;
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+				sBenchFile = argv[++i];
+		}
+		else if (arg == "--profile")
+			bProfile = true;
+		else if (arg == "--trace")
+			sTraceFile = (i + 1 < argc && argv[i + 1][0] != '-') ? argv[++i] : "Pacmanx10.trace.json";
+		else if (arg == "--mute")
+			audio = olc::SOUND::Backend::NONE;
+		else if (arg == "--wav" && i + 1 < argc)
+		{
+			audio = olc::SOUND::Backend::WAV_FILE;
+			sAudioFile = argv[++i];
+		}
+	}
+
+	if (bDifficulty)
+	{
+		if (sDifficultyFile.empty())
+			return pm::rateLevels(pm::readShippedLevels()) ? 0 : 1;
+		std::ifstream input(sDifficultyFile);
+		if (!input)
+		{
+			std::cout << "can't read " << sDifficultyFile << std::endl;
+			return 1;
+		}
+		return pm::rateLevels(pm::readLevels(input)) ? 0 : 1;
+	}
+
+	if (bBench)
+	{
+		pm::BenchmarkRunner bench(sBenchFile);
+		if (bench.ConstructOffscreen(320, 240, nullptr, 1.0f / 60.0f, 1))
+			bench.Start();
+		return bench.bOk ? 0 : 1;
+	}
+
+	if (!sServeName.empty() || !sConnectName.empty() || bTransportBench)
+	{
+#ifdef __linux__
+		if (!sConnectName.empty())
+			return pm::runClient(sConnectName, nSteps) ? 0 : 1;
+		const std::vector<pm::LevelData> levels = pm::readShippedLevels();
+		if (nLevel < 0 || nLevel >= int(levels.size()))
+		{
+			std::cout << "no level " << nLevel << " in the shipped levels" << std::endl;
+			return 1;
+		}
+		if (bTransportBench)
+			return pm::benchmarkTransport(levels[nLevel], nGames, nSteps) ? 0 : 1;
+		pm::EnvironmentServer server;
+		if (!server.create(sServeName, levels[nLevel], nGames))
+			return 1;
+		std::cout << "serving " << nGames << " games of level " << nLevel << " on " << sServeName << std::endl;
+		server.serve();
+		return 0;
+#else
+		std::cout << "shared memory agents are only supported on linux" << std::endl;
+		return 1;
+#endif
+	}
+
+	if (audio == olc::SOUND::Backend::DEVICE && (nOffscreenFrames >= 0 || !sGoldenDir.empty() || bAutoplay))
+		audio = olc::SOUND::Backend::NONE;
+	olc::SOUND::SetBackend(audio, sAudioFile);
+
+	if (!sGoldenDir.empty())
+	{
+		pm::Game game(false);
+		pm::GoldenRunner golden(game, sGoldenDir, bGoldenUpdate, nGoldenTolerance);
+		if (game.ConstructOffscreen(320, 240, &golden, 1.0f / 60.0f))
+			game.Start();
+		return golden.nFailed == 0 ? 0 : 1;
+	}
+
+	if (bAutoplay)
+	{
+		pm::Game game(false);
+		pm::AutoplayRunner autoplay(game, nAutopilotDepth > 0 ? nAutopilotDepth : pm::Autopilot::DEFAULT_DEPTH);
+		if (game.ConstructOffscreen(320, 240, &autoplay, 1.0f / 60.0f))
+			game.Start();
+		return autoplay.passed() ? 0 : 1;
+	}
+
+	// offscreen runs tick the simulation once per frame on the engine thread so frames are reproducible
+	pm::Game game(nOffscreenFrames < 0);
+	if (nAutopilotDepth > 0)
+		game.setAutopilot(nAutopilotDepth);
+	game.setProfiling(bProfile);
+	if (!sTraceFile.empty())
+		game.setTracing(sTraceFile);
+	if (nOffscreenFrames >= 0)
+	{
+		if (game.ConstructOffscreen(320, 240, sink.get(), 1.0f / 60.0f, nOffscreenFrames))
+			game.Start();
+		game.dumpTrace();
+	}
+	else if (game.Construct(320, 240, 4, 4))
 		game.Start();
+
+	if (rawFile != nullptr && rawFile != stdout)
+		std::fclose(rawFile);
 	return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,733 @@
+#ifndef PATHFINDING_H
+#define PATHFINDING_H
+
+#include "olcPixelGameEngine.h"
+
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <climits>
+#include <functional>
+#include <atomic>
+
+namespace pm
+{
+	// The grid every AI routine walks: tile indices, the four neighbours and distances,
+	// wrapping round the border the way MoveableObject::stepForward does. Indices and
+	// neighbours always wrap, a mover can go over any edge that isn't walled. Distances
+	// only go round on an axis with a way through the border somewhere, the walls tell
+	// (see Pathfinder), otherwise 'shorter' would lead into a wall
+	class Topology
+	{
+		int nWidth;
+		int nHeight;
+		std::vector<olc::vi2d> vTiles; // index to tile, saves dividing
+		bool bWrapsX;
+		bool bWrapsY;
+
+	public:
+		// the four moves, in the order ties between equally short paths are broken
+		static inline const std::array<olc::vi2d, 4> STEPS = { olc::vi2d(-1, 0), olc::vi2d(1, 0), olc::vi2d(0, -1), olc::vi2d(0, 1) };
+		enum { LEFT = 0, RIGHT, UP, DOWN };
+
+		Topology(const int width, const int height) :
+			nWidth(0),
+			nHeight(0),
+			bWrapsX(false),
+			bWrapsY(false)
+		{
+			resize(width, height);
+		}
+		void resize(const int width, const int height)
+		{
+			nWidth = std::max(width, 1);
+			nHeight = std::max(height, 1);
+			vTiles.resize(nWidth * nHeight);
+			for (int n = 0; n < int(vTiles.size()); n++)
+				vTiles[n] = { n % nWidth, n / nWidth };
+		}
+		void setWraps(const bool bX, const bool bY) { bWrapsX = bX; bWrapsY = bY; }
+
+		int width() const { return nWidth; }
+		int height() const { return nHeight; }
+		int tiles() const { return nWidth * nHeight; }
+
+		// any tile, outside the level too (one past the edge while wrapping round, say)
+		int index(const olc::vi2d& tile) const
+		{
+			int x = tile.x % nWidth;
+			int y = tile.y % nHeight;
+			if (x < 0) x += nWidth;
+			if (y < 0) y += nHeight;
+			return y * nWidth + x;
+		}
+		const olc::vi2d& tile(const int n) const { return vTiles[n]; }
+		int neighbour(const int n, const int step) const
+		{
+			const olc::vi2d& t = vTiles[n];
+			switch (step)
+			{
+			case LEFT:  return t.x == 0 ? n + nWidth - 1 : n - 1;
+			case RIGHT: return t.x + 1 == nWidth ? n - t.x : n + 1;
+			case UP:    return t.y == 0 ? n + (nHeight - 1) * nWidth : n - nWidth;
+			default:    return t.y + 1 == nHeight ? t.x : n + nWidth;
+			}
+		}
+
+		// The shortest way from one tile to another, ignoring walls: round the other side
+		// on an axis that wraps when that's shorter. Ties go the way the raw difference points
+		olc::vi2d offset(const olc::vi2d& from, const olc::vi2d& to) const
+		{
+			const olc::vi2d& a = vTiles[index(from)];
+			const olc::vi2d& b = vTiles[index(to)];
+			return { shorter(b.x - a.x, nWidth, bWrapsX), shorter(b.y - a.y, nHeight, bWrapsY) };
+		}
+		// Manhattan, going round where offset() does
+		int distance(const int a, const int b) const
+		{
+			return std::abs(shorter(vTiles[b].x - vTiles[a].x, nWidth, bWrapsX)) + std::abs(shorter(vTiles[b].y - vTiles[a].y, nHeight, bWrapsY));
+		}
+
+	private:
+		static int shorter(const int d, const int nSize, const bool bWraps)
+		{
+			if (!bWraps) return d;
+			if (d * 2 > nSize) return d - nSize;
+			if (d * 2 < -nSize) return d + nSize;
+			return d;
+		}
+	};
+
+	// Shortest paths over a level's tiles, on its Topology, so paths may run
+	// through the border.
+	// Searches reuse scratch buffers, so one Pathfinder serves one thread at a time
+	class Pathfinder
+	{
+	public:
+		enum class Method {
+			FLOOD, // breadth first from the target, cheapest on small levels and in mazes
+			ASTAR, // A* with a wrap-aware Manhattan heuristic, for big levels with room to move
+			JPS    // jump point search, for big open levels that wrap round
+		};
+
+		static inline const std::array<olc::vi2d, 4>& STEPS = Topology::STEPS;
+
+		// levels up to this many tiles are flooded, a search has more overhead than it saves there
+		static const int SMALL_LEVEL_TILES = 32 * 32;
+		// targets tracked at once, the one asked for longest ago makes room
+		static const int MAX_TRACKED = 8;
+
+	private:
+		enum { LEFT = Topology::LEFT, RIGHT = Topology::RIGHT, UP = Topology::UP, DOWN = Topology::DOWN };
+
+		struct OpenNode
+		{
+			int f;
+			int g;
+			int n; // tile for A*, tile * 4 + direction for JPS
+		};
+
+		static inline const int UNREACHABLE = INT_MAX / 2; // still fine to add one to
+
+		// Distances to one target from every tile, kept by LPA* without a start: g is the
+		// distance as last settled, rhs what the neighbours say it should be. Tiles where
+		// the two differ wait in vQueue, keyed by the smaller
+		struct Field
+		{
+			olc::vi2d target;
+			int nTarget;
+			std::vector<int> vG;
+			std::vector<int> vRhs;
+			std::vector<std::pair<int, int>> vQueue; // (key, tile), a min-heap
+			uint32_t nUsed;
+		};
+
+		Topology grid;
+		int nWidth;
+		int nHeight;
+		int nWalls;
+		std::vector<uint8_t> vWalls;
+		int nWrapRows;  // rows open at both ends, paths can go round sideways
+		int nWrapColumns;
+		bool bPicked;    // pickMethod() is still up to date
+		Method picked;
+		uint32_t nVersion;
+		static inline std::atomic<uint32_t> nLastVersion = { 0 }; // shared, so two Pathfinders never agree by chance
+
+		// a bit per step that leads somewhere open, per tile, kept up to date with the walls
+		std::vector<uint8_t> vExits;
+
+		std::vector<Field> vFields;
+		uint32_t nFieldClock;
+
+		// scratch, per tile (A*, flood) or per tile and direction (JPS)
+		std::vector<int> vG;
+		std::vector<uint8_t> vFirst;
+		std::vector<uint32_t> vOpened;
+		std::vector<uint32_t> vClosed;
+		uint32_t nSearch;
+		std::vector<OpenNode> vHeap;
+		std::vector<int> vQueue;
+
+	public:
+		Pathfinder(const int width, const int height) :
+			grid(width, height),
+			nWidth(0),
+			nHeight(0),
+			nWalls(0),
+			nWrapRows(0),
+			nWrapColumns(0),
+			bPicked(false),
+			picked(Method::FLOOD),
+			nVersion(0),
+			nFieldClock(0),
+			nSearch(0)
+		{
+			resize(width, height);
+		}
+
+		// keeps the walls that are still inside
+		void resize(const int width, const int height)
+		{
+			const int nNewWidth = std::max(width, 1);
+			const int nNewHeight = std::max(height, 1);
+			std::vector<uint8_t> vOld = std::move(vWalls);
+			vWalls.assign(nNewWidth * nNewHeight, 0);
+			nWalls = 0;
+			for (int y = 0; y < std::min(nNewHeight, nHeight); y++)
+				for (int x = 0; x < std::min(nNewWidth, nWidth); x++)
+					nWalls += vWalls[y * nNewWidth + x] = vOld[y * nWidth + x];
+			nWidth = nNewWidth;
+			nHeight = nNewHeight;
+
+			grid.resize(nWidth, nHeight);
+			nWrapRows = nWrapColumns = 0;
+			for (int y = 0; y < nHeight; y++) nWrapRows += wrapsRow(y);
+			for (int x = 0; x < nWidth; x++) nWrapColumns += wrapsColumn(x);
+			grid.setWraps(nWrapRows > 0, nWrapColumns > 0);
+			bPicked = false;
+			nVersion = ++nLastVersion;
+
+			vExits.resize(vWalls.size());
+			for (int n = 0; n < int(vExits.size()); n++)
+				updateExits(n);
+
+			// the tiles have all moved, so tracked targets start over
+			vFields.erase(std::remove_if(vFields.begin(), vFields.end(), [&](const Field& f) {
+				return f.target.x >= nWidth || f.target.y >= nHeight; }), vFields.end());
+			for (Field& f : vFields)
+				resetField(f);
+
+			resizeScratch();
+		}
+
+		// Takes other's walls over for searching, without its tracked targets or scratch.
+		// Scratch is only made again when the size changes, so keeping a copy current is cheap
+		void copyWalls(const Pathfinder& other)
+		{
+			const bool bResized = vWalls.size() != other.vWalls.size();
+			grid = other.grid;
+			nWidth = other.nWidth;
+			nHeight = other.nHeight;
+			nWalls = other.nWalls;
+			vWalls = other.vWalls;
+			nWrapRows = other.nWrapRows;
+			nWrapColumns = other.nWrapColumns;
+			bPicked = other.bPicked;
+			picked = other.picked;
+			nVersion = other.nVersion;
+			vExits = other.vExits;
+			vFields.clear();
+			if (bResized)
+				resizeScratch();
+		}
+
+		// tiles outside the level are ignored
+		void setWall(const olc::vi2d& tile, const bool bWall)
+		{
+			if (tile.x < 0 || tile.x >= nWidth || tile.y < 0 || tile.y >= nHeight)
+				return;
+			uint8_t& w = vWalls[tile.y * nWidth + tile.x];
+			nWrapRows -= wrapsRow(tile.y);
+			nWrapColumns -= wrapsColumn(tile.x);
+			nWalls += int(bWall) - int(w);
+			w = bWall;
+			nWrapRows += wrapsRow(tile.y);
+			nWrapColumns += wrapsColumn(tile.x);
+			grid.setWraps(nWrapRows > 0, nWrapColumns > 0);
+			bPicked = false;
+			nVersion = ++nLastVersion;
+
+			const int n = tile.y * nWidth + tile.x;
+			updateExits(n);
+			for (int s = 0; s < 4; s++)
+				updateExits(neighbour(n, s));
+
+			// only queued here, repaired the next time the field is asked
+			for (Field& f : vFields)
+			{
+				touch(f, n);
+				for (int s = 0; s < 4; s++)
+					touch(f, neighbour(n, s));
+			}
+		}
+		bool isWall(const olc::vi2d& tile) const { return vWalls[wrap(tile)] != 0; }
+		bool isWall(const int n) const { return vWalls[n] != 0; } // by topology() index
+		int tiles() const { return nWidth * nHeight; }
+		// the grid the paths run on, with this level's walls deciding where it wraps
+		const Topology& topology() const { return grid; }
+		// changes with every wall edit or resize, a copy with the same version has the same walls
+		uint32_t version() const { return nVersion; }
+
+		// Small levels and mazes are flooded, in a maze the A* guess is no help and only
+		// costs. Big open levels are searched, by jumping if most rows and columns wrap
+		// round (jumps elsewhere mostly run into the border and stop)
+		Method pickMethod()
+		{
+			if (bPicked)
+				return picked;
+			const int nTiles = nWidth * nHeight;
+			int nCorridors = 0;
+			for (int n = 0; n < nTiles; n++)
+				if (isOpen(n))
+				{
+					int nExits = 0;
+					for (int s = 0; s < 4; s++)
+						nExits += isOpen(neighbour(n, s));
+					nCorridors += nExits <= 2;
+				}
+
+			if (nTiles <= SMALL_LEVEL_TILES || nCorridors * 2 >= nTiles - nWalls)
+				picked = Method::FLOOD;
+			else if (nWalls * 8 < nTiles && nWrapRows * 2 > nHeight && nWrapColumns * 2 > nWidth)
+				picked = Method::JPS;
+			else
+				picked = Method::ASTAR;
+			bPicked = true;
+			return picked;
+		}
+
+#pragma region Junctions
+		// three or more ways out, the only tiles where there is anything to decide
+		bool isJunction(const olc::vi2d& tile) const
+		{
+			const uint8_t e = vExits[wrap(tile)];
+			return ((e & 1) + (e >> 1 & 1) + (e >> 2 & 1) + (e >> 3 & 1)) >= 3;
+		}
+		// The step to carry on with through a tile entered moving 'step': straight on if
+		// it can, round the corner if not, back out of a dead end
+		int followCorridor(const olc::vi2d& tile, const int step) const
+		{
+			const uint8_t e = vExits[wrap(tile)];
+			if (e & (1 << step))
+				return step;
+			const uint8_t other = e & ~(1 << (step ^ 1));
+			for (int s = 0; s < 4; s++)
+				if (other & (1 << s))
+					return s;
+			return step ^ 1;
+		}
+#pragma endregion
+
+#pragma region Tracked targets
+		// Keeps distances to 'target' from every tile from now on. A wall change only repairs
+		// the tiles whose distance it changes, so targets that stay put (a ghost's way home)
+		// cost one flood up front and then next to nothing per edit and per question
+		void track(const olc::vi2d& target)
+		{
+			if (target.x < 0 || target.x >= nWidth || target.y < 0 || target.y >= nHeight || findField(wrap(target)))
+				return;
+			if (int(vFields.size()) >= MAX_TRACKED)
+				vFields.erase(std::min_element(vFields.begin(), vFields.end(), [](const Field& a, const Field& b) { return a.nUsed < b.nUsed; }));
+			vFields.push_back({ target, wrap(target), {}, {}, {}, ++nFieldClock });
+			resetField(vFields.back());
+		}
+		bool isTracked(const olc::vi2d& target) const
+		{
+			const int n = wrap(target);
+			return std::any_of(vFields.begin(), vFields.end(), [n](const Field& f) { return f.nTarget == n; });
+		}
+		void untrack(const olc::vi2d& target)
+		{
+			vFields.erase(std::remove_if(vFields.begin(), vFields.end(), [&](const Field& f) { return f.target == target; }), vFields.end());
+		}
+#pragma endregion
+
+		// Index into STEPS of the first move from 'from' along a shortest path to 'to'.
+		// Of several shortest paths, the first move in STEPS order wins, whatever the method.
+		// -1 when already there or there is no way there. Tracked targets are answered
+		// from their distances, without searching
+		int firstStep(const olc::vi2d& from, const olc::vi2d& to)
+		{
+			Field* pField = findField(wrap(to));
+			if (pField == nullptr)
+				return firstStep(from, to, pickMethod());
+			const int a = wrap(from);
+			if (a == pField->nTarget || !isOpen(a))
+				return -1;
+			repair(*pField);
+			if (pField->vG[a] >= UNREACHABLE)
+				return -1;
+			for (int s = 0; s < 4; s++)
+			{
+				const int m = neighbour(a, s);
+				if (isOpen(m) && pField->vG[m] == pField->vG[a] - 1)
+					return s;
+			}
+			return -1;
+		}
+		int firstStep(const olc::vi2d& from, const olc::vi2d& to, const Method method)
+		{
+			const int a = wrap(from);
+			const int b = wrap(to);
+			if (a == b || !isOpen(a) || !isOpen(b))
+				return -1;
+			switch (method)
+			{
+			case Method::FLOOD: flood(b, a); return pickStep(a);
+			case Method::ASTAR: return aStarStep(b, a);
+			case Method::JPS:   return jumpStep(a, b);
+			}
+			return -1;
+		}
+
+		// number of moves, -1 if there is no way there
+		int distance(const olc::vi2d& from, const olc::vi2d& to, const Method method = Method::ASTAR)
+		{
+			const int a = wrap(from);
+			const int b = wrap(to);
+			if (!isOpen(a) || !isOpen(b))
+				return -1;
+			if (a == b)
+				return 0;
+			switch (method)
+			{
+			case Method::FLOOD: flood(b, a); break;
+			case Method::ASTAR: aStar(b, a); break;
+			case Method::JPS:   return jump(a, b, nullptr);
+			}
+			return isClosed(a) ? vG[a] : -1;
+		}
+
+	private:
+		void resizeScratch()
+		{
+			const size_t nStates = vWalls.size() * 4;
+			vG.assign(nStates, 0);
+			vFirst.assign(nStates, 0);
+			vOpened.assign(nStates, 0);
+			vClosed.assign(nStates, 0);
+			nSearch = 0;
+		}
+		int wrap(const olc::vi2d& tile) const { return grid.index(tile); }
+		int neighbour(const int n, const int step) const { return grid.neighbour(n, step); }
+		bool isOpen(const int n) const { return vWalls[n] == 0; }
+		void updateExits(const int n)
+		{
+			uint8_t e = 0;
+			if (isOpen(n))
+				for (int s = 0; s < 4; s++)
+					e |= uint8_t(isOpen(neighbour(n, s))) << s;
+			vExits[n] = e;
+		}
+
+		bool wrapsRow(const int y) const { return isOpen(y * nWidth) && isOpen(y * nWidth + nWidth - 1); }
+		bool wrapsColumn(const int x) const { return isOpen(x) && isOpen((nHeight - 1) * nWidth + x); }
+		// Manhattan distance. Going round the other way only counts on an axis that has a
+		// way through the border at all, otherwise walled levels get a needlessly weak guess
+		int heuristic(const int a, const int b) const { return grid.distance(a, b); }
+
+		void newSearch()
+		{
+			if (++nSearch == 0)
+			{
+				std::fill(vOpened.begin(), vOpened.end(), 0);
+				std::fill(vClosed.begin(), vClosed.end(), 0);
+				nSearch = 1;
+			}
+			vHeap.clear();
+		}
+		bool isOpened(const int n) const { return vOpened[n] == nSearch; }
+		bool isClosed(const int n) const { return vClosed[n] == nSearch; }
+		void push(const int n, const int g, const int h)
+		{
+			vG[n] = g;
+			vOpened[n] = nSearch;
+			vHeap.push_back({ g + h, g, n });
+			std::push_heap(vHeap.begin(), vHeap.end(), heapOrder);
+		}
+		OpenNode pop()
+		{
+			std::pop_heap(vHeap.begin(), vHeap.end(), heapOrder);
+			OpenNode node = vHeap.back();
+			vHeap.pop_back();
+			return node;
+		}
+		// lowest f first, the deepest of those first
+		static bool heapOrder(const OpenNode& a, const OpenNode& b) { return a.f > b.f || (a.f == b.f && a.g < b.g); }
+
+		// Of the moves out of 'from', the first in STEPS order onto a tile one closer.
+		// Needs every tile next to 'from' settled by the flood
+		int pickStep(const int from) const
+		{
+			if (!isClosed(from))
+				return -1;
+			for (int s = 0; s < 4; s++)
+			{
+				const int m = neighbour(from, s);
+				if (isClosed(m) && vG[m] == vG[from] - 1)
+					return s;
+			}
+			return -1;
+		}
+
+		// Breadth first out of 'target' until 'start' comes up, by then every
+		// tile closer than it is settled
+		void flood(const int target, const int start)
+		{
+			newSearch();
+			vQueue.clear();
+			vG[target] = 0;
+			vClosed[target] = nSearch;
+			vQueue.push_back(target);
+			for (size_t i = 0; i < vQueue.size(); i++)
+			{
+				const int n = vQueue[i];
+				if (n == start)
+					return;
+				for (int s = 0; s < 4; s++)
+				{
+					const int m = neighbour(n, s);
+					if (isOpen(m) && !isClosed(m))
+					{
+						vG[m] = vG[n] + 1;
+						vClosed[m] = nSearch;
+						vQueue.push_back(m);
+					}
+				}
+			}
+		}
+
+		// A* out of 'target' until 'start' is settled. A neighbour of 'start' with a g of one
+		// less is known to be on a shortest path, settled or not, so the search only runs
+		// on for neighbours coming earlier in STEPS order that aren't decided yet
+		int aStarStep(const int target, const int start)
+		{
+			aStar(target, start);
+			if (!isClosed(start))
+				return -1;
+
+			const int nDistance = vG[start];
+			for (int s = 0; s < 4; s++)
+			{
+				const int m = neighbour(start, s);
+				if (!isOpen(m))
+					continue;
+				while (!(isOpened(m) && vG[m] == nDistance - 1) && !vHeap.empty() && vHeap.front().f <= nDistance)
+					expandNext(start);
+				if (isOpened(m) && vG[m] == nDistance - 1)
+					return s;
+			}
+			return -1;
+		}
+		void aStar(const int target, const int start)
+		{
+			newSearch();
+			push(target, 0, heuristic(target, start));
+			while (!isClosed(start) && expandNext(start)) {}
+		}
+		// pops one node, false once there is nothing left
+		bool expandNext(const int start)
+		{
+			while (!vHeap.empty())
+			{
+				const OpenNode node = pop();
+				if (isClosed(node.n) || node.g != vG[node.n])
+					continue;
+				vClosed[node.n] = nSearch;
+				for (int s = 0; s < 4; s++)
+				{
+					const int m = neighbour(node.n, s);
+					if (isOpen(m) && !isClosed(m) && (!isOpened(m) || node.g + 1 < vG[m]))
+						push(m, node.g + 1, heuristic(m, start));
+				}
+				return true;
+			}
+			return false;
+		}
+
+#pragma region Tracked targets
+		Field* findField(const int n)
+		{
+			for (Field& f : vFields)
+				if (f.nTarget == n)
+				{
+					f.nUsed = ++nFieldClock;
+					return &f;
+				}
+			return nullptr;
+		}
+		void resetField(Field& f)
+		{
+			f.nTarget = wrap(f.target);
+			f.vG.assign(vWalls.size(), UNREACHABLE);
+			f.vRhs.assign(vWalls.size(), UNREACHABLE);
+			f.vQueue.clear();
+			touch(f, f.nTarget);
+		}
+		// works out rhs again, and queues the tile if it no longer agrees with g
+		void touch(Field& f, const int n)
+		{
+			int rhs = UNREACHABLE;
+			if (isOpen(n))
+			{
+				if (n == f.nTarget)
+					rhs = 0;
+				else
+					for (int s = 0; s < 4; s++)
+					{
+						const int m = neighbour(n, s);
+						if (isOpen(m))
+							rhs = std::min(rhs, f.vG[m] + 1);
+					}
+			}
+			f.vRhs[n] = rhs;
+			if (f.vG[n] != rhs)
+			{
+				f.vQueue.push_back({ std::min(f.vG[n], rhs), n });
+				std::push_heap(f.vQueue.begin(), f.vQueue.end(), std::greater<>());
+			}
+		}
+		// Settles the queue. A tile that got closer passes that on; one that got further
+		// is forgotten and worked out again from its neighbours. Tiles whose distance the
+		// change didn't touch never come up. Old queue entries are skipped
+		void repair(Field& f)
+		{
+			while (!f.vQueue.empty())
+			{
+				std::pop_heap(f.vQueue.begin(), f.vQueue.end(), std::greater<>());
+				const auto [key, n] = f.vQueue.back();
+				f.vQueue.pop_back();
+				if (f.vG[n] == f.vRhs[n] || key != std::min(f.vG[n], f.vRhs[n]))
+					continue;
+				if (f.vG[n] > f.vRhs[n])
+					f.vG[n] = f.vRhs[n];
+				else
+				{
+					f.vG[n] = UNREACHABLE;
+					touch(f, n);
+				}
+				for (int s = 0; s < 4; s++)
+					touch(f, neighbour(n, s));
+			}
+		}
+#pragma endregion
+
+#pragma region Jump point search
+		// Four-connected jumping. Vertical runs go on until a tile opens left or right where
+		// the tile behind did not; horizontal runs stop wherever a vertical run would find
+		// something. Every shortest path has a twin that turns only at such tiles, and turns
+		// sideways as early as it can, which is also the move ties are broken towards.
+		// Nodes are (tile, direction moved in), the same tile reached both ways expands differently
+		static bool isVertical(const int step) { return step >= UP; }
+
+		// the tile opens sideways (left or right) where the one behind it did not
+		bool isForced(const int n, const int step, const int side) const
+		{
+			return isOpen(neighbour(n, side)) && !isOpen(neighbour(neighbour(n, step ^ 1), side));
+		}
+		// returns the tile jumped to and how many moves away it is, -1 if the run leads nowhere
+		int jumpVertical(int n, const int step, const int goal, int& nSteps) const
+		{
+			for (nSteps = 1; nSteps <= nHeight; nSteps++)
+			{
+				n = neighbour(n, step);
+				if (!isOpen(n)) return -1;
+				if (n == goal || isForced(n, step, LEFT) || isForced(n, step, RIGHT)) return n;
+			}
+			return -1; // all the way round
+		}
+		int jumpHorizontal(int n, const int step, const int goal, int& nSteps) const
+		{
+			int nIgnored;
+			for (nSteps = 1; nSteps <= nWidth; nSteps++)
+			{
+				n = neighbour(n, step);
+				if (!isOpen(n)) return -1;
+				if (n == goal || jumpVertical(n, UP, goal, nIgnored) >= 0 || jumpVertical(n, DOWN, goal, nIgnored) >= 0)
+					return n;
+			}
+			return -1;
+		}
+
+		// distance from 'start' to 'goal', and the first move of the path found.
+		// Gives up on paths longer than nLimit
+		int jump(const int start, const int goal, int* pFirst, const int nLimit = INT_MAX)
+		{
+			newSearch();
+			auto relax = [&](const int from, const int step, const int g, const int first) {
+				int nSteps = 0;
+				const int j = isVertical(step) ? jumpVertical(from, step, goal, nSteps) : jumpHorizontal(from, step, goal, nSteps);
+				if (j < 0) return;
+				const int state = j * 4 + step;
+				if (!isClosed(state) && (!isOpened(state) || g + nSteps < vG[state]))
+				{
+					vFirst[state] = uint8_t(first);
+					push(state, g + nSteps, heuristic(j, goal));
+				}
+			};
+			for (int s = 0; s < 4; s++)
+				relax(start, s, 0, s);
+
+			while (!vHeap.empty())
+			{
+				const OpenNode node = pop();
+				if (node.f > nLimit)
+					break;
+				if (isClosed(node.n) || node.g != vG[node.n])
+					continue;
+				vClosed[node.n] = nSearch;
+				const int n = node.n / 4;
+				const int step = node.n % 4;
+				if (n == goal)
+				{
+					if (pFirst) *pFirst = vFirst[node.n];
+					return node.g;
+				}
+
+				relax(n, step, node.g, vFirst[node.n]);
+				if (!isVertical(step))
+				{
+					relax(n, UP, node.g, vFirst[node.n]);
+					relax(n, DOWN, node.g, vFirst[node.n]);
+				}
+				else
+				{
+					if (isForced(n, step, LEFT))  relax(n, LEFT, node.g, vFirst[node.n]);
+					if (isForced(n, step, RIGHT)) relax(n, RIGHT, node.g, vFirst[node.n]);
+				}
+			}
+			return -1;
+		}
+
+		// Jumping only settles jump points, so ties are settled by asking again from each
+		// neighbour that comes before the found path's first move
+		int jumpStep(const int from, const int to)
+		{
+			int nFirst = -1;
+			const int nDistance = jump(from, to, &nFirst);
+			if (nDistance <= 0)
+				return -1;
+			for (int s = 0; s < nFirst; s++)
+			{
+				const int m = neighbour(from, s);
+				if (isOpen(m) && (m == to ? 0 : jump(m, to, nullptr, nDistance - 1)) == nDistance - 1)
+					return s;
+			}
+			return nFirst;
+		}
+#pragma endregion
+	};
+}
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef SOUND_QUEUE_H
+#define SOUND_QUEUE_H
+
+#include "olcPixelGameEngine.h"
+#include "olcPGEX_Sound.h"
+#include "Auxiliaries.h"
+
+namespace pm
+{
+	// What a kind does when it is triggered while still playing
+	enum class Retrigger {
+		OVERLAP, // play alongside, stealing the oldest once nMaxInstances are playing
+		RESTART, // cut the playing ones off and start over
+		IGNORE   // keep the playing one, drop the new trigger
+	};
+
+	struct SoundRule
+	{
+		int nPriority;
+		float fCooldown;	// minimum seconds between two triggers
+		int nMaxInstances;	// of this kind at once
+		Retrigger retrigger;
+		float fVolume;
+	};
+
+	// Every sound effect goes through here rather than straight to olc::SOUND, so
+	// dot chains and ghost pile-ups can't stack up dozens of overlapping voices.
+	// Runs on simulation time, so the same game always makes the same sounds
+	class SoundQueue
+	{
+		struct Instance
+		{
+			int id;
+			float fEndTime;
+		};
+		struct KindState
+		{
+			float fLastTrigger = -1.0f;
+			std::vector<Instance> playing; // oldest first
+		};
+
+		std::array<SoundRule, size_t(SoundKind::COUNT)> rules;
+		std::array<KindState, size_t(SoundKind::COUNT)> states;
+		float fTime;
+
+	public:
+		SoundQueue() : fTime(0.0f)
+		{
+			rules.fill({ 0, 0.0f, 1, Retrigger::OVERLAP, 1.0f });
+		}
+
+		void setRule(SoundKind kind, const SoundRule& rule) { rules[size_t(kind)] = rule; }
+
+		void update(float fElapsedTime)
+		{
+			fTime += fElapsedTime;
+			for (auto& state : states)
+				state.playing.erase(std::remove_if(state.playing.begin(), state.playing.end(), [&](const Instance& i) { return i.fEndTime <= fTime; }), state.playing.end());
+		}
+
+		// returns false if the rules dropped it
+		bool play(SoundKind kind, int id, bool bLoop = false)
+		{
+			const SoundRule& rule = rules[size_t(kind)];
+			KindState& state = states[size_t(kind)];
+
+			if (state.fLastTrigger >= 0.0f && fTime - state.fLastTrigger < rule.fCooldown)
+				return false;
+
+			if (!state.playing.empty())
+			{
+				switch (rule.retrigger)
+				{
+				case Retrigger::IGNORE:
+					return false;
+				case Retrigger::RESTART:
+					for (auto& i : state.playing)
+						olc::SOUND::StopSample(i.id);
+					state.playing.clear();
+					break;
+				case Retrigger::OVERLAP:
+					if (int(state.playing.size()) >= rule.nMaxInstances)
+					{
+						olc::SOUND::StopSample(state.playing.front().id);
+						state.playing.erase(state.playing.begin());
+					}
+					break;
+				}
+			}
+
+			olc::SOUND::PlaySample(id, bLoop, rule.nPriority, rule.fVolume);
+			state.playing.push_back({ id, bLoop ? std::numeric_limits<float>::infinity() : fTime + olc::SOUND::GetSampleDuration(id) });
+			state.fLastTrigger = fTime;
+			return true;
+		}
+
+		void stopAll()
+		{
+			olc::SOUND::StopAll();
+			for (auto& state : states)
+				state.playing.clear();
+		}
+	};
+}
+
+#endif
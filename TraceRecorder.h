@@ -0,0 +1,338 @@
+#ifndef TRACE_RECORDER_H
+#define TRACE_RECORDER_H
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+#ifdef __linux__
+#include <csignal>
+#endif
+
+namespace pm
+{
+	// Timeline of what each thread was doing, written out as Chrome trace JSON (open it in
+	// Perfetto or chrome://tracing) when asked - F5, SIGUSR1 on linux, or the end of an
+	// offscreen run. Every thread records into a ring of its own and the oldest events make
+	// room for new ones; a dump only keeps the last WINDOW seconds. Rings are made up front,
+	// by nameThread() as a thread starts and track() before anything records into one, after
+	// that recording never takes a lock or allocates, not even on the audio thread. Tracing
+	// is off until enable(), and then cheap enough to leave on
+	class TraceRecorder
+	{
+	public:
+		static const int CAPACITY = 8192; // events kept per thread
+		static const int DETAIL = 32;     // characters kept of a free form detail, e.g. a file name
+		static inline const float WINDOW = 10.0f;
+
+		struct Event
+		{
+			const char* sName;     // string literals only, never copied
+			const char* sCategory;
+			char sDetail[DETAIL];
+			int64_t nStart;        // steady clock nanoseconds
+			int64_t nDuration;     // -1 for an instant
+			const char* sKeys[2];
+			int nArgs[2];
+			int nArgCount;
+		};
+
+		// A track on the timeline. Threads get one each the first time they record, the
+		// audio mix has a named one of its own whichever thread it runs on. Only one thread
+		// records into a ring at a time, a dump reads it alongside: each slot is a seqlock,
+		// its sequence odd while the event in it is being written over, and a dump drops an
+		// event whose sequence wasn't the same even number either side of reading it
+		class Ring
+		{
+			friend class TraceRecorder;
+
+			struct Slot
+			{
+				static const int WORDS = (sizeof(Event) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+				std::atomic<uint32_t> nSequence = { 0 }; // 0 until the first event
+				std::atomic<uint64_t> nWords[WORDS] = {}; // the event, atomics so reading a torn one isn't a race
+			};
+
+			std::unique_ptr<Slot[]> pSlots;
+			uint64_t nWritten = 0; // only the recording thread reads it
+			std::string sName; // under muxRings
+			int nId;
+
+			// false if the slot is empty or was written over while it was read
+			bool read(const Slot& slot, Event& event) const
+			{
+				const uint32_t nSequence = slot.nSequence.load(std::memory_order_acquire);
+				if (nSequence == 0 || nSequence % 2 == 1)
+					return false;
+				uint64_t nWords[Slot::WORDS];
+				for (int i = 0; i < Slot::WORDS; i++)
+					nWords[i] = slot.nWords[i].load(std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (slot.nSequence.load(std::memory_order_relaxed) != nSequence)
+					return false;
+				std::memcpy(&event, nWords, sizeof(Event));
+				return true;
+			}
+
+		public:
+			Ring(std::string sName, const int nId) : pSlots(new Slot[CAPACITY]), sName(std::move(sName)), nId(nId) {}
+
+			void record(const Event& event)
+			{
+				Slot& slot = pSlots[nWritten++ % CAPACITY];
+				const uint32_t nSequence = slot.nSequence.load(std::memory_order_relaxed);
+				slot.nSequence.store(nSequence + 1, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_release);
+				uint64_t nWords[Slot::WORDS] = {};
+				std::memcpy(nWords, &event, sizeof(Event));
+				for (int i = 0; i < Slot::WORDS; i++)
+					slot.nWords[i].store(nWords[i], std::memory_order_relaxed);
+				slot.nSequence.store(nSequence + 2, std::memory_order_release);
+			}
+		};
+
+		// times from here to the end of the scope
+		class Scope
+		{
+			Event event;
+			bool bOn;
+
+		public:
+			Scope(const char* sName, const char* sCategory, const char* sDetail = nullptr) :
+				bOn(isEnabled())
+			{
+				if (!bOn) return;
+				event = makeEvent(sName, sCategory, sDetail);
+				event.nStart = now();
+			}
+			Scope(const Scope&) = delete;
+			Scope& operator=(const Scope&) = delete;
+			~Scope()
+			{
+				if (!bOn) return;
+				event.nDuration = now() - event.nStart;
+				thisThread().record(event);
+			}
+
+			Scope& arg(const char* sKey, const int n)
+			{
+				if (bOn) addArg(event, sKey, n);
+				return *this;
+			}
+		};
+
+	private:
+		static inline std::atomic<bool> bEnabled = { false };
+		static inline std::atomic<bool> bDumpRequested = { false };
+		static inline std::mutex muxRings;
+		static inline std::vector<std::unique_ptr<Ring>> vRings;
+
+		static Event makeEvent(const char* sName, const char* sCategory, const char* sDetail)
+		{
+			Event event;
+			event.sName = sName;
+			event.sCategory = sCategory;
+			event.sDetail[0] = '\0';
+			if (sDetail)
+			{
+				// the end of a long one is kept, that's where a file's name is
+				const size_t nLength = std::strlen(sDetail);
+				std::strcpy(event.sDetail, sDetail + (nLength < DETAIL ? 0 : nLength - (DETAIL - 1)));
+			}
+			event.nStart = 0;
+			event.nDuration = -1;
+			event.nArgCount = 0;
+			return event;
+		}
+		static void addArg(Event& event, const char* sKey, const int n)
+		{
+			if (event.nArgCount == 2) return;
+			event.sKeys[event.nArgCount] = sKey;
+			event.nArgs[event.nArgCount++] = n;
+		}
+
+		static Ring* addRing(const std::string& sName)
+		{
+			std::lock_guard<std::mutex> lock(muxRings);
+			vRings.emplace_back(new Ring(sName, int(vRings.size()) + 1));
+			return vRings.back().get();
+		}
+
+#ifdef __linux__
+		static void onSignal(int) { bDumpRequested.store(true, std::memory_order_relaxed); }
+#endif
+
+		static void writeString(std::ostream& out, const char* s)
+		{
+			out << '"';
+			for (; *s; s++)
+			{
+				if (*s == '"' || *s == '\\')
+					out << '\\' << *s;
+				else if ((unsigned char)*s < 0x20)
+					out << ' ';
+				else
+					out << *s;
+			}
+			out << '"';
+		}
+
+	public:
+		static void enable(const bool bEnable)
+		{
+#ifdef __linux__
+			if (bEnable)
+				std::signal(SIGUSR1, onSignal);
+#endif
+			bEnabled.store(bEnable, std::memory_order_relaxed);
+		}
+		static bool isEnabled() { return bEnabled.load(std::memory_order_relaxed); }
+
+		// steady clock nanoseconds, the same clock the sound mixer times its blocks with
+		static int64_t now()
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		// the calling thread's track, made the first time it records unless nameThread() got there first
+		static Ring& thisThread()
+		{
+			thread_local Ring* pRing = nullptr;
+			if (!pRing)
+				pRing = addRing("thread");
+			return *pRing;
+		}
+		// call as a thread starts, it makes the thread's ring there rather than on its first event
+		static void nameThread(const char* sName)
+		{
+			if (!isEnabled()) return;
+			Ring& ring = thisThread();
+			std::lock_guard<std::mutex> lock(muxRings);
+			ring.sName = sName;
+		}
+		// a track not tied to a thread, made once and kept. Ask for it before recording into it starts
+		static Ring& track(const char* sName)
+		{
+			{
+				std::lock_guard<std::mutex> lock(muxRings);
+				for (auto& ring : vRings)
+					if (ring->sName == sName) return *ring;
+			}
+			return *addRing(sName);
+		}
+
+		// something that took no time, e.g. a state change
+		static void instant(const char* sName, const char* sCategory, const char* sDetail = nullptr)
+		{
+			if (!isEnabled()) return;
+			Event event = makeEvent(sName, sCategory, sDetail);
+			event.nStart = now();
+			thisThread().record(event);
+		}
+		// something timed elsewhere, e.g. by the mixer
+		static void complete(Ring& ring, const char* sName, const char* sCategory, const int64_t nStart, const int64_t nEnd,
+			const char* sKey0 = nullptr, const int n0 = 0, const char* sKey1 = nullptr, const int n1 = 0)
+		{
+			if (!isEnabled()) return;
+			Event event = makeEvent(sName, sCategory, nullptr);
+			event.nStart = nStart;
+			event.nDuration = nEnd - nStart;
+			if (sKey0) addArg(event, sKey0, n0);
+			if (sKey1) addArg(event, sKey1, n1);
+			ring.record(event);
+		}
+
+		// true once after each SIGUSR1
+		static bool dumpRequested() { return bDumpRequested.exchange(false, std::memory_order_relaxed); }
+
+		// writes the last fSeconds of every track to sFile, false if it can't be written
+		static bool dump(const std::string& sFile, const float fSeconds = WINDOW)
+		{
+			std::ofstream out(sFile);
+			if (!out)
+			{
+				std::cout << "can't write " << sFile << std::endl;
+				return false;
+			}
+
+			const int64_t nNow = now();
+			const int64_t nFrom = nNow - int64_t(fSeconds * 1e9f);
+			std::vector<std::pair<Ring*, std::string>> vTracks;
+			{
+				std::lock_guard<std::mutex> lock(muxRings);
+				for (auto& ring : vRings) vTracks.emplace_back(ring.get(), ring->sName);
+			}
+
+			size_t nEvents = 0;
+			out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+			bool bFirst = true;
+			std::vector<Event> vCopy;
+			vCopy.reserve(CAPACITY);
+			for (const auto& [ring, sName] : vTracks)
+			{
+				// copied out first, the thread carries on writing over the oldest while the file is written
+				vCopy.clear();
+				Event copied;
+				for (int i = 0; i < CAPACITY; i++)
+					if (ring->read(ring->pSlots[i], copied))
+						vCopy.push_back(copied);
+
+				out << (bFirst ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ring->nId << ",\"args\":{\"name\":";
+				writeString(out, sName.c_str());
+				out << "}}";
+				bFirst = false;
+
+				for (const Event& event : vCopy)
+				{
+					if (event.nStart + std::max<int64_t>(event.nDuration, 0) < nFrom)
+						continue;
+					out << ",\n{\"name\":";
+					writeString(out, event.sName);
+					out << ",\"cat\":";
+					writeString(out, event.sCategory);
+					out << std::fixed << std::setprecision(3) << ",\"ts\":" << event.nStart / 1000.0;
+					if (event.nDuration < 0)
+						out << ",\"ph\":\"i\",\"s\":\"t\"";
+					else
+						out << ",\"ph\":\"X\",\"dur\":" << event.nDuration / 1000.0;
+					out << ",\"pid\":1,\"tid\":" << ring->nId;
+					if (event.sDetail[0] || event.nArgCount > 0)
+					{
+						out << ",\"args\":{";
+						bool bFirstArg = true;
+						if (event.sDetail[0])
+						{
+							out << "\"detail\":";
+							writeString(out, event.sDetail);
+							bFirstArg = false;
+						}
+						for (int i = 0; i < event.nArgCount; i++, bFirstArg = false)
+						{
+							out << (bFirstArg ? "" : ",");
+							writeString(out, event.sKeys[i]);
+							out << ":" << event.nArgs[i];
+						}
+						out << "}";
+					}
+					out << "}";
+					nEvents++;
+				}
+			}
+			out << "\n]}\n";
+
+			std::cout << "trace of the last " << fSeconds << "s, " << nEvents << " events, written to " << sFile << std::endl;
+			return bool(out);
+		}
+	};
+}
+
+#endif
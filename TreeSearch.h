@@ -0,0 +1,377 @@
+#ifndef TREE_SEARCH_H
+#define TREE_SEARCH_H
+
+#include "Auxiliaries.h"
+#include "WorkerPool.h"
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cmath>
+#include <climits>
+#include <cfloat>
+
+namespace pm
+{
+	// Plays Pacman by Monte Carlo tree search: tries moves from the level as it stands and
+	// follows each with random play to see how it tends to go. Every worker has a copy of
+	// the level to play in, and Level::load() jumps it to whatever state in the tree it
+	// needs, so the rules are the real ones. The workers search one tree together; a path
+	// being tried counts as lost until its rollout is back (virtual loss), which sends the
+	// others down different ones. With one worker a search depends only on the level
+	class TreeSearch
+	{
+	public:
+		static const int DEFAULT_ROLLOUTS = 128; // per move
+
+	private:
+		static const int TICKS_PER_MOVE = nTileSize * SIM_TICK_RATE / nPacmanSpeed; // a tile
+		static const int ROLLOUT_MOVES = 32;
+		// what things are worth, in dots
+		static const int GHOST_DOTS = 4;
+		static const int CLEARED_DOTS = 20;
+		static const int CAUGHT_DOTS = -50;
+		static inline const int FAR = INT_MAX / 2;
+		static inline const float EXPLORATION = 0.5f;
+		static inline const float DISCOUNT = 0.95f;  // a dot a move later is worth this much of one now
+		static inline const float NEAR_MOVES = 8.0f; // ending this far from a dot is worth half a dot
+
+		struct Node
+		{
+			int parent;
+			int step;        // the move that led here, Pathfinder::STEPS order
+			int firstChild;  // children are next to each other, -1 until expanded
+			int nChildren;
+			int nState;      // slot in vStates, -1 until someone takes the move on
+			bool bReady;     // the move's been played and its state saved
+			bool bOver;      // caught or cleared, nothing to play on from here
+			float fOver;     // what it was worth then
+			int nDepth;      // moves from the root
+			float fReturn;   // dots since the root, each discounted by the moves it took
+			int nVisits;
+			int nVirtual;    // workers on their way through
+			float fValue;    // summed over visits
+
+			Node(const int parent, const int step) :
+				parent(parent), step(step), firstChild(-1), nChildren(0), nState(-1),
+				bReady(false), bOver(false), fOver(0.0f), nDepth(0), fReturn(0.0f), nVisits(0), nVirtual(0), fValue(0.0f)
+			{}
+		};
+
+		// what one move did
+		struct Moved
+		{
+			int nEaten = 0; // ghosts count GHOST_DOTS
+			bool bCaught = false;
+			bool bCleared = false;
+
+			float dots() const { return float(nEaten + (bCleared ? CLEARED_DOTS : 0) + (bCaught ? CAUGHT_DOTS : 0)); }
+		};
+
+		LevelData maze;
+		int nRollouts;
+		Canvas canvas;
+		std::vector<olc::Decal*> decals;
+		WorkerPool pool;
+		std::vector<std::unique_ptr<Level>> vLevels; // one to play in per worker
+		std::vector<std::minstd_rand> vDice;         // rollout moves, per worker
+		std::vector<std::vector<int>> vPaths;        // down the tree, per worker
+		std::mutex mux;                              // the tree, nodes and nStates
+		std::vector<Node> vNodes;
+		std::vector<Level::State> vStates;
+		int nStates;
+		float fLowest;  // rollout returns so far, UCB sees them stretched out to 0..1
+		float fHighest;
+		std::vector<int> vDotDist; // moves to the nearest dot at the root
+		std::vector<int> vQueue;
+		uint32_t nSearches;
+		olc::vi2d vLastTile;
+		olc::vf2d vLastPos;
+
+	public:
+		// maze is the level that will be played, drive() only takes levels built from it
+		TreeSearch(const LevelData& maze, const int nRollouts = DEFAULT_ROLLOUTS, const unsigned int nThreads = std::thread::hardware_concurrency()) :
+			maze(maze),
+			nRollouts(std::max(nRollouts, 1)),
+			decals(SPRITE_NAMES.size(), nullptr),
+			pool(nThreads),
+			vPaths(pool.size()),
+			nStates(0),
+			fLowest(0.0f),
+			fHighest(0.0f),
+			nSearches(0),
+			vLastTile(-1, -1),
+			vLastPos(-1.0f, -1.0f)
+		{
+			for (int w = 0; w < pool.size(); w++)
+			{
+				vLevels.emplace_back(new Level(canvas, decals, maze));
+				vLevels.back()->useOwnRandom(0); // each state brings its own dice
+				vLevels.back()->keepTaken();
+			}
+			vDice.resize(pool.size());
+			// a move is played per rollout at most, and adds up to four children
+			vNodes.reserve(1 + 4 * (this->nRollouts + 1));
+			vStates.resize(this->nRollouts + 1);
+		}
+
+		// forget where the last search was, a new game is starting
+		void reset() { vLastTile = { -1, -1 }; }
+
+		// sets where the player turns next, call every tick in place of Pacman::getInput.
+		// Searches once per tile, when it's lined up to turn, or again if it got stuck
+		void drive(Level& level)
+		{
+			const olc::vf2d pos = level.player->getPos();
+			const olc::vi2d tile = screenToTile(pos);
+			if ((int)pos.x % nTileSize == 0 && (int)pos.y % nTileSize == 0 && (tile != vLastTile || pos == vLastPos))
+			{
+				const int step = search(level);
+				if (step >= 0)
+					level.player->steer(stepToDir(step));
+				vLastTile = tile;
+			}
+			vLastPos = pos;
+		}
+
+		// The move, in Pathfinder::STEPS order, that the most rollouts went through. -1 if
+		// the player can't go anywhere
+		int search(const Level& level)
+		{
+			vNodes.clear();
+			vNodes.emplace_back(-1, dirToStep(level.player->getDir()));
+			level.save(vStates[0]);
+			vNodes[0].nState = 0;
+			vNodes[0].bReady = true;
+			nStates = 1;
+			fLowest = FLT_MAX;
+			fHighest = -FLT_MAX;
+			readDots(level);
+
+			const uint32_t nSearch = nSearches++;
+			pool.run(nRollouts, [&](const int i, const int w) { iterate(nSearch * nRollouts + i, w); });
+
+			int nBest = -1;
+			int nMostVisits = 0;
+			for (int c = vNodes[0].firstChild; c >= 0 && c < vNodes[0].firstChild + vNodes[0].nChildren; c++)
+				if (vNodes[c].nVisits > nMostVisits)
+				{
+					nMostVisits = vNodes[c].nVisits;
+					nBest = vNodes[c].step;
+				}
+			return nBest;
+		}
+
+	private:
+		const Pathfinder& walls() const { return vLevels[0]->paths; }
+		const Topology& grid() const { return walls().topology(); }
+
+		// breadth first out of every dot still there. Power ups aren't worth anything but the
+		// ghosts they let the player eat, so they don't count here or in rollouts
+		void readDots(const Level& level)
+		{
+			vDotDist.assign(maze.width * maze.height, FAR);
+			vQueue.clear();
+			for (auto& [pos, object] : level.board)
+				if (object->kind == Kind::DOT && !level.isTaken(pos))
+				{
+					vDotDist[grid().index(pos)] = 0;
+					vQueue.push_back(grid().index(pos));
+				}
+			for (size_t i = 0; i < vQueue.size(); i++)
+				for (int s = 0; s < 4; s++)
+				{
+					const int m = grid().neighbour(vQueue[i], s);
+					if (!walls().isWall(m) && vDotDist[m] == FAR)
+					{
+						vDotDist[m] = vDotDist[vQueue[i]] + 1;
+						vQueue.push_back(m);
+					}
+				}
+		}
+
+		// One rollout: down the tree to a move nobody has played yet, play it, then carry on
+		// at random. Only walking the tree and counting the result happen under the lock
+		void iterate(const uint32_t nRollout, const int w)
+		{
+			Level& level = *vLevels[w];
+			std::vector<int>& vPath = vPaths[w];
+			Node leaf(-1, 0);
+			int nFromState = -1;
+			float fFromReturn = 0.0f;
+			{
+				std::lock_guard<std::mutex> lock(mux);
+				leaf = vNodes[select(vPath)];
+				if (!leaf.bReady)
+				{
+					nFromState = vNodes[leaf.parent].nState;
+					fFromReturn = vNodes[leaf.parent].fReturn;
+				}
+			}
+
+			const bool bPlayed = !leaf.bReady;
+			if (bPlayed)
+			{
+				level.load(vStates[nFromState]);
+				const Moved moved = move(level, leaf.step);
+				level.save(vStates[leaf.nState]);
+				leaf.fReturn = fFromReturn + moved.dots() * std::pow(DISCOUNT, float(leaf.nDepth - 1));
+				leaf.bOver = moved.bCaught || moved.bCleared;
+				leaf.fOver = leaf.fReturn;
+			}
+			else if (!leaf.bOver)
+				level.load(vStates[leaf.nState]);
+
+			float fValue = leaf.fOver;
+			if (!leaf.bOver)
+			{
+				std::minstd_rand& dice = vDice[w];
+				dice.seed(nRollout + 1);
+				fValue = rollout(level, leaf.step, leaf.nDepth, leaf.fReturn, dice);
+			}
+
+			std::lock_guard<std::mutex> lock(mux);
+			if (bPlayed)
+			{
+				Node& node = vNodes[vPath.back()];
+				node.fReturn = leaf.fReturn;
+				node.bOver = leaf.bOver;
+				node.fOver = leaf.fOver;
+				node.bReady = true;
+			}
+			fLowest = std::min(fLowest, fValue);
+			fHighest = std::max(fHighest, fValue);
+			for (const int n : vPath)
+			{
+				vNodes[n].nVirtual--;
+				vNodes[n].nVisits++;
+				vNodes[n].fValue += fValue;
+			}
+		}
+
+		// Walks down by UCB, taking on the first untried move it meets (or stopping where
+		// everything left is being tried by others). Returns the last node of vPath
+		int select(std::vector<int>& vPath)
+		{
+			vPath.clear();
+			int n = 0;
+			for (;;)
+			{
+				vPath.push_back(n);
+				vNodes[n].nVirtual++;
+				if (!vNodes[n].bReady || vNodes[n].bOver)
+					return n;
+				if (vNodes[n].firstChild < 0)
+					expand(n);
+				const int next = pick(n);
+				if (next < 0)
+					return n;
+				if (vNodes[next].nState < 0)
+					vNodes[next].nState = nStates++;
+				n = next;
+			}
+		}
+		// Any way out of the root, past it the same as rollouts: no turning back unless it's
+		// a dead end, so corridors don't branch
+		void expand(const int n)
+		{
+			const int tile = grid().index(screenToTile(vStates[vNodes[n].nState].vMovers[0].vPos));
+			const int nBack = n == 0 ? -1 : vNodes[n].step ^ 1;
+			vNodes[n].firstChild = int(vNodes.size());
+			for (int s = 0; s < 4; s++)
+				if (s != nBack && !walls().isWall(grid().neighbour(tile, s)))
+					addChild(n, s);
+			if (vNodes[n].nChildren == 0 && nBack >= 0 && !walls().isWall(grid().neighbour(tile, nBack)))
+				addChild(n, nBack);
+		}
+		void addChild(const int n, const int step)
+		{
+			vNodes.emplace_back(n, step);
+			vNodes.back().nDepth = vNodes[n].nDepth + 1;
+			vNodes[n].nChildren++;
+		}
+		int pick(const int n) const
+		{
+			const Node& node = vNodes[n];
+			const float fLog = std::log(float(node.nVisits + node.nVirtual));
+			const float fSpread = fHighest > fLowest ? fHighest - fLowest : 1.0f;
+			int nBest = -1;
+			float fBest = -1.0f;
+			for (int c = node.firstChild; c < node.firstChild + node.nChildren; c++)
+			{
+				const Node& child = vNodes[c];
+				if (child.nState < 0)
+					return c; // untried moves first
+				if (!child.bReady)
+					continue; // someone's playing it right now
+				const float fTries = float(child.nVisits + child.nVirtual);
+				const float fMean = (child.fValue / fTries - fLowest) / fSpread;
+				const float fScore = fMean + EXPLORATION * std::sqrt(fLog / fTries);
+				if (fScore > fBest)
+				{
+					fBest = fScore;
+					nBest = c;
+				}
+			}
+			return nBest;
+		}
+
+		// Random moves on from the one that got here, no turning back unless it's a dead end.
+		// Returns fReturn plus what they made
+		float rollout(Level& level, int step, const int nDepth, float fReturn, std::minstd_rand& dice) const
+		{
+			Moved moved;
+			float fWeight = std::pow(DISCOUNT, float(nDepth));
+			for (int m = 0; m < ROLLOUT_MOVES && !moved.bCaught && !moved.bCleared; m++)
+			{
+				const int tile = grid().index(screenToTile(level.player->getPos()));
+				int aSteps[4];
+				int nSteps = 0;
+				for (int s = 0; s < 4; s++)
+					if (s != (step ^ 1) && !walls().isWall(grid().neighbour(tile, s)))
+						aSteps[nSteps++] = s;
+				step = nSteps > 0 ? aSteps[dice() % nSteps] : step ^ 1;
+				moved = move(level, step);
+				fReturn += moved.dots() * fWeight;
+				fWeight *= DISCOUNT;
+			}
+			if (moved.bCaught || moved.bCleared)
+				return fReturn;
+			return fReturn + fWeight * closeness(level.player->getPos());
+		}
+
+		// a tile's worth of ticks by Level's rules, cut short if that's the end
+		static Moved move(Level& level, const int step)
+		{
+			Moved moved;
+			auto onEvent = [&](const Level::Event event, GameObject&) {
+				switch (event)
+				{
+				case Level::Event::DOT:         moved.nEaten++;               break;
+				case Level::Event::GHOST_EATEN: moved.nEaten += GHOST_DOTS;   break;
+				case Level::Event::CAUGHT:      moved.bCaught = true;         break;
+				case Level::Event::CLEARED:     moved.bCleared = true;        break;
+				default:                                                      break;
+				}
+			};
+			level.player->steer(stepToDir(step));
+			const float fElapsedTime = 1.0f / SIM_TICK_RATE;
+			for (int t = 0; t < TICKS_PER_MOVE && !moved.bCaught && !moved.bCleared; t++)
+			{
+				level.movePlayer(fElapsedTime, onEvent);
+				if (!moved.bCleared)
+					level.moveGhosts(fElapsedTime, onEvent);
+			}
+			return moved;
+		}
+
+		// what stopping at pos is worth, up to a dot for being next to one
+		float closeness(const olc::vf2d& pos) const
+		{
+			const int nDist = vDotDist[grid().index(screenToTile(pos))];
+			return nDist == FAR ? 0.0f : NEAR_MOVES / (NEAR_MOVES + nDist);
+		}
+	};
+}
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace pm
+{
+	// A few threads kept around for splitting up per-frame work. run() hands out the
+	// indices 0..n-1 to whoever is free and returns once all of them are done. The thread
+	// calling run() pitches in as worker 0, so a pool of one runs everything in place
+	class WorkerPool
+	{
+		std::vector<std::thread> threads;
+		std::mutex mux;
+		std::condition_variable cvWork;
+		std::condition_variable cvDone;
+
+		std::function<void(int, int)> job; // (index, worker)
+		int nJobs = 0;
+		std::atomic<int> nNextJob = { 0 };
+		int nBusy = 0;     // threads still inside the current run
+		uint32_t nRun = 0;
+		bool bQuit = false;
+
+	public:
+		explicit WorkerPool(unsigned int nWorkers = std::thread::hardware_concurrency())
+		{
+			nWorkers = std::clamp(nWorkers, 1u, 8u);
+			for (unsigned int i = 1; i < nWorkers; ++i)
+				threads.emplace_back(&WorkerPool::loop, this, int(i));
+		}
+		~WorkerPool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mux);
+				bQuit = true;
+			}
+			cvWork.notify_all();
+			for (auto& t : threads)
+				t.join();
+		}
+		WorkerPool(const WorkerPool&) = delete;
+		WorkerPool& operator=(const WorkerPool&) = delete;
+
+		int size() const { return int(threads.size()) + 1; }
+
+		// Not re-entrant, call from one thread at a time
+		void run(const int n, std::function<void(int, int)> fn)
+		{
+			if (threads.empty() || n <= 1)
+			{
+				for (int i = 0; i < n; ++i)
+					fn(i, 0);
+				return;
+			}
+			{
+				std::lock_guard<std::mutex> lock(mux);
+				job = std::move(fn);
+				nJobs = n;
+				nNextJob = 0;
+				nBusy = int(threads.size());
+				++nRun;
+			}
+			cvWork.notify_all();
+			work(0);
+			std::unique_lock<std::mutex> lock(mux);
+			cvDone.wait(lock, [&] { return nBusy == 0; });
+			job = nullptr;
+		}
+
+	private:
+		void work(const int nWorker)
+		{
+			for (int i = nNextJob++; i < nJobs; i = nNextJob++)
+				job(i, nWorker);
+		}
+		// every thread joins every run, even if the jobs are gone by the time it wakes
+		void loop(const int nWorker)
+		{
+			uint32_t nSeen = 0;
+			for (;;)
+			{
+				{
+					std::unique_lock<std::mutex> lock(mux);
+					cvWork.wait(lock, [&] { return bQuit || nRun != nSeen; });
+					if (bQuit)
+						return;
+					nSeen = nRun;
+				}
+				work(nWorker);
+				{
+					std::lock_guard<std::mutex> lock(mux);
+					--nBusy;
+				}
+				cvDone.notify_one();
+			}
+		}
+	};
+}
+
+#endif
@@ -72,15 +72,24 @@
 #define OLC_PGEX_SOUND_H
 
 #include <istream>
+#include <fstream>
 #include <cstring>
+#include <cmath>
 #include <climits>
 #include <condition_variable>
 #include <algorithm>
 #undef min
 #undef max
 
-// Choose a default sound backend
-#if !defined(USE_ALSA) && !defined(USE_OPENAL) && !defined(USE_WINDOWS)
+// The mixer accumulates and converts four samples at a time where SSE2 is available
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OLC_SOUND_SSE2
+#endif
+
+// Choose a default sound backend. Define OLC_SOUND_NO_DEVICE to build with only
+// the null and WAV file outputs, e.g. on machines without ALSA installed
+#if !defined(USE_ALSA) && !defined(USE_OPENAL) && !defined(USE_WINDOWS) && !defined(OLC_SOUND_NO_DEVICE)
 #ifdef __linux__
 #define USE_ALSA
 #endif
@@ -125,6 +134,32 @@ namespace olc
 	{
 		// A representation of an affine transform, used to rotate, scale, offset & shear space
 	public:
+		// A long track left on disk. The stream thread keeps a small ring of frames,
+		// already in the output format, just ahead of the mixer
+		struct AudioStream
+		{
+			static const unsigned int nRingFrames = 16384; // power of two
+
+			// Stream thread only
+			std::filebuf file;
+			olc::ResourceView view;  // instead of file, when it comes from a pack
+			std::istream ifs{ nullptr };
+			OLC_WAVEFORMATEX wavHeader;
+			std::streamoff nDataStart = 0;
+			uint32_t nDataFrames = 0;
+			uint32_t nFramesRead = 0;
+			uint32_t nFillGeneration = 0;
+
+			std::vector<short> vRing;
+			std::atomic<bool> bLoop{ false };
+			std::atomic<uint32_t> nGeneration{ 0 };			// bumped by PlaySample(), restarts the track
+			std::atomic<uint32_t> nReadyGeneration{ 0 };	// the ring holds that generation from nGenerationStart on
+			std::atomic<uint64_t> nGenerationStart{ 0 };
+			std::atomic<uint64_t> nWritten{ 0 };			// frames, only written by the stream thread
+			std::atomic<uint64_t> nRead{ 0 };				// frames, only written by the audio thread
+			std::atomic<uint64_t> nEnd{ UINT64_MAX };		// nWritten at the end of a track that doesn't loop
+		};
+
 		class AudioSample
 		{
 		public:
@@ -134,10 +169,21 @@ namespace olc
 
 		public:
 			OLC_WAVEFORMATEX wavHeader;
-			float* fSample = nullptr;
-			long nSamples = 0;
+			// Interleaved 16-bit, already converted to the output rate and
+			// channel layout so the mixer never has to resample or remap
+			std::vector<short> vSample;
+			std::shared_ptr<AudioStream> pStream; // set instead of vSample for streamed tracks
+			long nSamples = 0; // frames
 			int nChannels = 0;
+			unsigned int nSampleRate = 0;
 			bool bSampleValid = false;
+
+		private:
+			static const uint32_t nCacheVersion = 1;
+			olc::rcode ParseWave(const std::vector<char>& vFile, std::vector<float>& vData);
+			void Convert(std::vector<float>& vData, unsigned int nOutRate, unsigned int nOutChannels);
+			olc::rcode LoadCache(const std::string& sFile);
+			void SaveCache(const std::string& sFile) const;
 		};
 
 		struct sCurrentlyPlayingSample
@@ -147,29 +193,160 @@ namespace olc
 			bool bFinished = false;
 			bool bLoop = false;
 			bool bFlagForStop = false;
+
+			// Resolved by the game thread when posted, so the audio
+			// thread never has to look into vecAudioSamples
+			bool bActive = false;
+			const short* pData = nullptr;
+			long nSamples = 0;
+			int nChannels = 0;
+			unsigned int nSamplesPerSec = 0;
+			unsigned int nSerial = 0; // start order, StopSample() stops the oldest
+			int nPriority = 0;
+			float fVolume = 1.0f;
+
+			AudioStream* pStream = nullptr;
+			uint32_t nStreamGeneration = 0;
+			bool bStreamStarted = false;
+
+			int64_t nPostTime = 0; // when PlaySample() was called, cleared once it is first heard
+		};
+
+		// Counters kept by the audio thread, read them with GetStats()
+		struct sAudioStats
+		{
+			uint64_t nBlocks = 0;
+			uint64_t nUnderruns = 0;		// the device ran dry before the next block arrived
+			uint64_t nStreamStarved = 0;	// a stream's ring was empty when the mixer needed it
+			unsigned int nActiveVoices = 0;
+			float fMixTimeLast = 0.0f;		// microseconds spent in MixBlock()
+			float fMixTimeAverage = 0.0f;
+			float fMixTimeMax = 0.0f;
+			float fDeviceLatency = 0.0f;	// seconds of audio the device is asked to queue
+			// PlaySample() to the submit of the first block it is heard in. Bucket i counts
+			// latencies under 2^i ms, the last one everything longer
+			static const int nLatencyBuckets = 10;
+			uint64_t nLatency[nLatencyBuckets] = {};
 		};
 
-		static std::list<sCurrentlyPlayingSample> listActiveSamples;
+		// Requests from the game thread to the audio thread
+		struct sCommand
+		{
+			enum class Type { PLAY, STOP, STOP_ALL } type = Type::PLAY;
+			sCurrentlyPlayingSample voice;
+		};
+
+		// Fixed pool of voices, owned by the audio thread alone
+		static const unsigned int nMaxVoices = 32;
+		static sCurrentlyPlayingSample m_Voices[nMaxVoices];
 
 	public:
+		// Where the mix goes, chosen at run time before InitialiseAudio():
+		//   DEVICE   - the sound card, through whichever API this was built with
+		//   NONE     - nowhere, no thread is started and nothing is mixed
+		//   WAV_FILE - a WAV file, mixed on the caller's clock through Advance()
+		enum class Backend { DEVICE, NONE, WAV_FILE };
+		static void SetBackend(Backend backend, const std::string& sFile = "");
+		static Backend GetBackend();
+
 		static bool InitialiseAudio(unsigned int nSampleRate = 44100, unsigned int nChannels = 1, unsigned int nBlocks = 8, unsigned int nBlockSamples = 512);
 		static bool DestroyAudio();
+		// Mixes fElapsedTime seconds of audio on the calling thread, only does anything for WAV_FILE.
+		// Call it from the same thread as PlaySample(), after the sounds for that time were posted
+		static void Advance(float fElapsedTime);
 		static void SetUserSynthFunction(std::function<float(int, float, float)> func);
 		static void SetUserFilterFunction(std::function<float(int, float, float)> func);
 
 	public:
 		static int LoadAudioSample(std::string sWavFile, olc::ResourcePack* pack = nullptr);
-		static void PlaySample(int id, bool bLoop = false);
+		// Registers a sample that was loaded elsewhere, e.g. constructed on a worker
+		// thread. Call it from the thread that plays samples, like LoadAudioSample()
+		static int AddAudioSample(AudioSample&& sample);
+		// Like LoadAudioSample(), but the file is read as it plays, so memory use doesn't
+		// grow with its length. Meant for music, only one voice plays a stream at a time and
+		// playing it again restarts it. Falls back to a resident sample if it needs resampling.
+		// From a pack it reads straight from the pack's mapping, which must outlive it
+		static int LoadAudioStream(std::string sWavFile, olc::ResourcePack* pack = nullptr);
+		// Keep converted samples in sDirectory, keyed by a hash of the file and the
+		// output format, so later runs skip parsing and resampling. Empty turns it off
+		static void SetSampleCache(const std::string& sDirectory);
+		// When every allowed voice is busy, a new sample takes over the voice with the
+		// lowest priority, then the quietest, then the oldest - never a higher priority one
+		static void PlaySample(int id, bool bLoop = false, int nPriority = 0, float fVolume = 1.0f);
 		static void StopSample(int id);
 		static void StopAll();
-		static float GetMixerOutput(int nChannel, float fGlobalTime, float fTimeStep);
+		// Caps how many voices mix at once, at most nMaxVoices
+		static void SetMaxVoices(unsigned int nVoices);
+		// Length of a loaded sample in seconds, 0 if the id is not valid
+		static float GetSampleDuration(int id);
+		// Renders nFrames of interleaved audio for every playing voice into pBlock
+		static void MixBlock(short* pBlock, unsigned int nFrames, unsigned int nChannels, float fTimeStep);
+
+		static sAudioStats GetStats();
+		static void ResetStats();
+		// Called on the mixing thread after every block with when it started and ended
+		// (steady clock nanoseconds), for tracing. Keep it short, the device is waiting
+		typedef void (*BlockObserver)(int64_t nStart, int64_t nEnd, unsigned int nFrames, unsigned int nActiveVoices);
+		static void SetBlockObserver(BlockObserver observer);
 
+	private:
+		// Wait-free single producer / single consumer ring. PlaySample() and friends
+		// must all be called from the same thread (the game thread) at any one time
+		static const unsigned int nCommandQueueSize = 256; // power of two
+		static sCommand m_Commands[nCommandQueueSize];
+		static std::atomic<unsigned int> m_nCommandHead; // only written by the game thread
+		static std::atomic<unsigned int> m_nCommandTail; // only written by the audio thread
+		static unsigned int m_nNextSerial;
+		static std::atomic<unsigned int> m_nVoiceLimit;
+		static bool PostCommand(const sCommand& cmd);
+		static void ResetVoices();
+		// Audio thread, applies everything posted since the last block
+		static void ProcessCommands();
+
+		// Float accumulator for one block, clipped and converted once at the end
+		static std::vector<float> m_vMixBuffer;
+		static void MixStream(sCurrentlyPlayingSample& s, float* pMix, unsigned int nFrames, unsigned int nChannels);
+
+		// Statistics, written by the audio thread only
+		static std::atomic<uint64_t> m_nStatBlocks;
+		static std::atomic<uint64_t> m_nStatUnderruns;
+		static std::atomic<uint64_t> m_nStatStreamStarved;
+		static std::atomic<unsigned int> m_nStatActiveVoices;
+		static std::atomic<int64_t> m_nStatMixTimeLast;	// nanoseconds
+		static std::atomic<int64_t> m_nStatMixTimeTotal;
+		static std::atomic<int64_t> m_nStatMixTimeMax;
+		static std::atomic<uint64_t> m_nStatLatency[sAudioStats::nLatencyBuckets];
+		static std::atomic<BlockObserver> m_pBlockObserver;
+		static float m_fDeviceLatency;
+		static int64_t m_nHeardPostTimes[nMaxVoices];	// voices first heard in the block being mixed
+		static unsigned int m_nHeardCount;
+		static int64_t Now();
+		static void NoteHeard(sCurrentlyPlayingSample& s);
+		// Every backend calls this once the mixed block is on its way to the speaker
+		static void SubmittedBlock();
+
+		// WAVE data decoding, shared by resident samples and streams
+		static bool IsDecodable(const OLC_WAVEFORMATEX& wavHeader);
+		static float DecodeSample(const uint8_t* p, unsigned int nBytes, bool bFloat);
+
+		static std::vector<std::shared_ptr<AudioStream>> m_vStreams;
+		static std::thread m_StreamThread;
+		static bool m_bStreamThreadActive; // guarded by m_muxStreams
+		static std::mutex m_muxStreams;
+		static std::condition_variable m_cvStreams;
+		static bool OpenStream(AudioStream& stream, const std::string& sWavFile, olc::ResourcePack* pack);
+		static bool FillStream(AudioStream& stream, std::vector<char>& vChunk);
+		static void StreamThread();
+
+		// Output format, samples are converted to it as they load. Load them after
+		// InitialiseAudio(), anything loaded before assumes its default arguments
+		static unsigned int m_nSampleRate;
+		static unsigned int m_nChannels;
+		static std::string m_sSampleCache;
 
 	private:
 #ifdef USE_WINDOWS // Windows specific sound management
 		static void CALLBACK waveOutProc(HWAVEOUT hWaveOut, UINT uMsg, DWORD dwParam1, DWORD dwParam2);
-		static unsigned int m_nSampleRate;
-		static unsigned int m_nChannels;
 		static unsigned int m_nBlockCount;
 		static unsigned int m_nBlockSamples;
 		static unsigned int m_nBlockCurrent;
@@ -183,8 +360,6 @@ namespace olc
 
 #ifdef USE_ALSA
 		static snd_pcm_t* m_pPCM;
-		static unsigned int m_nSampleRate;
-		static unsigned int m_nChannels;
 		static unsigned int m_nBlockSamples;
 		static short* m_pBlockMemory;
 #endif
@@ -195,13 +370,22 @@ namespace olc
 		static ALuint m_nSource;
 		static ALCdevice* m_pDevice;
 		static ALCcontext* m_pContext;
-		static unsigned int m_nSampleRate;
-		static unsigned int m_nChannels;
 		static unsigned int m_nBlockCount;
 		static unsigned int m_nBlockSamples;
 		static short* m_pBlockMemory;
 #endif
 
+		static Backend m_Backend;
+		static std::string m_sOutputFile;
+		static std::ofstream m_ofsOutput;
+		static uint32_t m_nOutputFrames;
+		static double m_fOutputPending; // fraction of a frame carried over between Advance() calls
+		static std::vector<short> m_vOutputBlock;
+		static void WriteWavHeader();
+
+		// Implemented once per sound API
+		static bool InitialiseDevice(unsigned int nSampleRate, unsigned int nChannels, unsigned int nBlocks, unsigned int nBlockSamples);
+		static bool DestroyDevice();
 		static void AudioThread();
 		static std::thread m_AudioThread;
 		static std::atomic<bool> m_bAudioThreadActive;
@@ -229,86 +413,228 @@ namespace olc
 
 	olc::rcode SOUND::AudioSample::LoadFromFile(std::string sWavFile, olc::ResourcePack* pack)
 	{
-		auto ReadWave = [&](std::istream& is)
-		{
-			char dump[4];
-			is.read(dump, sizeof(char) * 4); // Read "RIFF"
-			if (strncmp(dump, "RIFF", 4) != 0) return olc::FAIL;
-			is.read(dump, sizeof(char) * 4); // Not Interested
-			is.read(dump, sizeof(char) * 4); // Read "WAVE"
-			if (strncmp(dump, "WAVE", 4) != 0) return olc::FAIL;
-
-			// Read Wave description chunk
-			is.read(dump, sizeof(char) * 4); // Read "fmt "
-			unsigned int nHeaderSize = 0;
-			is.read((char*)&nHeaderSize, sizeof(unsigned int)); // Not Interested
-			is.read((char*)&wavHeader, nHeaderSize);// sizeof(WAVEFORMATEX)); // Read Wave Format Structure chunk
-														// Note the -2, because the structure has 2 bytes to indicate its own size
-														// which are not in the wav file
-
-			// Just check if wave format is compatible with olcPGE
-			if (wavHeader.wBitsPerSample != 16 || wavHeader.nSamplesPerSec != 44100)
-				return olc::FAIL;
-
-			// Search for audio data chunk
-			uint32_t nChunksize = 0;
-			is.read(dump, sizeof(char) * 4); // Read chunk header
-			is.read((char*)&nChunksize, sizeof(uint32_t)); // Read chunk size
-			while (strncmp(dump, "data", 4) != 0)
+		// The whole file is needed anyway, for the cache key and to parse from
+		std::vector<char> vFile;
+		if (pack != nullptr)
+			vFile = pack->GetFileBuffer(sWavFile).vMemory;
+		else
+		{
+			std::ifstream ifs(sWavFile, std::ifstream::binary);
+			if (!ifs.is_open()) return olc::FAIL;
+			vFile.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+		}
+
+		std::string sCacheFile;
+		if (!m_sSampleCache.empty())
+		{
+			// FNV-1a over the file contents and the format they get converted to
+			uint64_t nHash = 14695981039346656037ull;
+			auto Hash = [&](const char* p, size_t n) { for (size_t i = 0; i < n; i++) nHash = (nHash ^ (uint8_t)p[i]) * 1099511628211ull; };
+			const uint32_t nKey[3] = { nCacheVersion, m_nSampleRate, m_nChannels };
+			Hash(vFile.data(), vFile.size());
+			Hash((const char*)nKey, sizeof(nKey));
+
+			char sName[24];
+			snprintf(sName, sizeof(sName), "%016llx.pcm", (unsigned long long)nHash);
+			sCacheFile = m_sSampleCache + sName;
+			if (LoadCache(sCacheFile) == olc::OK)
+				return olc::OK;
+		}
+
+		std::vector<float> vData;
+		if (ParseWave(vFile, vData) != olc::OK)
+			return olc::FAIL;
+		Convert(vData, m_nSampleRate, m_nChannels);
+
+		// All done, flag sound as valid
+		bSampleValid = true;
+		if (!sCacheFile.empty())
+			SaveCache(sCacheFile);
+		return olc::OK;
+	}
+
+	// Reads 8/16/24/32-bit PCM or 32-bit float into normalised interleaved floats
+	olc::rcode SOUND::AudioSample::ParseWave(const std::vector<char>& vFile, std::vector<float>& vData)
+	{
+		auto Read32 = [&](size_t i) { uint32_t n; memcpy(&n, vFile.data() + i, sizeof(n)); return n; };
+
+		if (vFile.size() < 12 || strncmp(vFile.data(), "RIFF", 4) != 0 || strncmp(vFile.data() + 8, "WAVE", 4) != 0)
+			return olc::FAIL;
+
+		// Walk the chunks, only "fmt " and "data" are of interest
+		const char* pData = nullptr;
+		size_t nDataSize = 0;
+		bool bFormat = false;
+		for (size_t i = 12; i + 8 <= vFile.size(); )
+		{
+			uint32_t nChunkSize = Read32(i + 4);
+			size_t nBody = std::min<size_t>(nChunkSize, vFile.size() - i - 8);
+			if (strncmp(vFile.data() + i, "fmt ", 4) == 0)
+			{
+				wavHeader = OLC_WAVEFORMATEX();
+				memcpy(&wavHeader, vFile.data() + i + 8, std::min(nBody, sizeof(OLC_WAVEFORMATEX)));
+				// WAVE_FORMAT_EXTENSIBLE keeps the real tag at the start of its sub-format GUID
+				if (wavHeader.wFormatTag == 0xFFFE && nBody >= 26)
+					memcpy(&wavHeader.wFormatTag, vFile.data() + i + 8 + 24, sizeof(uint16_t));
+				bFormat = true;
+			}
+			else if (strncmp(vFile.data() + i, "data", 4) == 0)
 			{
-				// Not audio data, so just skip it
-				//std::fseek(f, nChunksize, SEEK_CUR);
-				is.seekg(nChunksize, std::istream::cur);
-				is.read(dump, sizeof(char) * 4);
-				is.read((char*)&nChunksize, sizeof(uint32_t));
+				pData = vFile.data() + i + 8;
+				nDataSize = nBody;
 			}
+			i += 8 + (size_t)nChunkSize + (nChunkSize & 1); // chunks are word aligned
+		}
 
-			// Finally got to data, so read it all in and convert to float samples
-			nSamples = nChunksize / (wavHeader.nChannels * (wavHeader.wBitsPerSample >> 3));
-			nChannels = wavHeader.nChannels;
+		if (!bFormat || pData == nullptr)
+			return olc::FAIL;
 
-			// Create floating point buffer to hold audio sample
-			fSample = new float[nSamples * nChannels];
-			float* pSample = fSample;
+		if (!IsDecodable(wavHeader))
+			return olc::FAIL;
 
-			// Read in audio data and normalise
-			for (long i = 0; i < nSamples; i++)
-			{
-				for (int c = 0; c < nChannels; c++)
-				{
-					short s = 0;
-					if (!is.eof())
-					{
-						is.read((char*)&s, sizeof(short));
+		const unsigned int nBytes = wavHeader.wBitsPerSample / 8;
+		const bool bFloat = wavHeader.wFormatTag == 3;
+		nChannels = wavHeader.nChannels;
+		nSampleRate = wavHeader.nSamplesPerSec;
+		nSamples = (long)(nDataSize / (nBytes * nChannels));
+		vData.resize((size_t)nSamples * nChannels);
 
-						*pSample = (float)s / (float)(SHRT_MAX);
-						pSample++;
-					}
-				}
-			}
+		const uint8_t* p = (const uint8_t*)pData;
+		for (size_t i = 0; i < vData.size(); i++, p += nBytes)
+			vData[i] = DecodeSample(p, nBytes, bFloat);
+		return olc::OK;
+	}
 
-			// All done, flag sound as valid
-			bSampleValid = true;
-			return olc::OK;
-		};
+	bool SOUND::IsDecodable(const OLC_WAVEFORMATEX& wavHeader)
+	{
+		const unsigned int nBytes = wavHeader.wBitsPerSample / 8;
+		return wavHeader.nChannels > 0 && wavHeader.nSamplesPerSec > 0
+			&& ((wavHeader.wFormatTag == 1 && nBytes >= 1 && nBytes <= 4) || (wavHeader.wFormatTag == 3 && nBytes == 4));
+	}
 
-		if (pack != nullptr)
+	float SOUND::DecodeSample(const uint8_t* p, unsigned int nBytes, bool bFloat)
+	{
+		int32_t n = 0;
+		switch (nBytes)
 		{
-			olc::ResourceBuffer rb = pack->GetFileBuffer(sWavFile);
-			std::istream is(&rb);
-			return ReadWave(is);
+		case 1: return (float)((int)p[0] - 128) / 128.0f; // 8-bit is unsigned
+		case 2: n = (int32_t)((uint32_t)p[0] << 16 | (uint32_t)p[1] << 24); break;
+		case 3: n = (int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 24); break;
+		default:
+			if (bFloat) { float f; memcpy(&f, p, sizeof(f)); return f; }
+			memcpy(&n, p, sizeof(n));
+			break;
 		}
-		else
+		return (float)n / 2147483648.0f;
+	}
+
+	// Remaps channels, then band-limited resampling with a windowed sinc
+	void SOUND::AudioSample::Convert(std::vector<float>& vData, unsigned int nOutRate, unsigned int nOutChannels)
+	{
+		// Mono output gets the average of all channels, otherwise channels repeat as needed
+		std::vector<float> vMapped((size_t)nSamples * nOutChannels);
+		for (long f = 0; f < nSamples; f++)
 		{
-			// Read from file
-			std::ifstream ifs(sWavFile, std::ifstream::binary);
-			if (ifs.is_open())
+			const float* pIn = vData.data() + (size_t)f * nChannels;
+			float* pOut = vMapped.data() + (size_t)f * nOutChannels;
+			if (nOutChannels == 1 && nChannels > 1)
 			{
-				return ReadWave(ifs);
+				float fSum = 0.0f;
+				for (int c = 0; c < nChannels; c++) fSum += pIn[c];
+				pOut[0] = fSum / (float)nChannels;
 			}
 			else
-				return olc::FAIL;
+				for (unsigned int c = 0; c < nOutChannels; c++)
+					pOut[c] = pIn[c % nChannels];
+		}
+		nChannels = nOutChannels;
+
+		if (nSampleRate != nOutRate)
+		{
+			// Cut off below the lower of the two Nyquist frequencies, leaving
+			// a little room for the window's transition band
+			const double fRatio = (double)nOutRate / (double)nSampleRate;
+			const double fCutoff = std::min(1.0, fRatio) * 0.95;
+			const int nZeroCrossings = 16;
+			const double fHalfWidth = (double)nZeroCrossings / fCutoff; // in input frames
+
+			// One side of the Blackman windowed kernel, linearly interpolated when applied
+			const int nTableSteps = 512;
+			const double fPi = 3.14159265358979323846;
+			std::vector<float> vKernel((size_t)(fHalfWidth * nTableSteps) + 2);
+			for (size_t i = 0; i < vKernel.size(); i++)
+			{
+				double t = (double)i / nTableSteps;
+				double u = std::min(t / fHalfWidth, 1.0);
+				double x = fPi * t * fCutoff;
+				double fSinc = x == 0.0 ? 1.0 : std::sin(x) / x;
+				double fWindow = 0.42 + 0.5 * std::cos(fPi * u) + 0.08 * std::cos(2.0 * fPi * u);
+				vKernel[i] = (float)(fCutoff * fSinc * fWindow);
+			}
+
+			const long nOutSamples = (long)((double)nSamples * fRatio);
+			std::vector<float> vResampled((size_t)nOutSamples * nChannels, 0.0f);
+			for (long j = 0; j < nOutSamples; j++)
+			{
+				const double fCentre = (double)j * nSampleRate / nOutRate;
+				const long nFirst = std::max(0L, (long)std::ceil(fCentre - fHalfWidth));
+				const long nLast = std::min(nSamples - 1, (long)std::floor(fCentre + fHalfWidth));
+				float* pOut = vResampled.data() + (size_t)j * nChannels;
+				for (long i = nFirst; i <= nLast; i++)
+				{
+					double d = std::abs((double)i - fCentre) * nTableSteps;
+					size_t k = (size_t)d;
+					float fFrac = (float)(d - (double)k);
+					float h = vKernel[k] + (vKernel[k + 1] - vKernel[k]) * fFrac;
+					const float* pIn = vMapped.data() + (size_t)i * nChannels;
+					for (int c = 0; c < nChannels; c++)
+						pOut[c] += pIn[c] * h;
+				}
+			}
+			vMapped.swap(vResampled);
+			nSamples = nOutSamples;
+			nSampleRate = nOutRate;
 		}
+
+		vSample.resize(vMapped.size());
+		for (size_t i = 0; i < vMapped.size(); i++)
+			vSample[i] = (short)std::min(std::max(std::lround(vMapped[i] * 32768.0f), -32768L), 32767L);
+	}
+
+	olc::rcode SOUND::AudioSample::LoadCache(const std::string& sFile)
+	{
+		std::ifstream ifs(sFile, std::ifstream::binary);
+		if (!ifs.is_open()) return olc::FAIL;
+
+		char sMagic[4] = {};
+		uint32_t nHeader[4] = {}; // version, rate, channels, frames
+		ifs.read(sMagic, sizeof(sMagic));
+		ifs.read((char*)nHeader, sizeof(nHeader));
+		if (!ifs || strncmp(sMagic, "OLCS", 4) != 0 || nHeader[0] != nCacheVersion
+			|| nHeader[1] != m_nSampleRate || nHeader[2] != m_nChannels)
+			return olc::FAIL;
+
+		std::vector<short> vData((size_t)nHeader[3] * nHeader[2]);
+		ifs.read((char*)vData.data(), vData.size() * sizeof(short));
+		if (!ifs) return olc::FAIL; // cut short, convert again
+
+		vSample.swap(vData);
+		nSampleRate = nHeader[1];
+		nChannels = (int)nHeader[2];
+		nSamples = (long)nHeader[3];
+		wavHeader = { 1, (uint16_t)nChannels, nSampleRate, nSampleRate * nChannels * 2, (uint16_t)(nChannels * 2), 16, 0 };
+		bSampleValid = true;
+		return olc::OK;
+	}
+
+	void SOUND::AudioSample::SaveCache(const std::string& sFile) const
+	{
+		std::ofstream ofs(sFile, std::ofstream::binary);
+		if (!ofs.is_open()) return;
+		const uint32_t nHeader[4] = { nCacheVersion, nSampleRate, (uint32_t)nChannels, (uint32_t)nSamples };
+		ofs.write("OLCS", 4);
+		ofs.write((const char*)nHeader, sizeof(nHeader));
+		ofs.write((const char*)vSample.data(), vSample.size() * sizeof(short));
 	}
 
 	// This vector holds all loaded sound samples in memory
@@ -328,104 +654,735 @@ namespace olc
 		funcUserFilter = func;
 	}
 
-	// Load a 16-bit WAVE file @ 44100Hz ONLY into memory. A sample ID
-	// number is returned if successful, otherwise -1
+	// Load a PCM or float WAVE file of any rate into memory, converted to the
+	// output format. A sample ID number is returned if successful, otherwise -1
 	int SOUND::LoadAudioSample(std::string sWavFile, olc::ResourcePack* pack)
 	{
 
 		olc::SOUND::AudioSample a(sWavFile, pack);
 		if (a.bSampleValid)
-		{
-			vecAudioSamples.push_back(a);
-			return (unsigned int)vecAudioSamples.size();
-		}
+			return AddAudioSample(std::move(a));
 		else
 			return -1;
 	}
 
-	// Add sample 'id' to the mixers sounds to play list
-	void SOUND::PlaySample(int id, bool bLoop)
+	int SOUND::AddAudioSample(AudioSample&& sample)
 	{
-		olc::SOUND::sCurrentlyPlayingSample a;
-		a.nAudioSampleID = id;
-		a.nSamplePosition = 0;
-		a.bFinished = false;
-		a.bFlagForStop = false;
-		a.bLoop = bLoop;
-		SOUND::listActiveSamples.push_back(a);
+		vecAudioSamples.push_back(std::move(sample));
+		return (unsigned int)vecAudioSamples.size();
 	}
 
-	void SOUND::StopSample(int id)
+	int SOUND::LoadAudioStream(std::string sWavFile, olc::ResourcePack* pack)
 	{
-		// Find first occurence of sample id
-		auto s = std::find_if(listActiveSamples.begin(), listActiveSamples.end(), [&](const olc::SOUND::sCurrentlyPlayingSample& s) { return s.nAudioSampleID == id; });
-		if (s != listActiveSamples.end())
-			s->bFlagForStop = true;
+		auto stream = std::make_shared<AudioStream>();
+		if (!OpenStream(*stream, sWavFile, pack))
+			return LoadAudioSample(sWavFile, pack);
+
+		olc::SOUND::AudioSample a;
+		a.wavHeader = stream->wavHeader;
+		a.pStream = stream;
+		a.nSamples = (long)stream->nDataFrames;
+		a.nChannels = (int)m_nChannels;
+		a.nSampleRate = m_nSampleRate;
+		a.bSampleValid = true;
+		vecAudioSamples.push_back(std::move(a));
+
+		std::lock_guard<std::mutex> lock(m_muxStreams);
+		m_vStreams.push_back(stream);
+		// only a device mixes on a clock of its own, Advance() tops the streams up for
+		// WAV_FILE and NONE never reads them
+		if (!m_bStreamThreadActive && m_Backend == Backend::DEVICE)
+		{
+			m_bStreamThreadActive = true;
+			m_StreamThread = std::thread(&SOUND::StreamThread);
+		}
+		return (unsigned int)vecAudioSamples.size();
 	}
 
-	void SOUND::StopAll()
+	// Finds the data chunk, only accepts files that need no resampling
+	bool SOUND::OpenStream(AudioStream& stream, const std::string& sWavFile, olc::ResourcePack* pack)
 	{
-		for (auto& s : listActiveSamples)
+		std::istream& ifs = stream.ifs;
+		if (pack != nullptr)
+		{
+			stream.view = pack->GetFileView(sWavFile);
+			if (stream.view.Size() == 0) return false;
+			ifs.rdbuf(&stream.view);
+		}
+		else
 		{
-			s.bFlagForStop = true;
+			if (stream.file.open(sWavFile, std::ios::in | std::ios::binary) == nullptr) return false;
+			ifs.rdbuf(&stream.file);
+		}
+
+		char dump[4];
+		uint32_t nChunkSize = 0;
+		ifs.read(dump, 4);
+		if (!ifs || strncmp(dump, "RIFF", 4) != 0) return false;
+		ifs.read((char*)&nChunkSize, sizeof(nChunkSize));
+		ifs.read(dump, 4);
+		if (!ifs || strncmp(dump, "WAVE", 4) != 0) return false;
+
+		bool bFormat = false;
+		stream.wavHeader = OLC_WAVEFORMATEX();
+		while (ifs.read(dump, 4) && ifs.read((char*)&nChunkSize, sizeof(nChunkSize)))
+		{
+			if (strncmp(dump, "fmt ", 4) == 0)
+			{
+				uint32_t nRead = std::min<uint32_t>(nChunkSize, sizeof(OLC_WAVEFORMATEX));
+				ifs.read((char*)&stream.wavHeader, nRead);
+				if (stream.wavHeader.wFormatTag == 0xFFFE && nChunkSize >= 26)
+				{
+					ifs.seekg(24 - (std::streamoff)nRead, std::ifstream::cur);
+					ifs.read((char*)&stream.wavHeader.wFormatTag, sizeof(uint16_t));
+					nRead = 26;
+				}
+				ifs.seekg((std::streamoff)(nChunkSize - nRead + (nChunkSize & 1)), std::ifstream::cur);
+				bFormat = true;
+			}
+			else if (strncmp(dump, "data", 4) == 0)
+			{
+				if (!bFormat || !IsDecodable(stream.wavHeader) || stream.wavHeader.nSamplesPerSec != m_nSampleRate)
+					return false;
+				stream.nDataStart = ifs.tellg();
+				stream.nDataFrames = nChunkSize / (stream.wavHeader.nChannels * (stream.wavHeader.wBitsPerSample / 8));
+				stream.vRing.resize(AudioStream::nRingFrames * m_nChannels);
+				return true;
+			}
+			else
+				ifs.seekg((std::streamoff)nChunkSize + (nChunkSize & 1), std::ifstream::cur);
 		}
+		return false;
 	}
 
-	float SOUND::GetMixerOutput(int nChannel, float fGlobalTime, float fTimeStep)
+	// Stream thread, tops up one ring by a chunk. True if there may be more to do right away
+	bool SOUND::FillStream(AudioStream& stream, std::vector<char>& vChunk)
 	{
-		// Accumulate sample for this channel
-		float fMixerSample = 0.0f;
+		const uint32_t nGeneration = stream.nGeneration.load(std::memory_order_acquire);
+		if (nGeneration == 0) return false; // never played
+
+		uint64_t nWritten = stream.nWritten.load(std::memory_order_relaxed);
+		if (nGeneration != stream.nFillGeneration)
+		{
+			// Restarted. New frames go after whatever is still in the ring, the mixer skips to them
+			stream.nFillGeneration = nGeneration;
+			stream.nFramesRead = 0;
+			stream.ifs.clear();
+			stream.ifs.seekg(stream.nDataStart);
+			stream.nEnd.store(UINT64_MAX, std::memory_order_relaxed);
+			stream.nGenerationStart.store(nWritten, std::memory_order_relaxed);
+			stream.nReadyGeneration.store(nGeneration, std::memory_order_release);
+		}
+		if (stream.nEnd.load(std::memory_order_relaxed) != UINT64_MAX) return false;
+
+		if (stream.nFramesRead == stream.nDataFrames)
+		{
+			if (stream.bLoop && stream.nDataFrames > 0)
+			{
+				stream.ifs.clear();
+				stream.ifs.seekg(stream.nDataStart);
+				stream.nFramesRead = 0;
+				return true;
+			}
+			stream.nEnd.store(nWritten, std::memory_order_release);
+			return false;
+		}
+
+		const uint64_t nFree = AudioStream::nRingFrames - (nWritten - stream.nRead.load(std::memory_order_acquire));
+		const uint32_t nChunkFrames = 4096;
+		const uint32_t nWant = (uint32_t)std::min<uint64_t>({ nFree, nChunkFrames, stream.nDataFrames - stream.nFramesRead });
+		if (nWant == 0) return false;
+
+		const OLC_WAVEFORMATEX& wh = stream.wavHeader;
+		const unsigned int nBytes = wh.wBitsPerSample / 8;
+		const unsigned int nInChannels = wh.nChannels;
+		const unsigned int nFrameBytes = nBytes * nInChannels;
+		vChunk.resize((size_t)nWant * nFrameBytes);
+		stream.ifs.read(vChunk.data(), vChunk.size());
+		const uint32_t nGot = (uint32_t)(stream.ifs.gcount() / nFrameBytes);
+		if (nGot == 0)
+		{
+			// File is shorter than its header says, call this the end
+			stream.nDataFrames = stream.nFramesRead;
+			return true;
+		}
 
-		for (auto& s : listActiveSamples)
+		// Same channel mapping as AudioSample::Convert(), no resampling needed here
+		const bool bFloat = wh.wFormatTag == 3;
+		for (uint32_t f = 0; f < nGot; f++)
 		{
-			if (m_bAudioThreadActive)
+			const uint8_t* pIn = (const uint8_t*)vChunk.data() + (size_t)f * nFrameBytes;
+			short* pOut = stream.vRing.data() + (size_t)((nWritten + f) & (AudioStream::nRingFrames - 1)) * m_nChannels;
+			for (unsigned int c = 0; c < m_nChannels; c++)
 			{
-				if (s.bFlagForStop)
+				float fValue = 0.0f;
+				if (m_nChannels == 1 && nInChannels > 1)
 				{
-					s.bLoop = false;
-					s.bFinished = true;
+					for (unsigned int i = 0; i < nInChannels; i++) fValue += DecodeSample(pIn + i * nBytes, nBytes, bFloat);
+					fValue /= (float)nInChannels;
 				}
 				else
+					fValue = DecodeSample(pIn + (c % nInChannels) * nBytes, nBytes, bFloat);
+				pOut[c] = (short)std::min(std::max(std::lround(fValue * 32768.0f), -32768L), 32767L);
+			}
+		}
+		stream.nFramesRead += nGot;
+		stream.nWritten.store(nWritten + nGot, std::memory_order_release);
+		return true;
+	}
+
+	void SOUND::StreamThread()
+	{
+		std::vector<char> vChunk;
+		std::unique_lock<std::mutex> lock(m_muxStreams);
+		while (m_bStreamThreadActive)
+		{
+			bool bBusy = false;
+			for (auto& stream : m_vStreams)
+				bBusy |= FillStream(*stream, vChunk);
+
+			// The mixer never signals, so poll often enough to stay well ahead of it
+			if (!bBusy)
+				m_cvStreams.wait_for(lock, std::chrono::milliseconds(5));
+		}
+	}
+
+	void SOUND::SetSampleCache(const std::string& sDirectory)
+	{
+		m_sSampleCache = sDirectory;
+		if (!m_sSampleCache.empty() && m_sSampleCache.back() != '/' && m_sSampleCache.back() != '\\')
+			m_sSampleCache += '/';
+	}
+
+	bool SOUND::PostCommand(const sCommand& cmd)
+	{
+		unsigned int nHead = m_nCommandHead.load(std::memory_order_relaxed);
+		if (nHead - m_nCommandTail.load(std::memory_order_acquire) == nCommandQueueSize)
+			return false; // Audio thread is not keeping up, drop it rather than wait
+
+		m_Commands[nHead & (nCommandQueueSize - 1)] = cmd;
+		m_nCommandHead.store(nHead + 1, std::memory_order_release);
+		return true;
+	}
+
+	void SOUND::ResetVoices()
+	{
+		for (auto& v : m_Voices) v = sCurrentlyPlayingSample();
+		m_nCommandHead = 0;
+		m_nCommandTail = 0;
+	}
+
+	void SOUND::ProcessCommands()
+	{
+		unsigned int nTail = m_nCommandTail.load(std::memory_order_relaxed);
+		unsigned int nHead = m_nCommandHead.load(std::memory_order_acquire);
+		for (; nTail != nHead; nTail++)
+		{
+			const sCommand& cmd = m_Commands[nTail & (nCommandQueueSize - 1)];
+			switch (cmd.type)
+			{
+			case sCommand::Type::PLAY:
+			{
+				// Voices already told to stop are about to be free, so they don't count
+				unsigned int nPlaying = 0;
+				sCurrentlyPlayingSample* pFree = nullptr;
+				sCurrentlyPlayingSample* pVictim = nullptr;
+				for (auto& v : m_Voices)
 				{
-					// Calculate sample position
-					s.nSamplePosition += roundf((float)vecAudioSamples[s.nAudioSampleID - 1].wavHeader.nSamplesPerSec * fTimeStep);
+					if (!v.bActive || v.bFlagForStop)
+					{
+						if (!v.bActive && pFree == nullptr) pFree = &v;
+						continue;
+					}
+					nPlaying++;
+					if (pVictim == nullptr
+						|| v.nPriority < pVictim->nPriority
+						|| (v.nPriority == pVictim->nPriority && (v.fVolume < pVictim->fVolume
+						|| (v.fVolume == pVictim->fVolume && int(v.nSerial - pVictim->nSerial) < 0))))
+						pVictim = &v;
+				}
+
+				if (nPlaying < m_nVoiceLimit && pFree != nullptr)
+					*pFree = cmd.voice;
+				else if (pVictim != nullptr && pVictim->nPriority <= cmd.voice.nPriority)
+					*pVictim = cmd.voice; // steal it
+				// else nothing quieter to give up, drop the new one
+				break;
+			}
+			case sCommand::Type::STOP:
+			{
+				// Find first occurence of sample id
+				sCurrentlyPlayingSample* pOldest = nullptr;
+				for (auto& v : m_Voices)
+					if (v.bActive && !v.bFlagForStop && v.nAudioSampleID == cmd.voice.nAudioSampleID
+						&& (pOldest == nullptr || int(v.nSerial - pOldest->nSerial) < 0))
+						pOldest = &v;
+				if (pOldest != nullptr)
+					pOldest->bFlagForStop = true;
+				break;
+			}
+			case sCommand::Type::STOP_ALL:
+				for (auto& v : m_Voices)
+					v.bFlagForStop = true;
+				break;
+			}
+		}
+		m_nCommandTail.store(nTail, std::memory_order_release);
+	}
+
+	// Add sample 'id' to the mixers sounds to play list
+	void SOUND::PlaySample(int id, bool bLoop, int nPriority, float fVolume)
+	{
+		if (id < 1 || id > (int)vecAudioSamples.size()) return;
+		const AudioSample& sample = vecAudioSamples[id - 1];
+
+		sCommand cmd;
+		cmd.type = sCommand::Type::PLAY;
+		cmd.voice.nAudioSampleID = id;
+		cmd.voice.nSamplePosition = 0;
+		cmd.voice.bFinished = false;
+		cmd.voice.bFlagForStop = false;
+		cmd.voice.bLoop = bLoop;
+		cmd.voice.bActive = true;
+		cmd.voice.pData = sample.vSample.data();
+		cmd.voice.nSamples = sample.nSamples;
+		cmd.voice.nChannels = sample.nChannels;
+		cmd.voice.nSamplesPerSec = sample.nSampleRate;
+		cmd.voice.nSerial = m_nNextSerial++;
+		cmd.voice.nPriority = nPriority;
+		cmd.voice.fVolume = fVolume;
+		cmd.voice.nPostTime = Now();
+		if (sample.pStream != nullptr)
+		{
+			// Any voice still on the old generation stops by itself
+			cmd.voice.pStream = sample.pStream.get();
+			sample.pStream->bLoop = bLoop;
+			cmd.voice.nStreamGeneration = ++sample.pStream->nGeneration;
+			m_cvStreams.notify_one();
+		}
+		PostCommand(cmd);
+	}
+
+	void SOUND::SetMaxVoices(unsigned int nVoices)
+	{
+		m_nVoiceLimit = std::min(std::max(nVoices, 1u), nMaxVoices);
+	}
+
+	float SOUND::GetSampleDuration(int id)
+	{
+		if (id < 1 || id > (int)vecAudioSamples.size()) return 0.0f;
+		const AudioSample& sample = vecAudioSamples[id - 1];
+		return sample.nSampleRate == 0 ? 0.0f : (float)sample.nSamples / (float)sample.nSampleRate;
+	}
+
+	void SOUND::StopSample(int id)
+	{
+		sCommand cmd;
+		cmd.type = sCommand::Type::STOP;
+		cmd.voice.nAudioSampleID = id;
+		PostCommand(cmd);
+	}
+
+	void SOUND::StopAll()
+	{
+		sCommand cmd;
+		cmd.type = sCommand::Type::STOP_ALL;
+		PostCommand(cmd);
+	}
+
+	void SOUND::MixBlock(short* pBlock, unsigned int nFrames, unsigned int nChannels, float fTimeStep)
+	{
+		const int64_t nMixStart = Now();
+
+		// Pick up whatever the game asked for since the last block
+		ProcessCommands();
+
+		const unsigned int nOut = nFrames * nChannels;
+		if (m_vMixBuffer.size() < nOut) m_vMixBuffer.resize(nOut);
+		float* pMix = m_vMixBuffer.data();
+		std::fill(pMix, pMix + nOut, 0.0f);
 
-					// If sample position is valid add to the mix
-					if (s.nSamplePosition < vecAudioSamples[s.nAudioSampleID - 1].nSamples)
-						fMixerSample += vecAudioSamples[s.nAudioSampleID - 1].fSample[(s.nSamplePosition * vecAudioSamples[s.nAudioSampleID - 1].nChannels) + nChannel];
+		// Each voice is added in runs that stop only at the end of its sample
+		for (auto& s : m_Voices)
+		{
+			if (!s.bActive) continue;
+
+			if (s.bFlagForStop || s.nSamples <= 0 || !m_bAudioThreadActive)
+			{
+				s.bLoop = false;
+				s.bFinished = true;
+				s.bActive = false;
+				continue;
+			}
+
+			if (s.pStream != nullptr)
+			{
+				MixStream(s, pMix, nFrames, nChannels);
+				if (s.bStreamStarted) NoteHeard(s);
+				continue;
+			}
+
+			NoteHeard(s);
+			const long nStep = std::max(1L, (long)roundf((float)s.nSamplesPerSec * fTimeStep));
+			unsigned int nFrame = 0;
+			while (nFrame < nFrames)
+			{
+				if (s.nSamplePosition >= s.nSamples)
+				{
+					if (s.bLoop)
+						s.nSamplePosition = 0;
 					else
 					{
-						if (s.bLoop)
-						{
-							s.nSamplePosition = 0;
-						}
-						else
-							s.bFinished = true; // Else sound has completed
+						// Sound has completed, free its voice
+						s.bFinished = true;
+						s.bActive = false;
+						break;
 					}
 				}
+
+				unsigned int nRun = (unsigned int)std::min<long>(nFrames - nFrame, (s.nSamples - s.nSamplePosition + nStep - 1) / nStep);
+				const short* pSrc = s.pData + s.nSamplePosition * s.nChannels;
+				float* pDst = pMix + nFrame * nChannels;
+
+				const float fGain = s.fVolume / 32768.0f;
+				if (nStep == 1 && (unsigned int)s.nChannels == nChannels)
+				{
+					// Converted at load to the output layout, a straight widen and multiply-add
+					unsigned int n = 0, nCount = nRun * nChannels;
+#ifdef OLC_SOUND_SSE2
+					const __m128 vGain = _mm_set1_ps(fGain);
+					for (; n + 8 <= nCount; n += 8)
+					{
+						// Duplicating each 16-bit value then shifting right sign-extends it
+						__m128i x = _mm_loadu_si128((const __m128i*)(pSrc + n));
+						__m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16));
+						__m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16));
+						_mm_storeu_ps(pDst + n, _mm_add_ps(_mm_loadu_ps(pDst + n), _mm_mul_ps(lo, vGain)));
+						_mm_storeu_ps(pDst + n + 4, _mm_add_ps(_mm_loadu_ps(pDst + n + 4), _mm_mul_ps(hi, vGain)));
+					}
+#endif
+					for (; n < nCount; n++)
+						pDst[n] += (float)pSrc[n] * fGain;
+				}
+				else
+				{
+					// Only samples loaded before InitialiseAudio() changed the format end up here
+					for (unsigned int f = 0; f < nRun; f++)
+						for (unsigned int c = 0; c < nChannels; c++)
+							pDst[f * nChannels + c] += (float)pSrc[f * nStep * s.nChannels + std::min<int>(c, s.nChannels - 1)] * fGain;
+				}
+
+				s.nSamplePosition += nRun * nStep;
+				nFrame += nRun;
 			}
-			else
-				return 0.0f;
 		}
 
-		// If sounds have completed then remove them
-		listActiveSamples.remove_if([](const sCurrentlyPlayingSample& s) {return s.bFinished; });
+		// The users application might be generating sound, or filtering it.
+		// These are per sample by design, so only pay for them when they are set
+		if (funcUserSynth != nullptr || funcUserFilter != nullptr)
+		{
+			float fGlobalTime = m_fGlobalTime;
+			for (unsigned int f = 0; f < nFrames; f++)
+				for (unsigned int c = 0; c < nChannels; c++)
+				{
+					float& fSample = pMix[f * nChannels + c];
+					float fTime = fGlobalTime + fTimeStep * (float)f;
+					if (funcUserSynth != nullptr)
+						fSample += funcUserSynth(c, fTime, fTimeStep);
+					if (funcUserFilter != nullptr)
+						fSample = funcUserFilter(c, fTime, fSample);
+				}
+		}
+
+		// Single clip and convert pass into the device block
+		const float fMaxSample = (float)SHRT_MAX;
+		unsigned int n = 0;
+#ifdef OLC_SOUND_SSE2
+		const __m128 vMin = _mm_set1_ps(-1.0f), vMax = _mm_set1_ps(1.0f), vScale = _mm_set1_ps(fMaxSample);
+		for (; n + 8 <= nOut; n += 8)
+		{
+			__m128 a = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(pMix + n), vMin), vMax), vScale);
+			__m128 b = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(pMix + n + 4), vMin), vMax), vScale);
+			_mm_storeu_si128((__m128i*)(pBlock + n), _mm_packs_epi32(_mm_cvttps_epi32(a), _mm_cvttps_epi32(b)));
+		}
+#endif
+		for (; n < nOut; n++)
+			pBlock[n] = (short)(std::min(std::max(pMix[n], -1.0f), 1.0f) * fMaxSample);
 
-		// The users application might be generating sound, so grab that if it exists
-		if (funcUserSynth != nullptr)
-			fMixerSample += funcUserSynth(nChannel, fGlobalTime, fTimeStep);
+		unsigned int nActive = 0;
+		for (auto& v : m_Voices) nActive += v.bActive ? 1 : 0;
+		m_nStatActiveVoices.store(nActive, std::memory_order_relaxed);
 
-		// Return the sample via an optional user override to filter the sound
-		if (funcUserFilter != nullptr)
-			return funcUserFilter(nChannel, fGlobalTime, fMixerSample);
-		else
-			return fMixerSample;
+		const int64_t nMixTime = Now() - nMixStart;
+		m_nStatMixTimeLast.store(nMixTime, std::memory_order_relaxed);
+		m_nStatMixTimeTotal.fetch_add(nMixTime, std::memory_order_relaxed);
+		if (nMixTime > m_nStatMixTimeMax.load(std::memory_order_relaxed))
+			m_nStatMixTimeMax.store(nMixTime, std::memory_order_relaxed);
+
+		if (BlockObserver observer = m_pBlockObserver.load(std::memory_order_acquire))
+			observer(nMixStart, nMixStart + nMixTime, nFrames, nActive);
+	}
+
+	void SOUND::SetBlockObserver(BlockObserver observer)
+	{
+		m_pBlockObserver.store(observer, std::memory_order_release);
+	}
+
+	int64_t SOUND::Now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	void SOUND::NoteHeard(sCurrentlyPlayingSample& s)
+	{
+		if (s.nPostTime == 0) return;
+		if (m_nHeardCount < nMaxVoices)
+			m_nHeardPostTimes[m_nHeardCount++] = s.nPostTime;
+		s.nPostTime = 0;
+	}
+
+	void SOUND::SubmittedBlock()
+	{
+		const int64_t nNow = Now();
+		for (unsigned int i = 0; i < m_nHeardCount; i++)
+		{
+			int64_t nMs = (nNow - m_nHeardPostTimes[i]) / 1000000;
+			int nBucket = 0;
+			while (nBucket < sAudioStats::nLatencyBuckets - 1 && nMs >= (int64_t(1) << nBucket))
+				nBucket++;
+			m_nStatLatency[nBucket].fetch_add(1, std::memory_order_relaxed);
+		}
+		m_nHeardCount = 0;
+		m_nStatBlocks.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	SOUND::sAudioStats SOUND::GetStats()
+	{
+		sAudioStats stats;
+		stats.nBlocks = m_nStatBlocks.load(std::memory_order_relaxed);
+		stats.nUnderruns = m_nStatUnderruns.load(std::memory_order_relaxed);
+		stats.nStreamStarved = m_nStatStreamStarved.load(std::memory_order_relaxed);
+		stats.nActiveVoices = m_nStatActiveVoices.load(std::memory_order_relaxed);
+		stats.fMixTimeLast = (float)m_nStatMixTimeLast.load(std::memory_order_relaxed) / 1000.0f;
+		stats.fMixTimeMax = (float)m_nStatMixTimeMax.load(std::memory_order_relaxed) / 1000.0f;
+		if (stats.nBlocks > 0)
+			stats.fMixTimeAverage = (float)m_nStatMixTimeTotal.load(std::memory_order_relaxed) / 1000.0f / (float)stats.nBlocks;
+		stats.fDeviceLatency = m_fDeviceLatency;
+		for (int i = 0; i < sAudioStats::nLatencyBuckets; i++)
+			stats.nLatency[i] = m_nStatLatency[i].load(std::memory_order_relaxed);
+		return stats;
+	}
+
+	// Only approximately atomic as a whole, the audio thread may be counting meanwhile
+	void SOUND::ResetStats()
+	{
+		m_nStatBlocks = 0;
+		m_nStatUnderruns = 0;
+		m_nStatStreamStarved = 0;
+		m_nStatMixTimeTotal = 0;
+		m_nStatMixTimeMax = 0;
+		for (auto& n : m_nStatLatency) n = 0;
+	}
+
+	void SOUND::SetBackend(Backend backend, const std::string& sFile)
+	{
+		m_Backend = backend;
+		m_sOutputFile = sFile;
+	}
+
+	SOUND::Backend SOUND::GetBackend()
+	{
+		return m_Backend;
+	}
+
+	bool SOUND::InitialiseAudio(unsigned int nSampleRate, unsigned int nChannels, unsigned int nBlocks, unsigned int nBlockSamples)
+	{
+		m_bAudioThreadActive = false;
+		m_nSampleRate = nSampleRate;
+		m_nChannels = nChannels;
+		m_fDeviceLatency = m_Backend == Backend::DEVICE ? (float)(nBlocks * (nBlockSamples / nChannels)) / (float)nSampleRate : 0.0f;
+		ResetStats();
+
+		switch (m_Backend)
+		{
+		case Backend::NONE:
+			// Commands are never consumed, once the queue is full they are dropped
+			ResetVoices();
+			return true;
+
+		case Backend::WAV_FILE:
+			ResetVoices();
+			m_ofsOutput.open(m_sOutputFile, std::ofstream::binary | std::ofstream::trunc);
+			if (!m_ofsOutput.is_open())
+				return false;
+			m_nOutputFrames = 0;
+			m_fOutputPending = 0.0;
+			m_fGlobalTime = 0.0f;
+			WriteWavHeader(); // sizes are patched in by DestroyAudio()
+			// No thread, but the mixer only keeps voices alive while this is set
+			m_bAudioThreadActive = true;
+			return true;
+
+		default:
+			return InitialiseDevice(nSampleRate, nChannels, nBlocks, nBlockSamples);
+		}
+	}
+
+	bool SOUND::DestroyAudio()
+	{
+		if (m_StreamThread.joinable())
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_muxStreams);
+				m_bStreamThreadActive = false;
+			}
+			m_cvStreams.notify_one();
+			m_StreamThread.join();
+		}
+		{
+			// a later InitialiseAudio() starts with no streams, like it starts with no voices
+			std::lock_guard<std::mutex> lock(m_muxStreams);
+			m_vStreams.clear();
+		}
+
+		if (m_Backend == Backend::DEVICE)
+			return DestroyDevice();
+
+		m_bAudioThreadActive = false;
+		if (m_ofsOutput.is_open())
+		{
+			m_ofsOutput.seekp(0);
+			WriteWavHeader();
+			m_ofsOutput.close();
+		}
+		return false;
+	}
+
+	void SOUND::Advance(float fElapsedTime)
+	{
+		if (m_Backend != Backend::WAV_FILE || !m_ofsOutput.is_open())
+			return;
+
+		// Whole frames only, the rest carries over so no time is lost between calls
+		m_fOutputPending += (double)fElapsedTime * (double)m_nSampleRate;
+		unsigned int nFrames = (unsigned int)m_fOutputPending;
+		m_fOutputPending -= (double)nFrames;
+
+		const unsigned int nMaxBlock = 1024;
+		const float fTimeStep = 1.0f / (float)m_nSampleRate;
+		m_vOutputBlock.resize(nMaxBlock * m_nChannels);
+		std::vector<char> vChunk;
+		while (nFrames > 0)
+		{
+			unsigned int nBlock = std::min(nFrames, nMaxBlock);
+			{
+				// Nothing to keep up with here, so top the streams up first rather than
+				// ever underrun. That keeps the output the same from run to run
+				std::lock_guard<std::mutex> lock(m_muxStreams);
+				for (auto& stream : m_vStreams)
+					while (FillStream(*stream, vChunk));
+			}
+			MixBlock(m_vOutputBlock.data(), nBlock, m_nChannels, fTimeStep);
+			m_ofsOutput.write((const char*)m_vOutputBlock.data(), nBlock * m_nChannels * sizeof(short));
+			SubmittedBlock();
+			m_fGlobalTime = m_fGlobalTime + fTimeStep * (float)nBlock;
+			m_nOutputFrames += nBlock;
+			nFrames -= nBlock;
+		}
+	}
+
+	// Canonical 44 byte header for 16-bit PCM, written at the current position
+	void SOUND::WriteWavHeader()
+	{
+		auto Write16 = [](uint16_t n) { m_ofsOutput.write((const char*)&n, sizeof(n)); };
+		auto Write32 = [](uint32_t n) { m_ofsOutput.write((const char*)&n, sizeof(n)); };
+		const uint32_t nDataSize = m_nOutputFrames * m_nChannels * sizeof(short);
+
+		m_ofsOutput.write("RIFF", 4);
+		Write32(36 + nDataSize);
+		m_ofsOutput.write("WAVEfmt ", 8);
+		Write32(16);
+		Write16(1); // PCM
+		Write16((uint16_t)m_nChannels);
+		Write32(m_nSampleRate);
+		Write32(m_nSampleRate * m_nChannels * sizeof(short));
+		Write16((uint16_t)(m_nChannels * sizeof(short)));
+		Write16(16);
+		m_ofsOutput.write("data", 4);
+		Write32(nDataSize);
+	}
+
+	// Audio thread, streams arrive in the output layout so this is a plain copy out of the ring
+	void SOUND::MixStream(sCurrentlyPlayingSample& s, float* pMix, unsigned int nFrames, unsigned int nChannels)
+	{
+		AudioStream& stream = *s.pStream;
+		auto Finish = [&] { s.bFinished = true; s.bActive = false; };
+
+		if (stream.nGeneration.load(std::memory_order_acquire) != s.nStreamGeneration)
+			return Finish(); // played again since, that voice takes over
+
+		if (!s.bStreamStarted)
+		{
+			if (stream.nReadyGeneration.load(std::memory_order_acquire) != s.nStreamGeneration)
+				return; // the stream thread hasn't rewound yet
+			stream.nRead.store(stream.nGenerationStart.load(std::memory_order_relaxed), std::memory_order_release);
+			s.bStreamStarted = true;
+		}
+
+		const uint64_t nRead = stream.nRead.load(std::memory_order_relaxed);
+		const uint64_t nAvailable = stream.nWritten.load(std::memory_order_acquire) - nRead;
+		const unsigned int nCount = (unsigned int)std::min<uint64_t>(nFrames, nAvailable);
+		const float fGain = s.fVolume / 32768.0f;
+		for (unsigned int f = 0; f < nCount; f++)
+		{
+			const short* pSrc = stream.vRing.data() + (size_t)((nRead + f) & (AudioStream::nRingFrames - 1)) * nChannels;
+			for (unsigned int c = 0; c < nChannels; c++)
+				pMix[f * nChannels + c] += (float)pSrc[c] * fGain;
+		}
+		stream.nRead.store(nRead + nCount, std::memory_order_release);
+
+		if (nRead + nCount == stream.nEnd.load(std::memory_order_acquire))
+			Finish();
+		else if (nCount < nFrames)
+			m_nStatStreamStarved.fetch_add(1, std::memory_order_relaxed);
 	}
 
 	std::thread SOUND::m_AudioThread;
 	std::atomic<bool> SOUND::m_bAudioThreadActive{ false };
 	std::atomic<float> SOUND::m_fGlobalTime{ 0.0f };
-	std::list<SOUND::sCurrentlyPlayingSample> SOUND::listActiveSamples;
+	SOUND::sCurrentlyPlayingSample SOUND::m_Voices[SOUND::nMaxVoices];
+	SOUND::sCommand SOUND::m_Commands[SOUND::nCommandQueueSize];
+	std::atomic<unsigned int> SOUND::m_nCommandHead{ 0 };
+	std::atomic<unsigned int> SOUND::m_nCommandTail{ 0 };
+	std::vector<float> SOUND::m_vMixBuffer;
+	unsigned int SOUND::m_nNextSerial = 0;
+	unsigned int SOUND::m_nSampleRate = 44100;
+	unsigned int SOUND::m_nChannels = 1;
+	std::string SOUND::m_sSampleCache;
+	SOUND::Backend SOUND::m_Backend = SOUND::Backend::DEVICE;
+	std::string SOUND::m_sOutputFile;
+	std::ofstream SOUND::m_ofsOutput;
+	uint32_t SOUND::m_nOutputFrames = 0;
+	double SOUND::m_fOutputPending = 0.0;
+	std::vector<short> SOUND::m_vOutputBlock;
+	std::vector<std::shared_ptr<SOUND::AudioStream>> SOUND::m_vStreams;
+	std::thread SOUND::m_StreamThread;
+	bool SOUND::m_bStreamThreadActive = false;
+	std::mutex SOUND::m_muxStreams;
+	std::condition_variable SOUND::m_cvStreams;
+	std::atomic<uint64_t> SOUND::m_nStatBlocks{ 0 };
+	std::atomic<uint64_t> SOUND::m_nStatUnderruns{ 0 };
+	std::atomic<uint64_t> SOUND::m_nStatStreamStarved{ 0 };
+	std::atomic<unsigned int> SOUND::m_nStatActiveVoices{ 0 };
+	std::atomic<int64_t> SOUND::m_nStatMixTimeLast{ 0 };
+	std::atomic<int64_t> SOUND::m_nStatMixTimeTotal{ 0 };
+	std::atomic<int64_t> SOUND::m_nStatMixTimeMax{ 0 };
+	std::atomic<uint64_t> SOUND::m_nStatLatency[SOUND::sAudioStats::nLatencyBuckets];
+	std::atomic<SOUND::BlockObserver> SOUND::m_pBlockObserver{ nullptr };
+	float SOUND::m_fDeviceLatency = 0.0f;
+	int64_t SOUND::m_nHeardPostTimes[SOUND::nMaxVoices];
+	unsigned int SOUND::m_nHeardCount = 0;
+	std::atomic<unsigned int> SOUND::m_nVoiceLimit{ SOUND::nMaxVoices };
 	std::function<float(int, float, float)> SOUND::funcUserSynth = nullptr;
 	std::function<float(int, float, float)> SOUND::funcUserFilter = nullptr;
 }
@@ -436,12 +1393,10 @@ namespace olc
 
 namespace olc
 {
-	bool SOUND::InitialiseAudio(unsigned int nSampleRate, unsigned int nChannels, unsigned int nBlocks, unsigned int nBlockSamples)
+	bool SOUND::InitialiseDevice(unsigned int nSampleRate, unsigned int nChannels, unsigned int nBlocks, unsigned int nBlockSamples)
 	{
 		// Initialise Sound Engine
 		m_bAudioThreadActive = false;
-		m_nSampleRate = nSampleRate;
-		m_nChannels = nChannels;
 		m_nBlockCount = nBlocks;
 		m_nBlockSamples = nBlockSamples;
 		m_nBlockFree = m_nBlockCount;
@@ -459,21 +1414,21 @@ namespace olc
 		waveFormat.nAvgBytesPerSec = waveFormat.nSamplesPerSec * waveFormat.nBlockAlign;
 		waveFormat.cbSize = 0;
 
-		listActiveSamples.clear();
+		ResetVoices();
 
 		// Open Device if valid
 		if (waveOutOpen(&m_hwDevice, WAVE_MAPPER, &waveFormat, (DWORD_PTR)SOUND::waveOutProc, (DWORD_PTR)0, CALLBACK_FUNCTION) != S_OK)
-			return DestroyAudio();
+			return DestroyDevice();
 
 		// Allocate Wave|Block Memory
 		m_pBlockMemory = new short[m_nBlockCount * m_nBlockSamples];
 		if (m_pBlockMemory == nullptr)
-			return DestroyAudio();
+			return DestroyDevice();
 		ZeroMemory(m_pBlockMemory, sizeof(short) * m_nBlockCount * m_nBlockSamples);
 
 		m_pWaveHeaders = new WAVEHDR[m_nBlockCount];
 		if (m_pWaveHeaders == nullptr)
-			return DestroyAudio();
+			return DestroyDevice();
 		ZeroMemory(m_pWaveHeaders, sizeof(WAVEHDR) * m_nBlockCount);
 
 		// Link headers to block memory
@@ -493,7 +1448,7 @@ namespace olc
 	}
 
 	// Stop and clean up audio system
-	bool SOUND::DestroyAudio()
+	bool SOUND::DestroyDevice()
 	{
 		m_bAudioThreadActive = false;
 		if (m_AudioThread.joinable())
@@ -519,16 +1474,16 @@ namespace olc
 		m_fGlobalTime = 0.0f;
 		static float fTimeStep = 1.0f / (float)m_nSampleRate;
 
-		// Goofy hack to get maximum integer for a type at run-time
-		short nMaxSample = (short)pow(2, (sizeof(short) * 8) - 1) - 1;
-		float fMaxSample = (float)nMaxSample;
-		short nPreviousSample = 0;
-
 		auto tp1 = std::chrono::system_clock::now();
 		auto tp2 = std::chrono::system_clock::now();
+		uint64_t nSubmitted = 0;
 
 		while (m_bAudioThreadActive)
 		{
+			// Every block handed over has played out, so the device has been starving
+			if (m_nBlockFree == m_nBlockCount && nSubmitted >= m_nBlockCount)
+				m_nStatUnderruns++;
+
 			// Wait for block to become available
 			if (m_nBlockFree == 0)
 			{
@@ -544,17 +1499,8 @@ namespace olc
 			if (m_pWaveHeaders[m_nBlockCurrent].dwFlags & WHDR_PREPARED)
 				waveOutUnprepareHeader(m_hwDevice, &m_pWaveHeaders[m_nBlockCurrent], sizeof(WAVEHDR));
 
-			short nNewSample = 0;
 			int nCurrentBlock = m_nBlockCurrent * m_nBlockSamples;
 
-			auto clip = [](float fSample, float fMax)
-			{
-				if (fSample >= 0.0)
-					return fmin(fSample, fMax);
-				else
-					return fmax(fSample, -fMax);
-			};
-
 			tp2 = std::chrono::system_clock::now();
 			std::chrono::duration<float> elapsedTime = tp2 - tp1;
 			tp1 = tp2;
@@ -562,29 +1508,20 @@ namespace olc
 			// Our time per frame coefficient
 			float fElapsedTime = elapsedTime.count();
 
-			for (unsigned int n = 0; n < m_nBlockSamples; n += m_nChannels)
-			{
-				// User Process
-				for (unsigned int c = 0; c < m_nChannels; c++)
-				{
-					nNewSample = (short)(clip(GetMixerOutput(c, m_fGlobalTime + fTimeStep * (float)n, fTimeStep), 1.0) * fMaxSample);
-					m_pBlockMemory[nCurrentBlock + n + c] = nNewSample;
-					nPreviousSample = nNewSample;
-				}
-			}
+			MixBlock(m_pBlockMemory + nCurrentBlock, m_nBlockSamples / m_nChannels, m_nChannels, fTimeStep);
 
 			m_fGlobalTime = m_fGlobalTime + fTimeStep * (float)m_nBlockSamples;
 
 			// Send block to sound device
 			waveOutPrepareHeader(m_hwDevice, &m_pWaveHeaders[m_nBlockCurrent], sizeof(WAVEHDR));
 			waveOutWrite(m_hwDevice, &m_pWaveHeaders[m_nBlockCurrent], sizeof(WAVEHDR));
+			SubmittedBlock();
+			nSubmitted++;
 			m_nBlockCurrent++;
 			m_nBlockCurrent %= m_nBlockCount;
 		}
 	}
 
-	unsigned int SOUND::m_nSampleRate = 0;
-	unsigned int SOUND::m_nChannels = 0;
 	unsigned int SOUND::m_nBlockCount = 0;
 	unsigned int SOUND::m_nBlockSamples = 0;
 	unsigned int SOUND::m_nBlockCurrent = 0;
@@ -600,19 +1537,17 @@ namespace olc
 
 namespace olc
 {
-	bool SOUND::InitialiseAudio(unsigned int nSampleRate, unsigned int nChannels, unsigned int nBlocks, unsigned int nBlockSamples)
+	bool SOUND::InitialiseDevice(unsigned int nSampleRate, unsigned int nChannels, unsigned int nBlocks, unsigned int nBlockSamples)
 	{
 		// Initialise Sound Engine
 		m_bAudioThreadActive = false;
-		m_nSampleRate = nSampleRate;
-		m_nChannels = nChannels;
 		m_nBlockSamples = nBlockSamples;
 		m_pBlockMemory = nullptr;
 
 		// Open PCM stream
 		int rc = snd_pcm_open(&m_pPCM, "default", SND_PCM_STREAM_PLAYBACK, 0);
 		if (rc < 0)
-			return DestroyAudio();
+			return DestroyDevice();
 
 
 		// Prepare the parameter structure and set default parameters
@@ -631,14 +1566,14 @@ namespace olc
 		// Save these parameters
 		rc = snd_pcm_hw_params(m_pPCM, params);
 		if (rc < 0)
-			return DestroyAudio();
+			return DestroyDevice();
 
-		listActiveSamples.clear();
+		ResetVoices();
 
 		// Allocate Wave|Block Memory
 		m_pBlockMemory = new short[m_nBlockSamples];
 		if (m_pBlockMemory == nullptr)
-			return DestroyAudio();
+			return DestroyDevice();
 		std::fill(m_pBlockMemory, m_pBlockMemory + m_nBlockSamples, 0);
 
 		// Unsure if really needed, helped prevent underrun on my setup
@@ -654,7 +1589,7 @@ namespace olc
 	}
 
 	// Stop and clean up audio system
-	bool SOUND::DestroyAudio()
+	bool SOUND::DestroyDevice()
 	{
 		m_bAudioThreadActive = false;
 		if (m_AudioThread.joinable())
@@ -674,38 +1609,14 @@ namespace olc
 		m_fGlobalTime = 0.0f;
 		static float fTimeStep = 1.0f / (float)m_nSampleRate;
 
-		// Goofy hack to get maximum integer for a type at run-time
-		short nMaxSample = (short)pow(2, (sizeof(short) * 8) - 1) - 1;
-		float fMaxSample = (float)nMaxSample;
-		short nPreviousSample = 0;
-
 		while (m_bAudioThreadActive)
 		{
-			short nNewSample = 0;
-
-			auto clip = [](float fSample, float fMax)
-			{
-				if (fSample >= 0.0)
-					return fmin(fSample, fMax);
-				else
-					return fmax(fSample, -fMax);
-			};
-
-			for (unsigned int n = 0; n < m_nBlockSamples; n += m_nChannels)
-			{
-				// User Process
-				for (unsigned int c = 0; c < m_nChannels; c++)
-				{
-					nNewSample = (short)(GetMixerOutput(c, m_fGlobalTime + fTimeStep * (float)n, fTimeStep), 1.0) * fMaxSample;
-					m_pBlockMemory[n + c] = nNewSample;
-					nPreviousSample = nNewSample;
-				}
-			}
+			MixBlock(m_pBlockMemory, m_nBlockSamples / m_nChannels, m_nChannels, fTimeStep);
 
 			m_fGlobalTime = m_fGlobalTime + fTimeStep * (float)m_nBlockSamples;
 
-			// Send block to sound device
-			snd_pcm_uframes_t nLeft = m_nBlockSamples;
+			// Send block to sound device, in frames rather than samples
+			snd_pcm_uframes_t nLeft = m_nBlockSamples / m_nChannels;
 			short* pBlockPos = m_pBlockMemory;
 			while (nLeft > 0)
 			{
@@ -717,14 +1628,16 @@ namespace olc
 				}
 				if (rc == -EAGAIN) continue;
 				if (rc == -EPIPE) // an underrun occured, prepare the device for more data
+				{
+					m_nStatUnderruns++;
 					snd_pcm_prepare(m_pPCM);
+				}
 			}
+			SubmittedBlock();
 		}
 	}
 
 	snd_pcm_t* SOUND::m_pPCM = nullptr;
-	unsigned int SOUND::m_nSampleRate = 0;
-	unsigned int SOUND::m_nChannels = 0;
 	unsigned int SOUND::m_nBlockSamples = 0;
 	short* SOUND::m_pBlockMemory = nullptr;
 }
@@ -733,12 +1646,10 @@ namespace olc
 
 namespace olc
 {
-	bool SOUND::InitialiseAudio(unsigned int nSampleRate, unsigned int nChannels, unsigned int nBlocks, unsigned int nBlockSamples)
+	bool SOUND::InitialiseDevice(unsigned int nSampleRate, unsigned int nChannels, unsigned int nBlocks, unsigned int nBlockSamples)
 	{
 		// Initialise Sound Engine
 		m_bAudioThreadActive = false;
-		m_nSampleRate = nSampleRate;
-		m_nChannels = nChannels;
 		m_nBlockCount = nBlocks;
 		m_nBlockSamples = nBlockSamples;
 		m_pBlockMemory = nullptr;
@@ -751,7 +1662,7 @@ namespace olc
 			alcMakeContextCurrent(m_pContext);
 		}
 		else
-			return DestroyAudio();
+			return DestroyDevice();
 
 		// Allocate memory for sound data
 		alGetError();
@@ -762,12 +1673,12 @@ namespace olc
 		for (unsigned int i = 0; i < m_nBlockCount; i++)
 			m_qAvailableBuffers.push(m_pBuffers[i]);
 
-		listActiveSamples.clear();
+		ResetVoices();
 
 		// Allocate Wave|Block Memory
 		m_pBlockMemory = new short[m_nBlockSamples];
 		if (m_pBlockMemory == nullptr)
-			return DestroyAudio();
+			return DestroyDevice();
 		std::fill(m_pBlockMemory, m_pBlockMemory + m_nBlockSamples, 0);
 
 		m_bAudioThreadActive = true;
@@ -776,7 +1687,7 @@ namespace olc
 	}
 
 	// Stop and clean up audio system
-	bool SOUND::DestroyAudio()
+	bool SOUND::DestroyDevice()
 	{
 		m_bAudioThreadActive = false;
 		if (m_AudioThread.joinable())
@@ -802,12 +1713,8 @@ namespace olc
 		m_fGlobalTime = 0.0f;
 		static float fTimeStep = 1.0f / (float)m_nSampleRate;
 
-		// Goofy hack to get maximum integer for a type at run-time
-		short nMaxSample = (short)pow(2, (sizeof(short) * 8) - 1) - 1;
-		float fMaxSample = (float)nMaxSample;
-		short nPreviousSample = 0;
-
 		std::vector<ALuint> vProcessed;
+		bool bStarted = false;
 
 		while (m_bAudioThreadActive)
 		{
@@ -823,28 +1730,8 @@ namespace olc
 			// Wait until there is a free buffer (ewww)
 			if (m_qAvailableBuffers.empty()) continue;
 
-			short nNewSample = 0;
-
-			auto clip = [](float fSample, float fMax)
-			{
-				if (fSample >= 0.0)
-					return fmin(fSample, fMax);
-				else
-					return fmax(fSample, -fMax);
-			};
-
-			for (unsigned int n = 0; n < m_nBlockSamples; n += m_nChannels)
-			{
-				// User Process
-				for (unsigned int c = 0; c < m_nChannels; c++)
-				{
-					nNewSample = (short)(clip(GetMixerOutput(c, m_fGlobalTime, fTimeStep), 1.0) * fMaxSample);
-					m_pBlockMemory[n + c] = nNewSample;
-					nPreviousSample = nNewSample;
-				}
-
-				m_fGlobalTime = m_fGlobalTime + fTimeStep;
-			}
+			MixBlock(m_pBlockMemory, m_nBlockSamples / m_nChannels, m_nChannels, fTimeStep);
+			m_fGlobalTime = m_fGlobalTime + fTimeStep * (float)(m_nBlockSamples / m_nChannels);
 
 			// Fill OpenAL data buffer
 			alBufferData(
@@ -858,10 +1745,16 @@ namespace olc
 			alSourceQueueBuffers(m_nSource, 1, &m_qAvailableBuffers.front());
 			// Remove it from ours
 			m_qAvailableBuffers.pop();
+			SubmittedBlock();
 
-			// If it's not playing for some reason, change that
+			// If it's not playing for some reason, change that. Once it has
+			// started, the only reason is that it ran out of buffers
 			if (nState != AL_PLAYING)
+			{
+				if (bStarted) m_nStatUnderruns++;
 				alSourcePlay(m_nSource);
+				bStarted = true;
+			}
 		}
 	}
 
@@ -870,8 +1763,6 @@ namespace olc
 	ALuint SOUND::m_nSource = 0;
 	ALCdevice* SOUND::m_pDevice = nullptr;
 	ALCcontext* SOUND::m_pContext = nullptr;
-	unsigned int SOUND::m_nSampleRate = 0;
-	unsigned int SOUND::m_nChannels = 0;
 	unsigned int SOUND::m_nBlockCount = 0;
 	unsigned int SOUND::m_nBlockSamples = 0;
 	short* SOUND::m_pBlockMemory = nullptr;
@@ -881,13 +1772,14 @@ namespace olc
 
 namespace olc
 {
-	bool SOUND::InitialiseAudio(unsigned int nSampleRate, unsigned int nChannels, unsigned int nBlocks, unsigned int nBlockSamples)
+	bool SOUND::InitialiseDevice(unsigned int, unsigned int, unsigned int, unsigned int)
 	{
-		return true;
+		// No sound API on this platform, only the NONE and WAV_FILE backends work
+		return false;
 	}
 
 	// Stop and clean up audio system
-	bool SOUND::DestroyAudio()
+	bool SOUND::DestroyDevice()
 	{
 		return false;
 	}
@@ -350,12 +350,15 @@ int main()
 #include <list>
 #include <thread>
 #include <atomic>
+#include <mutex>
+#include <condition_variable>
 #include <fstream>
 #include <map>
 #include <functional>
 #include <algorithm>
 #include <array>
 #include <cstring>
+#include <cstdio>
 #pragma endregion
 
 #define PGE_VER 216
@@ -451,7 +454,7 @@ namespace _gfs = std::filesystem;
 // O------------------------------------------------------------------------------O
 // | PLATFORM-SPECIFIC DEPENDENCIES                                               |
 // O------------------------------------------------------------------------------O
-#if !defined(OLC_PGE_HEADLESS)
+// Windows headers are still needed by the GDI+ image loader when headless
 #if defined(OLC_PLATFORM_WINAPI)	
 #define _WINSOCKAPI_ // Thanks Cornchipss
 #if !defined(VC_EXTRALEAN)
@@ -474,6 +477,7 @@ namespace _gfs = std::filesystem;
 #undef _WINSOCKAPI_
 #endif
 
+#if !defined(OLC_PGE_HEADLESS)
 #if defined(OLC_PLATFORM_X11)
 namespace X11
 {
@@ -697,10 +701,24 @@ namespace olc
 	// O------------------------------------------------------------------------------O
 	struct ResourceBuffer : public std::streambuf
 	{
-		ResourceBuffer(std::ifstream& ifs, uint32_t offset, uint32_t size);
+		ResourceBuffer(const char* data, uint32_t size);
 		std::vector<char> vMemory;
 	};
 
+	// A read-only, seekable window straight into a loaded pack, nothing is copied.
+	// Only valid for as long as the pack stays loaded
+	struct ResourceView : public std::streambuf
+	{
+		ResourceView(const char* data = nullptr, uint32_t size = 0);
+		const char* Data() const { return eback(); }
+		uint32_t Size() const { return uint32_t(egptr() - eback()); }
+	protected:
+		pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+		pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+	};
+
+	// The pack file is memory mapped once by LoadPack(), every file is then served from
+	// that mapping. Safe to read from several threads at once, as long as nothing is added
 	class ResourcePack : public std::streambuf
 	{
 	public:
@@ -710,11 +728,19 @@ namespace olc
 		bool LoadPack(const std::string& sFile, const std::string& sKey);
 		bool SavePack(const std::string& sFile, const std::string& sKey);
 		ResourceBuffer GetFileBuffer(const std::string& sFile);
+		ResourceView GetFileView(const std::string& sFile);
+		bool Contains(const std::string& sFile) const;
 		bool Loaded();
 	private:
 		struct sResourceFile { uint32_t nSize; uint32_t nOffset; };
 		std::map<std::string, sResourceFile> mapFiles;
-		std::ifstream baseFile;
+		const char* pBase = nullptr;
+		size_t nBaseSize = 0;
+		void* pMapping = nullptr; // platform handle of the mapping, if there is one
+		std::vector<char> vBase;  // fallback when the file can't be mapped
+		bool MapFile(const std::string& sFile);
+		void UnmapFile();
+		const sResourceFile* Find(const std::string& sFile) const;
 		std::vector<char> scramble(const std::vector<char>& data, const std::string& key);
 		std::string makeposix(const std::string& path);
 	};
@@ -882,6 +908,41 @@ namespace olc
 		static olc::PixelGameEngine* ptrPGE;
 	};
 
+	// O------------------------------------------------------------------------------O
+	// | olc::FrameSink - Receives every composited frame when running offscreen      |
+	// O------------------------------------------------------------------------------O
+	class FrameSink
+	{
+	public:
+		virtual ~FrameSink() = default;
+		// Return false to stop the engine, e.g. when the consumer has gone away
+		virtual bool WriteFrame(const olc::Sprite* frame, uint32_t nFrame) = 0;
+	};
+
+	// Writes each frame to "<prefix>000000.png", "<prefix>000001.png", ...
+	class FrameSink_PNG : public FrameSink
+	{
+	public:
+		FrameSink_PNG(const std::string& sPrefix);
+		bool WriteFrame(const olc::Sprite* frame, uint32_t nFrame) override;
+	private:
+		std::string sPrefix;
+	};
+
+	// Streams raw 8-bit RGBA frames, top row first, e.g. into an external encoder
+	class FrameSink_RawRGBA : public FrameSink
+	{
+	public:
+		FrameSink_RawRGBA(std::FILE* file);
+		bool WriteFrame(const olc::Sprite* frame, uint32_t nFrame) override;
+	private:
+		std::FILE* file = nullptr;
+	};
+
+	// Encodes a sprite as a PNG using stored (uncompressed) deflate blocks, so
+	// it needs no image library and costs little more than a memcpy
+	olc::rcode SavePNG(const olc::Sprite* spr, std::ostream& os);
+
 	class PGEX;
 
 	// The Static Twins (plus one)
@@ -900,6 +961,11 @@ namespace olc
 	public:
 		olc::rcode Construct(int32_t screen_w, int32_t screen_h, int32_t pixel_w, int32_t pixel_h,
 			bool full_screen = false, bool vsync = false, bool cohesion = false);
+		// As Construct(), but runs without a window or graphics device. Layers and decals are
+		// composited in software and every finished frame is handed to sink (may be nullptr).
+		// A non-zero fixed_step replaces the wall clock, a non-zero max_frames stops the engine
+		olc::rcode ConstructOffscreen(int32_t screen_w, int32_t screen_h, olc::FrameSink* sink = nullptr,
+			float fixed_step = 0.0f, uint32_t max_frames = 0);
 		olc::rcode Start();
 
 	public: // User Override Interfaces
@@ -954,6 +1020,17 @@ namespace olc
 		const olc::vi2d& GetPixelSize() const;
 		// Gets actual pixel scale
 		const olc::vi2d& GetScreenPixelSize() const;
+		// Caps the update rate to a target FPS, 0 runs as fast as possible
+		void SetFrameLimit(uint32_t fps);
+		// Requests a low refresh rate for the next frame only, call it every frame
+		// nothing on screen is changing. Input events cut the wait short
+		void SetIdle(bool idle, uint32_t fps = 10);
+		// Times the engine's own part of each frame, off unless asked for
+		void SetCoreTiming(bool enable);
+		// Seconds the last frame spent uploading and drawing layers and decals, 0 if not timed
+		float GetLayerTime() const;
+		// Seconds the last frame spent presenting it (a buffer swap, or the frame sink)
+		float GetPresentTime() const;
 
 	public: // CONFIGURATION ROUTINES
 		// Layer targeting functions
@@ -1089,6 +1166,17 @@ namespace olc
 		bool		bEnableVSYNC = false;
 		float		fFrameTimer = 1.0f;
 		float		fLastElapsed = 0.0f;
+		float		fFixedElapsedTime = 0.0f;
+		uint32_t	nFrameLimit = 0;
+		uint32_t	nIdleFrameRate = 10;
+		bool		bIdle = false;
+		bool		bCoreTiming = false;
+		float		fLayerTime = 0.0f;
+		float		fPresentTime = 0.0f;
+		std::chrono::time_point<std::chrono::steady_clock> m_tpNextFrame;
+		std::mutex	muxInputEvent;
+		std::condition_variable cvInputEvent;
+		std::atomic<bool> bInputEvent = { false };
 		int			nFrameCount = 0;
 		Sprite* fontSprite = nullptr;
 		Decal* fontDecal = nullptr;
@@ -1113,6 +1201,10 @@ namespace olc
 
 		// The main engine thread
 		void		EngineThread();
+		// Waits out the rest of the frame according to the limiter and idle state
+		void		olc_PaceFrame();
+		// Wakes the engine thread if it is waiting while idle
+		void		olc_NotifyInput();
 
 
 		// If anything sets this flag to false, the engine
@@ -1185,6 +1277,16 @@ namespace olc
 #ifdef OLC_PGE_APPLICATION
 #undef OLC_PGE_APPLICATION
 
+// Resource packs are memory mapped
+#if defined(_WIN32)
+#include <windows.h>
+#elif !defined(__EMSCRIPTEN__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 // O------------------------------------------------------------------------------O
 // | olcPixelGameEngine INTERFACE IMPLEMENTATION (CORE)                           |
 // | Note: The core implementation is platform independent                        |
@@ -1508,15 +1610,35 @@ namespace olc
 	//=============================================================
 	// Resource Packs - Allows you to store files in one large 
 	// scrambled file - Thanks MaGetzUb for debugging a null char in std::stringstream bug
-	ResourceBuffer::ResourceBuffer(std::ifstream& ifs, uint32_t offset, uint32_t size)
+	ResourceBuffer::ResourceBuffer(const char* data, uint32_t size)
 	{
-		vMemory.resize(size);
-		ifs.seekg(offset); ifs.read(vMemory.data(), vMemory.size());
+		vMemory.assign(data, data + size);
 		setg(vMemory.data(), vMemory.data(), vMemory.data() + size);
 	}
 
+	ResourceView::ResourceView(const char* data, uint32_t size)
+	{
+		char* p = const_cast<char*>(data); // only ever read through
+		setg(p, p, p + size);
+	}
+
+	ResourceView::pos_type ResourceView::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+	{
+		if (!(which & std::ios_base::in)) return pos_type(off_type(-1));
+		off_type base = dir == std::ios_base::beg ? 0 : dir == std::ios_base::cur ? off_type(gptr() - eback()) : off_type(egptr() - eback());
+		return seekpos(pos_type(base + off), which);
+	}
+
+	ResourceView::pos_type ResourceView::seekpos(pos_type pos, std::ios_base::openmode which)
+	{
+		off_type off = off_type(pos);
+		if (!(which & std::ios_base::in) || off < 0 || off > egptr() - eback()) return pos_type(off_type(-1));
+		setg(eback(), eback() + off, egptr());
+		return pos;
+	}
+
 	ResourcePack::ResourcePack() { }
-	ResourcePack::~ResourcePack() { baseFile.close(); }
+	ResourcePack::~ResourcePack() { UnmapFile(); }
 
 	bool ResourcePack::AddFile(const std::string& sFile)
 	{
@@ -1535,47 +1657,46 @@ namespace olc
 
 	bool ResourcePack::LoadPack(const std::string& sFile, const std::string& sKey)
 	{
-		// Open the resource file
-		baseFile.open(sFile, std::ifstream::binary);
-		if (!baseFile.is_open()) return false;
+		// Map the whole resource file, one open for every file in it
+		UnmapFile();
+		mapFiles.clear();
+		if (!MapFile(sFile)) return false;
 
 		// 1) Read Scrambled index
 		uint32_t nIndexSize = 0;
-		baseFile.read((char*)&nIndexSize, sizeof(uint32_t));
-
-		std::vector<char> buffer(nIndexSize);
-		for (uint32_t j = 0; j < nIndexSize; j++)
-			buffer[j] = baseFile.get();
+		if (nBaseSize < sizeof(uint32_t)) { UnmapFile(); return false; }
+		memcpy(&nIndexSize, pBase, sizeof(uint32_t));
+		if (nIndexSize > nBaseSize - sizeof(uint32_t)) { UnmapFile(); return false; }
 
+		std::vector<char> buffer(pBase + sizeof(uint32_t), pBase + sizeof(uint32_t) + nIndexSize);
 		std::vector<char> decoded = scramble(buffer, sKey);
 		size_t pos = 0;
 		auto read = [&decoded, &pos](char* dst, size_t size) {
+			if (pos + size > decoded.size()) { memset(dst, 0, size); pos = decoded.size(); return false; }
 			memcpy((void*)dst, (const void*)(decoded.data() + pos), size);
 			pos += size;
+			return true;
 		};
 
-		auto get = [&read]() -> int { char c; read(&c, 1); return c; };
-
 		// 2) Read Map
 		uint32_t nMapEntries = 0;
 		read((char*)&nMapEntries, sizeof(uint32_t));
 		for (uint32_t i = 0; i < nMapEntries; i++)
 		{
 			uint32_t nFilePathSize = 0;
-			read((char*)&nFilePathSize, sizeof(uint32_t));
+			if (!read((char*)&nFilePathSize, sizeof(uint32_t)) || nFilePathSize > decoded.size() - pos) break;
 
 			std::string sFileName(nFilePathSize, ' ');
-			for (uint32_t j = 0; j < nFilePathSize; j++)
-				sFileName[j] = get();
+			read(&sFileName[0], nFilePathSize);
 
 			sResourceFile e;
 			read((char*)&e.nSize, sizeof(uint32_t));
-			read((char*)&e.nOffset, sizeof(uint32_t));
+			if (!read((char*)&e.nOffset, sizeof(uint32_t))) break;
+			if (e.nOffset > nBaseSize || e.nSize > nBaseSize - e.nOffset) continue; // truncated pack
 			mapFiles[sFileName] = e;
 		}
 
-		// Don't close base file! we will provide a stream
-		// pointer when the file is requested
+		// Keep the mapping, files are served straight from it
 		return true;
 	}
 
@@ -1655,20 +1776,102 @@ namespace olc
 
 	ResourceBuffer ResourcePack::GetFileBuffer(const std::string& sFile)
 	{
-		return ResourceBuffer(baseFile, mapFiles[sFile].nOffset, mapFiles[sFile].nSize);
+		const sResourceFile* e = Find(sFile);
+		return e ? ResourceBuffer(pBase + e->nOffset, e->nSize) : ResourceBuffer(nullptr, 0);
+	}
+
+	ResourceView ResourcePack::GetFileView(const std::string& sFile)
+	{
+		const sResourceFile* e = Find(sFile);
+		return e ? ResourceView(pBase + e->nOffset, e->nSize) : ResourceView();
+	}
+
+	bool ResourcePack::Contains(const std::string& sFile) const
+	{
+		return Find(sFile) != nullptr;
 	}
 
 	bool ResourcePack::Loaded()
 	{
-		return baseFile.is_open();
+		return pBase != nullptr;
 	}
 
+	const ResourcePack::sResourceFile* ResourcePack::Find(const std::string& sFile) const
+	{
+		if (pBase == nullptr) return nullptr;
+		auto it = mapFiles.find(sFile);
+		return it == mapFiles.end() ? nullptr : &it->second;
+	}
+
+	bool ResourcePack::MapFile(const std::string& sFile)
+	{
+#if defined(_WIN32)
+		HANDLE hFile = CreateFileA(sFile.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (hFile == INVALID_HANDLE_VALUE) return false;
+		LARGE_INTEGER nSize;
+		if (GetFileSizeEx(hFile, &nSize) && nSize.QuadPart > 0)
+		{
+			HANDLE hMapping = CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (hMapping != nullptr)
+			{
+				pBase = (const char*)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+				if (pBase != nullptr) { pMapping = hMapping; nBaseSize = (size_t)nSize.QuadPart; }
+				else CloseHandle(hMapping);
+			}
+		}
+		CloseHandle(hFile); // the mapping keeps the file open
+		if (pBase != nullptr) return true;
+#elif !defined(__EMSCRIPTEN__)
+		int fd = open(sFile.c_str(), O_RDONLY);
+		if (fd < 0) return false;
+		struct stat st;
+		if (fstat(fd, &st) == 0 && st.st_size > 0)
+		{
+			void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (p != MAP_FAILED) { pBase = (const char*)p; nBaseSize = (size_t)st.st_size; pMapping = p; }
+		}
+		close(fd); // the mapping keeps the file open
+		if (pBase != nullptr) return true;
+#endif
+		// No mapping to be had, read it all in once instead
+		std::ifstream ifs(sFile, std::ifstream::binary);
+		if (!ifs.is_open()) return false;
+		vBase.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+		pBase = vBase.data();
+		nBaseSize = vBase.size();
+		return true;
+	}
+
+	void ResourcePack::UnmapFile()
+	{
+		if (pMapping != nullptr)
+		{
+#if defined(_WIN32)
+			UnmapViewOfFile(pBase);
+			CloseHandle((HANDLE)pMapping);
+#elif !defined(__EMSCRIPTEN__)
+			munmap(pMapping, nBaseSize);
+#endif
+		}
+		pMapping = nullptr;
+		pBase = nullptr;
+		nBaseSize = 0;
+		vBase.clear();
+	}
+
+	// Only the index is scrambled, and an empty key skips it. The key is applied a
+	// whole repeat at a time so the inner loop has no modulo and can be vectorised
 	std::vector<char> ResourcePack::scramble(const std::vector<char>& data, const std::string& key)
 	{
 		if (key.empty()) return data;
-		std::vector<char> o;
-		size_t c = 0;
-		for (auto s : data)	o.push_back(s ^ key[(c++) % key.size()]);
+		std::vector<char> o(data);
+		const size_t nKey = key.size();
+		for (size_t i = 0; i < o.size(); i += nKey)
+		{
+			const size_t n = std::min(nKey, o.size() - i);
+			char* p = o.data() + i;
+			for (size_t j = 0; j < n; j++) p[j] ^= key[j];
+		}
 		return o;
 	};
 
@@ -1851,6 +2054,33 @@ namespace olc
 		return nLastFPS;
 	}
 
+	void PixelGameEngine::SetFrameLimit(uint32_t fps)
+	{
+		nFrameLimit = fps;
+	}
+
+	void PixelGameEngine::SetIdle(bool idle, uint32_t fps)
+	{
+		bIdle = idle;
+		nIdleFrameRate = fps;
+	}
+
+	void PixelGameEngine::SetCoreTiming(bool enable)
+	{
+		bCoreTiming = enable;
+		if (!enable) fLayerTime = fPresentTime = 0.0f;
+	}
+
+	float PixelGameEngine::GetLayerTime() const
+	{
+		return fLayerTime;
+	}
+
+	float PixelGameEngine::GetPresentTime() const
+	{
+		return fPresentTime;
+	}
+
 	bool PixelGameEngine::IsFocused() const
 	{
 		return bHasInputFocus;
@@ -2992,11 +3222,13 @@ namespace olc
 	{
 		vWindowSize = { x, y };
 		olc_UpdateViewport();
+		olc_NotifyInput();
 	}
 
 	void PixelGameEngine::olc_UpdateMouseWheel(int32_t delta)
 	{
 		nMouseWheelDeltaCache += delta;
+		olc_NotifyInput();
 	}
 
 	void PixelGameEngine::olc_UpdateMouse(int32_t x, int32_t y)
@@ -3014,26 +3246,31 @@ namespace olc
 		if (vMousePosCache.y >= (int32_t)vScreenSize.y)	vMousePosCache.y = vScreenSize.y - 1;
 		if (vMousePosCache.x < 0) vMousePosCache.x = 0;
 		if (vMousePosCache.y < 0) vMousePosCache.y = 0;
+		olc_NotifyInput();
 	}
 
 	void PixelGameEngine::olc_UpdateMouseState(int32_t button, bool state)
 	{
 		pMouseNewState[button] = state;
+		olc_NotifyInput();
 	}
 
 	void PixelGameEngine::olc_UpdateKeyState(int32_t key, bool state)
 	{
 		pKeyNewState[key] = state;
+		olc_NotifyInput();
 	}
 
 	void PixelGameEngine::olc_UpdateMouseFocus(bool state)
 	{
 		bHasMouseFocus = state;
+		olc_NotifyInput();
 	}
 
 	void PixelGameEngine::olc_UpdateKeyFocus(bool state)
 	{
 		bHasInputFocus = state;
+		olc_NotifyInput();
 	}
 
 	void PixelGameEngine::olc_Reanimate()
@@ -3049,6 +3286,59 @@ namespace olc
 	void PixelGameEngine::olc_Terminate()
 	{
 		bAtomActive = false;
+		olc_NotifyInput();
+	}
+
+	void PixelGameEngine::olc_NotifyInput()
+	{
+		{
+			std::lock_guard<std::mutex> lock(muxInputEvent);
+			bInputEvent = true;
+		}
+		cvInputEvent.notify_one();
+	}
+
+	void PixelGameEngine::olc_PaceFrame()
+	{
+		// Offscreen runs step a fixed clock, so there is nothing to wait for
+		if (fFixedElapsedTime > 0.0f) return;
+
+		// Idle is only honoured for the frame that asked for it
+		bool idle = bIdle;
+		bIdle = false;
+
+		uint32_t fps = idle ? nIdleFrameRate : nFrameLimit;
+		auto now = std::chrono::steady_clock::now();
+		if (fps == 0)
+		{
+			m_tpNextFrame = now;
+			return;
+		}
+
+		auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / double(fps)));
+		m_tpNextFrame += period;
+		// Fell too far behind, don't try to catch up with a burst of frames
+		if (m_tpNextFrame < now - period) m_tpNextFrame = now;
+
+		if (idle)
+		{
+			// Block until the deadline or the next input event, whichever is first.
+			// Platforms that pump events on this thread only get the timeout
+			std::unique_lock<std::mutex> lock(muxInputEvent);
+			if (cvInputEvent.wait_until(lock, m_tpNextFrame, [&] { return bInputEvent.load(); }))
+				m_tpNextFrame = std::chrono::steady_clock::now();
+			bInputEvent = false;
+			return;
+		}
+
+		// Sleep through most of the wait, the scheduler is too coarse for the
+		// last couple of milliseconds so spin those out
+		const auto spin = std::chrono::milliseconds(2);
+		if (m_tpNextFrame - now > spin)
+			std::this_thread::sleep_for(m_tpNextFrame - now - spin);
+		while (std::chrono::steady_clock::now() < m_tpNextFrame)
+			std::this_thread::yield();
+		bInputEvent = false;
 	}
 
 	void PixelGameEngine::EngineThread()
@@ -3067,8 +3357,8 @@ namespace olc
 
 		while (bAtomActive)
 		{
-			// Run as fast as possible
-			while (bAtomActive) { olc_CoreUpdate(); }
+			// Run as fast as the frame limiter allows
+			while (bAtomActive) { olc_CoreUpdate(); olc_PaceFrame(); }
 
 			// Allow the user to free resources if they have overrided the destroy function
 			if (!OnUserDestroy())
@@ -3107,8 +3397,8 @@ namespace olc
 		std::chrono::duration<float> elapsedTime = m_tp2 - m_tp1;
 		m_tp1 = m_tp2;
 
-		// Our time per frame coefficient
-		float fElapsedTime = elapsedTime.count();
+		// Our time per frame coefficient, offscreen runs may step at a fixed rate
+		float fElapsedTime = fFixedElapsedTime > 0.0f ? fFixedElapsedTime : elapsedTime.count();
 		fLastElapsed = fElapsedTime;
 
 		// Some platforms will need to check for events
@@ -3154,6 +3444,8 @@ namespace olc
 		for (auto& ext : vExtensions) ext->OnAfterUserUpdate(fElapsedTime);
 
 		// Display Frame
+		std::chrono::time_point<std::chrono::steady_clock> tpCore;
+		if (bCoreTiming) tpCore = std::chrono::steady_clock::now();
 		renderer->UpdateViewport(vViewPos, vViewSize);
 		renderer->ClearBuffer(olc::BLACK, true);
 
@@ -3191,8 +3483,16 @@ namespace olc
 			}
 		}
 
+		if (bCoreTiming)
+		{
+			auto tpNow = std::chrono::steady_clock::now();
+			fLayerTime = std::chrono::duration<float>(tpNow - tpCore).count();
+			tpCore = tpNow;
+		}
+
 		// Present Graphics to screen
 		renderer->DisplayFrame();
+		if (bCoreTiming) fPresentTime = std::chrono::duration<float>(std::chrono::steady_clock::now() - tpCore).count();
 
 		// Update Title Bar
 		fFrameTimer += fElapsedTime;
@@ -4142,6 +4442,8 @@ namespace olc
 // O------------------------------------------------------------------------------O
 #pragma endregion
 
+#endif // Headless
+
 // O------------------------------------------------------------------------------O
 // | olcPixelGameEngine Image loaders                                             |
 // O------------------------------------------------------------------------------O
@@ -4454,6 +4756,573 @@ namespace olc
 // O------------------------------------------------------------------------------O
 #pragma endregion
 
+#pragma region renderer_software
+// O------------------------------------------------------------------------------O
+// | START RENDERER: Software (offscreen, no device, composites into a sprite)    |
+// O------------------------------------------------------------------------------O
+namespace olc
+{
+	class Renderer_Software : public olc::Renderer
+	{
+	private:
+		struct sTexture
+		{
+			olc::Sprite* sprite = nullptr;
+			bool bFiltered = false;
+			bool bClamp = true;
+		};
+
+		std::vector<sTexture> vTextures = { sTexture() }; // id 0 is "no texture", as in GL
+		std::vector<uint32_t> vFreeTextures;
+		uint32_t nBoundTexture = 0;
+		olc::DecalMode nDecalMode = olc::DecalMode::NORMAL;
+
+		olc::Sprite sprFrame;
+		olc::FrameSink* pSink = nullptr;
+		uint32_t nFrame = 0;
+		uint32_t nMaxFrames = 0;
+
+	public:
+		Renderer_Software(olc::FrameSink* sink = nullptr, uint32_t max_frames = 0) :
+			pSink(sink), nMaxFrames(max_frames)
+		{}
+
+		void PrepareDevice() override {}
+
+		olc::rcode CreateDevice(std::vector<void*> params, bool bFullScreen, bool bVSYNC) override
+		{
+			UNUSED(params); UNUSED(bFullScreen); UNUSED(bVSYNC);
+			ResizeFrame();
+			return olc::rcode::OK;
+		}
+
+		olc::rcode DestroyDevice() override
+		{
+			return olc::rcode::OK;
+		}
+
+		void DisplayFrame() override
+		{
+			if (pSink != nullptr && !pSink->WriteFrame(&sprFrame, nFrame))
+				ptrPGE->olc_Terminate();
+			if (++nFrame == nMaxFrames)
+				ptrPGE->olc_Terminate();
+		}
+
+		void PrepareDrawing() override
+		{
+			nDecalMode = olc::DecalMode::NORMAL;
+		}
+
+		void SetDecalMode(const olc::DecalMode& mode) override
+		{
+			nDecalMode = mode;
+		}
+
+		void DrawLayerQuad(const olc::vf2d& offset, const olc::vf2d& scale, const olc::Pixel tint) override
+		{
+			const sTexture& tex = vTextures[nBoundTexture];
+			if (tex.sprite == nullptr || tex.sprite->width == 0 || tex.sprite->height == 0) return;
+
+			const bool bDirect = offset.x == 0.0f && offset.y == 0.0f && scale.x == 1.0f && scale.y == 1.0f
+				&& tex.sprite->width == sprFrame.width && tex.sprite->height == sprFrame.height;
+			const olc::Pixel* pSrc = tex.sprite->pColData.data();
+			olc::Pixel* pDst = sprFrame.pColData.data();
+
+			for (int32_t y = 0; y < sprFrame.height; y++)
+			{
+				int32_t sy = y;
+				if (!bDirect)
+					sy = WrapCoord(int32_t(std::floor(((float(y) + 0.5f) / float(sprFrame.height) * scale.y + offset.y) * float(tex.sprite->height))), tex.sprite->height, tex.bClamp);
+
+				for (int32_t x = 0; x < sprFrame.width; x++)
+				{
+					int32_t sx = x;
+					if (!bDirect)
+						sx = WrapCoord(int32_t(std::floor(((float(x) + 0.5f) / float(sprFrame.width) * scale.x + offset.x) * float(tex.sprite->width))), tex.sprite->width, tex.bClamp);
+
+					olc::Pixel p = pSrc[sy * tex.sprite->width + sx];
+					if (tint != olc::WHITE) p = Modulate(p, tint);
+					Blend(pDst[y * sprFrame.width + x], p);
+				}
+			}
+		}
+
+		void DrawDecal(const olc::DecalInstance& decal) override
+		{
+			SetDecalMode(decal.mode);
+
+			// Decal positions arrive in normalised device space, bring them back to pixels
+			std::vector<olc::vf2d> vPixel(decal.points);
+			for (uint32_t n = 0; n < decal.points; n++)
+				vPixel[n] = { (decal.pos[n].x + 1.0f) * 0.5f * float(sprFrame.width), (1.0f - decal.pos[n].y) * 0.5f * float(sprFrame.height) };
+
+			if (nDecalMode == olc::DecalMode::WIREFRAME || decal.points == 2)
+			{
+				for (uint32_t n = 0; n < decal.points; n++)
+				{
+					uint32_t m = (n + 1) % decal.points;
+					if (decal.points == 2 && n == 1) break;
+					RasterLine(vPixel[n], vPixel[m], decal.tint[n]);
+				}
+				return;
+			}
+
+			const sTexture* tex = (decal.decal == nullptr || decal.decal->id < 0) ? nullptr : &vTextures[decal.decal->id];
+			if (IsAxisAlignedQuad(decal, vPixel))
+				RasterRect(decal, vPixel, tex);
+			else
+				for (uint32_t n = 1; n + 1 < decal.points; n++)
+					RasterTriangle(decal, vPixel, tex, 0, n, n + 1);
+		}
+
+		uint32_t CreateTexture(const uint32_t width, const uint32_t height, const bool filtered, const bool clamp) override
+		{
+			UNUSED(width);
+			UNUSED(height);
+			uint32_t id;
+			if (vFreeTextures.empty())
+			{
+				id = uint32_t(vTextures.size());
+				vTextures.push_back(sTexture());
+			}
+			else
+			{
+				id = vFreeTextures.back();
+				vFreeTextures.pop_back();
+			}
+			vTextures[id] = { nullptr, filtered, clamp };
+			return id;
+		}
+
+		uint32_t DeleteTexture(const uint32_t id) override
+		{
+			if (id > 0 && id < vTextures.size())
+			{
+				vTextures[id].sprite = nullptr;
+				vFreeTextures.push_back(id);
+			}
+			return id;
+		}
+
+		// Textures are not copied, the sprite is referenced until it is replaced or deleted
+		void UpdateTexture(uint32_t id, olc::Sprite* spr) override
+		{
+			if (id < vTextures.size()) vTextures[id].sprite = spr;
+		}
+
+		void ReadTexture(uint32_t id, olc::Sprite* spr) override
+		{
+			UNUSED(id);
+			for (int32_t y = 0; y < std::min(spr->height, sprFrame.height); y++)
+				for (int32_t x = 0; x < std::min(spr->width, sprFrame.width); x++)
+					spr->SetPixel(x, y, sprFrame.GetPixel(x, y));
+		}
+
+		void ApplyTexture(uint32_t id) override
+		{
+			nBoundTexture = id < vTextures.size() ? id : 0;
+		}
+
+		void ClearBuffer(olc::Pixel p, bool bDepth) override
+		{
+			UNUSED(bDepth);
+			ResizeFrame();
+			std::fill(sprFrame.pColData.begin(), sprFrame.pColData.end(), p);
+		}
+
+		void UpdateViewport(const olc::vi2d& pos, const olc::vi2d& size) override
+		{
+			UNUSED(pos);
+			UNUSED(size);
+		}
+
+	private:
+		// The frame is always rendered at screen resolution, pixel size is ignored
+		void ResizeFrame()
+		{
+			if (sprFrame.width != ptrPGE->ScreenWidth() || sprFrame.height != ptrPGE->ScreenHeight())
+			{
+				sprFrame.width = ptrPGE->ScreenWidth();
+				sprFrame.height = ptrPGE->ScreenHeight();
+				sprFrame.pColData.assign(size_t(sprFrame.width) * size_t(sprFrame.height), olc::BLACK);
+			}
+		}
+
+		static int32_t WrapCoord(int32_t i, int32_t size, bool bClamp)
+		{
+			if (bClamp) return std::max(0, std::min(size - 1, i));
+			i %= size;
+			return i < 0 ? i + size : i;
+		}
+
+		static olc::Pixel Modulate(const olc::Pixel a, const olc::Pixel b)
+		{
+			return olc::Pixel(uint8_t(a.r * b.r / 255), uint8_t(a.g * b.g / 255), uint8_t(a.b * b.b / 255), uint8_t(a.a * b.a / 255));
+		}
+
+		// Mirrors the blend functions the OpenGL renderers set per decal mode
+		void Blend(olc::Pixel& d, const olc::Pixel s) const
+		{
+			const uint32_t sa = s.a, ia = 255 - s.a;
+			switch (nDecalMode)
+			{
+			case olc::DecalMode::NORMAL:
+			case olc::DecalMode::WIREFRAME:
+				if (sa == 0) return;
+				if (sa == 255) { d = olc::Pixel(s.r, s.g, s.b, d.a); return; }
+				d.r = uint8_t((s.r * sa + d.r * ia) / 255);
+				d.g = uint8_t((s.g * sa + d.g * ia) / 255);
+				d.b = uint8_t((s.b * sa + d.b * ia) / 255);
+				break;
+			case olc::DecalMode::ADDITIVE:
+				d.r = uint8_t(std::min(255u, d.r + s.r * sa / 255));
+				d.g = uint8_t(std::min(255u, d.g + s.g * sa / 255));
+				d.b = uint8_t(std::min(255u, d.b + s.b * sa / 255));
+				break;
+			case olc::DecalMode::MULTIPLICATIVE:
+				d.r = uint8_t(std::min(255u, (s.r * d.r + d.r * ia) / 255));
+				d.g = uint8_t(std::min(255u, (s.g * d.g + d.g * ia) / 255));
+				d.b = uint8_t(std::min(255u, (s.b * d.b + d.b * ia) / 255));
+				break;
+			case olc::DecalMode::STENCIL:
+				d.r = uint8_t(d.r * sa / 255);
+				d.g = uint8_t(d.g * sa / 255);
+				d.b = uint8_t(d.b * sa / 255);
+				break;
+			case olc::DecalMode::ILLUMINATE:
+				d.r = uint8_t((s.r * ia + d.r * sa) / 255);
+				d.g = uint8_t((s.g * ia + d.g * sa) / 255);
+				d.b = uint8_t((s.b * ia + d.b * sa) / 255);
+				break;
+			}
+		}
+
+		void RasterLine(const olc::vf2d& a, const olc::vf2d& b, const olc::Pixel col)
+		{
+			int32_t x1 = int32_t(std::floor(a.x)), y1 = int32_t(std::floor(a.y));
+			int32_t x2 = int32_t(std::floor(b.x)), y2 = int32_t(std::floor(b.y));
+			int32_t dx = std::abs(x2 - x1), dy = -std::abs(y2 - y1);
+			int32_t sx = x1 < x2 ? 1 : -1, sy = y1 < y2 ? 1 : -1;
+			int32_t err = dx + dy;
+			while (true)
+			{
+				if (x1 >= 0 && y1 >= 0 && x1 < sprFrame.width && y1 < sprFrame.height)
+					Blend(sprFrame.pColData[y1 * sprFrame.width + x1], col);
+				if (x1 == x2 && y1 == y2) break;
+				int32_t e2 = 2 * err;
+				if (e2 >= dy) { err += dy; x1 += sx; }
+				if (e2 <= dx) { err += dx; y1 += sy; }
+			}
+		}
+
+		// DrawDecal(), DrawPartialDecal(), FillRectDecal() and the string decals all emit
+		// untransformed rectangles with a flat tint, which is nearly every decal in a frame
+		static bool IsAxisAlignedQuad(const olc::DecalInstance& decal, const std::vector<olc::vf2d>& vPixel)
+		{
+			if (decal.points != 4) return false;
+			for (uint32_t n = 0; n < 4; n++)
+				if (decal.w[n] != 1.0f || decal.tint[n] != decal.tint[0]) return false;
+			return vPixel[0].x == vPixel[1].x && vPixel[2].x == vPixel[3].x && vPixel[0].y == vPixel[3].y && vPixel[1].y == vPixel[2].y
+				&& decal.uv[0].x == decal.uv[1].x && decal.uv[2].x == decal.uv[3].x && decal.uv[0].y == decal.uv[3].y && decal.uv[1].y == decal.uv[2].y;
+		}
+
+		void RasterRect(const olc::DecalInstance& decal, const std::vector<olc::vf2d>& vPixel, const sTexture* tex)
+		{
+			const float fL = std::min(vPixel[0].x, vPixel[2].x), fR = std::max(vPixel[0].x, vPixel[2].x);
+			const float fT = std::min(vPixel[0].y, vPixel[1].y), fB = std::max(vPixel[0].y, vPixel[1].y);
+			if (fR - fL <= 0.0f || fB - fT <= 0.0f) return;
+
+			// Pixel centres inside [L, R) x [T, B)
+			const int32_t nX0 = std::max(0, int32_t(std::ceil(fL - 0.5f))), nX1 = std::min(sprFrame.width, int32_t(std::ceil(fR - 0.5f)));
+			const int32_t nY0 = std::max(0, int32_t(std::ceil(fT - 0.5f))), nY1 = std::min(sprFrame.height, int32_t(std::ceil(fB - 0.5f)));
+			if (nX0 >= nX1 || nY0 >= nY1) return;
+
+			const olc::Pixel tint = decal.tint[0];
+			olc::Pixel* pDst = sprFrame.pColData.data();
+			if (tex == nullptr || tex->sprite == nullptr)
+			{
+				for (int32_t y = nY0; y < nY1; y++)
+					for (int32_t x = nX0; x < nX1; x++)
+						Blend(pDst[y * sprFrame.width + x], tint);
+				return;
+			}
+
+			// uv runs from the vertex at the left / top edge to the one at the right / bottom
+			const olc::Sprite* spr = tex->sprite;
+			const float uL = vPixel[0].x <= vPixel[2].x ? decal.uv[0].x : decal.uv[2].x, uR = vPixel[0].x <= vPixel[2].x ? decal.uv[2].x : decal.uv[0].x;
+			const float vT = vPixel[0].y <= vPixel[1].y ? decal.uv[0].y : decal.uv[1].y, vB = vPixel[0].y <= vPixel[1].y ? decal.uv[1].y : decal.uv[0].y;
+
+			std::vector<int32_t> vTexelX(nX1 - nX0);
+			for (int32_t x = nX0; x < nX1; x++)
+			{
+				float u = uL + (float(x) + 0.5f - fL) / (fR - fL) * (uR - uL);
+				vTexelX[x - nX0] = WrapCoord(int32_t(std::floor(u * float(spr->width))), spr->width, tex->bClamp);
+			}
+
+			for (int32_t y = nY0; y < nY1; y++)
+			{
+				float v = vT + (float(y) + 0.5f - fT) / (fB - fT) * (vB - vT);
+				if (tex->bFiltered)
+				{
+					for (int32_t x = nX0; x < nX1; x++)
+					{
+						float u = uL + (float(x) + 0.5f - fL) / (fR - fL) * (uR - uL);
+						Blend(pDst[y * sprFrame.width + x], Modulate(spr->SampleBL(u, v), tint));
+					}
+					continue;
+				}
+
+				const olc::Pixel* pRow = spr->pColData.data() + size_t(WrapCoord(int32_t(std::floor(v * float(spr->height))), spr->height, tex->bClamp)) * spr->width;
+				for (int32_t x = nX0; x < nX1; x++)
+				{
+					olc::Pixel texel = pRow[vTexelX[x - nX0]];
+					if (tint != olc::WHITE) texel = Modulate(texel, tint);
+					Blend(pDst[y * sprFrame.width + x], texel);
+				}
+			}
+		}
+
+		// Perspective correct (uv / w) triangle fill with a top-left style tie
+		// break, so quads split into a fan never blend their diagonal twice
+		void RasterTriangle(const olc::DecalInstance& decal, const std::vector<olc::vf2d>& vPixel, const sTexture* tex, uint32_t i0, uint32_t i1, uint32_t i2)
+		{
+			auto edge = [](const olc::vf2d& a, const olc::vf2d& b, float px, float py)
+			{
+				return (px - a.x) * (b.y - a.y) - (py - a.y) * (b.x - a.x);
+			};
+
+			float fArea = edge(vPixel[i0], vPixel[i1], vPixel[i2].x, vPixel[i2].y);
+			if (fArea == 0.0f) return;
+			if (fArea < 0.0f) { std::swap(i1, i2); fArea = -fArea; }
+			const olc::vf2d& v0 = vPixel[i0];
+			const olc::vf2d& v1 = vPixel[i1];
+			const olc::vf2d& v2 = vPixel[i2];
+
+			auto owns = [](const olc::vf2d& a, const olc::vf2d& b)
+			{
+				olc::vf2d d = b - a;
+				return d.y > 0.0f || (d.y == 0.0f && d.x < 0.0f);
+			};
+			const bool bOwn0 = owns(v1, v2), bOwn1 = owns(v2, v0), bOwn2 = owns(v0, v1);
+
+			int32_t nMinX = std::max(0, int32_t(std::floor(std::min({ v0.x, v1.x, v2.x }))));
+			int32_t nMinY = std::max(0, int32_t(std::floor(std::min({ v0.y, v1.y, v2.y }))));
+			int32_t nMaxX = std::min(sprFrame.width - 1, int32_t(std::ceil(std::max({ v0.x, v1.x, v2.x }))));
+			int32_t nMaxY = std::min(sprFrame.height - 1, int32_t(std::ceil(std::max({ v0.y, v1.y, v2.y }))));
+			const float fInvArea = 1.0f / fArea;
+
+			for (int32_t y = nMinY; y <= nMaxY; y++)
+			{
+				const float py = float(y) + 0.5f;
+				for (int32_t x = nMinX; x <= nMaxX; x++)
+				{
+					const float px = float(x) + 0.5f;
+					float w0 = edge(v1, v2, px, py);
+					float w1 = edge(v2, v0, px, py);
+					float w2 = edge(v0, v1, px, py);
+					if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) continue;
+					if ((w0 == 0.0f && !bOwn0) || (w1 == 0.0f && !bOwn1) || (w2 == 0.0f && !bOwn2)) continue;
+					w0 *= fInvArea; w1 *= fInvArea; w2 *= fInvArea;
+
+					olc::Pixel col(
+						uint8_t(decal.tint[i0].r * w0 + decal.tint[i1].r * w1 + decal.tint[i2].r * w2 + 0.5f),
+						uint8_t(decal.tint[i0].g * w0 + decal.tint[i1].g * w1 + decal.tint[i2].g * w2 + 0.5f),
+						uint8_t(decal.tint[i0].b * w0 + decal.tint[i1].b * w1 + decal.tint[i2].b * w2 + 0.5f),
+						uint8_t(decal.tint[i0].a * w0 + decal.tint[i1].a * w1 + decal.tint[i2].a * w2 + 0.5f));
+
+					if (tex != nullptr && tex->sprite != nullptr)
+					{
+						const float q = decal.w[i0] * w0 + decal.w[i1] * w1 + decal.w[i2] * w2;
+						const float u = (decal.uv[i0].x * w0 + decal.uv[i1].x * w1 + decal.uv[i2].x * w2) / q;
+						const float v = (decal.uv[i0].y * w0 + decal.uv[i1].y * w1 + decal.uv[i2].y * w2) / q;
+						olc::Pixel texel;
+						if (tex->bFiltered)
+							texel = tex->sprite->SampleBL(u, v);
+						else
+						{
+							int32_t tx = WrapCoord(int32_t(std::floor(u * float(tex->sprite->width))), tex->sprite->width, tex->bClamp);
+							int32_t ty = WrapCoord(int32_t(std::floor(v * float(tex->sprite->height))), tex->sprite->height, tex->bClamp);
+							texel = tex->sprite->pColData[ty * tex->sprite->width + tx];
+						}
+						col = Modulate(texel, col);
+					}
+
+					Blend(sprFrame.pColData[y * sprFrame.width + x], col);
+				}
+			}
+		}
+	};
+}
+// O------------------------------------------------------------------------------O
+// | END RENDERER: Software                                                       |
+// O------------------------------------------------------------------------------O
+#pragma endregion
+
+#pragma region platform_offscreen
+// O------------------------------------------------------------------------------O
+// | START PLATFORM: Offscreen - no window, no events, no graphics context        |
+// O------------------------------------------------------------------------------O
+namespace olc
+{
+	class Platform_Offscreen : public olc::Platform
+	{
+	public:
+		virtual olc::rcode ApplicationStartUp() override { return olc::rcode::OK; }
+		virtual olc::rcode ApplicationCleanUp() override { return olc::rcode::OK; }
+		virtual olc::rcode ThreadStartUp() override { return olc::rcode::OK; }
+
+		virtual olc::rcode ThreadCleanUp() override
+		{
+			renderer->DestroyDevice();
+			return olc::OK;
+		}
+
+		virtual olc::rcode CreateGraphics(bool bFullScreen, bool bEnableVSYNC, const olc::vi2d& vViewPos, const olc::vi2d& vViewSize) override
+		{
+			renderer->PrepareDevice();
+			if (renderer->CreateDevice({}, bFullScreen, bEnableVSYNC) == olc::rcode::OK)
+			{
+				renderer->UpdateViewport(vViewPos, vViewSize);
+				return olc::rcode::OK;
+			}
+			else
+				return olc::rcode::FAIL;
+		}
+
+		virtual olc::rcode CreateWindowPane(const olc::vi2d& vWindowPos, olc::vi2d& vWindowSize, bool bFullScreen) override
+		{
+			UNUSED(vWindowPos); UNUSED(vWindowSize); UNUSED(bFullScreen);
+			return olc::rcode::OK;
+		}
+
+		virtual olc::rcode SetWindowTitle(const std::string& s) override { UNUSED(s); return olc::rcode::OK; }
+		virtual olc::rcode StartSystemEventLoop() override { return olc::rcode::OK; }
+		virtual olc::rcode HandleSystemEvent() override { return olc::rcode::OK; }
+	};
+
+	olc::rcode PixelGameEngine::ConstructOffscreen(int32_t screen_w, int32_t screen_h, olc::FrameSink* sink, float fixed_step, uint32_t max_frames)
+	{
+		if (Construct(screen_w, screen_h, 1, 1) != olc::OK)
+			return olc::FAIL;
+
+		fFixedElapsedTime = fixed_step;
+		platform = std::make_unique<olc::Platform_Offscreen>();
+		renderer = std::make_unique<olc::Renderer_Software>(sink, max_frames);
+		platform->ptrPGE = this;
+		renderer->ptrPGE = this;
+		return olc::OK;
+	}
+
+	FrameSink_PNG::FrameSink_PNG(const std::string& sPrefix) : sPrefix(sPrefix)
+	{}
+
+	bool FrameSink_PNG::WriteFrame(const olc::Sprite* frame, uint32_t nFrame)
+	{
+		std::string sNumber = std::to_string(nFrame);
+		if (sNumber.size() < 6) sNumber.insert(0, 6 - sNumber.size(), '0');
+		std::ofstream ofs(sPrefix + sNumber + ".png", std::ofstream::binary);
+		return ofs.is_open() && SavePNG(frame, ofs) == olc::OK;
+	}
+
+	FrameSink_RawRGBA::FrameSink_RawRGBA(std::FILE* file) : file(file)
+	{}
+
+	bool FrameSink_RawRGBA::WriteFrame(const olc::Sprite* frame, uint32_t nFrame)
+	{
+		UNUSED(nFrame);
+		const size_t nPixels = frame->pColData.size();
+		return file != nullptr && std::fwrite(frame->pColData.data(), sizeof(olc::Pixel), nPixels, file) == nPixels;
+	}
+
+	olc::rcode SavePNG(const olc::Sprite* spr, std::ostream& os)
+	{
+		if (spr == nullptr || spr->width <= 0 || spr->height <= 0) return olc::FAIL;
+
+		static const std::array<uint32_t, 256> crcTable = []
+		{
+			std::array<uint32_t, 256> table{};
+			for (uint32_t n = 0; n < 256; n++)
+			{
+				uint32_t c = n;
+				for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				table[n] = c;
+			}
+			return table;
+		}();
+
+		auto put32 = [](std::vector<uint8_t>& v, uint32_t n)
+		{
+			v.push_back(uint8_t(n >> 24)); v.push_back(uint8_t(n >> 16)); v.push_back(uint8_t(n >> 8)); v.push_back(uint8_t(n));
+		};
+
+		auto writeChunk = [&](const char* type, const std::vector<uint8_t>& data)
+		{
+			std::vector<uint8_t> header;
+			put32(header, uint32_t(data.size()));
+			header.insert(header.end(), type, type + 4);
+			uint32_t crc = 0xFFFFFFFFu;
+			for (size_t i = 4; i < 8; i++) crc = crcTable[(crc ^ header[i]) & 0xFF] ^ (crc >> 8);
+			for (uint8_t b : data) crc = crcTable[(crc ^ b) & 0xFF] ^ (crc >> 8);
+			std::vector<uint8_t> footer;
+			put32(footer, crc ^ 0xFFFFFFFFu);
+			os.write((const char*)header.data(), header.size());
+			os.write((const char*)data.data(), data.size());
+			os.write((const char*)footer.data(), footer.size());
+		};
+
+		static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		os.write((const char*)signature, 8);
+
+		std::vector<uint8_t> ihdr;
+		put32(ihdr, uint32_t(spr->width));
+		put32(ihdr, uint32_t(spr->height));
+		ihdr.insert(ihdr.end(), { 8, 6, 0, 0, 0 }); // 8-bit RGBA, no interlace
+		writeChunk("IHDR", ihdr);
+
+		// Scanlines, each prefixed with filter type 0 - olc::Pixel is already RGBA in memory
+		const size_t nRowBytes = size_t(spr->width) * 4;
+		std::vector<uint8_t> raw(size_t(spr->height) * (nRowBytes + 1));
+		for (int32_t y = 0; y < spr->height; y++)
+		{
+			raw[y * (nRowBytes + 1)] = 0;
+			std::memcpy(&raw[y * (nRowBytes + 1) + 1], &spr->pColData[size_t(y) * spr->width], nRowBytes);
+		}
+
+		// zlib stream made of stored deflate blocks
+		std::vector<uint8_t> idat = { 0x78, 0x01 };
+		idat.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+		uint32_t s1 = 1, s2 = 0;
+		for (size_t i = 0; i < raw.size(); i++)
+		{
+			s1 = (s1 + raw[i]) % 65521;
+			s2 = (s2 + s1) % 65521;
+		}
+		for (size_t nPos = 0; nPos < raw.size() || nPos == 0; )
+		{
+			const uint16_t nLen = uint16_t(std::min<size_t>(65535, raw.size() - nPos));
+			const bool bLast = nPos + nLen == raw.size();
+			idat.push_back(bLast ? 1 : 0);
+			idat.push_back(uint8_t(nLen)); idat.push_back(uint8_t(nLen >> 8));
+			idat.push_back(uint8_t(~nLen)); idat.push_back(uint8_t(~nLen >> 8));
+			idat.insert(idat.end(), raw.begin() + nPos, raw.begin() + nPos + nLen);
+			nPos += nLen;
+			if (bLast) break;
+		}
+		put32(idat, (s2 << 16) | s1);
+		writeChunk("IDAT", idat);
+		writeChunk("IEND", {});
+
+		return os.good() ? olc::OK : olc::FAIL;
+	}
+}
+// O------------------------------------------------------------------------------O
+// | END PLATFORM: Offscreen                                                      |
+// O------------------------------------------------------------------------------O
+#pragma endregion
+
+#if !defined(OLC_PGE_HEADLESS)
+
 // O------------------------------------------------------------------------------O
 // | olcPixelGameEngine Platforms                                                 |
 // O------------------------------------------------------------------------------O
@@ -5694,9 +6563,6 @@ namespace olc
 {
 	void PixelGameEngine::olc_ConfigureSystem()
 	{
-
-#if !defined(OLC_PGE_HEADLESS)
-
 #if defined(OLC_IMAGE_GDI)
 		olc::Sprite::loader = std::make_unique<olc::ImageLoader_GDIPlus>();
 #endif
@@ -5714,7 +6580,7 @@ namespace olc
 #endif
 
 
-
+#if !defined(OLC_PGE_HEADLESS)
 
 #if defined(OLC_PLATFORM_WINAPI)
 		platform = std::make_unique<olc::Platform_Windows>();
@@ -5766,9 +6632,11 @@ namespace olc
 		platform->ptrPGE = this;
 		renderer->ptrPGE = this;
 #else
-		olc::Sprite::loader = nullptr;
-		platform = nullptr;
-		renderer = nullptr;
+		// Headless builds have no window or device, frames are composited in software
+		platform = std::make_unique<olc::Platform_Offscreen>();
+		renderer = std::make_unique<olc::Renderer_Software>();
+		platform->ptrPGE = this;
+		renderer->ptrPGE = this;
 #endif
 	}
 }